@@ -1,9 +1,19 @@
 #!/bin/bash
 
 # <https://github.com/olilarkin/ort-builder>
+# usage: build-wasm.sh [threads]
+# threads builds the runtime with pthreads and simd for the CREPE_WASM_THREADS variant,
+# copy its library to external/onnxruntime/wasm-threads
+
+BUILD_DIR=onnxruntime/build/wasm
+EXTRA_FLAGS=()
+if [ "$1" == "threads" ]; then
+  BUILD_DIR=onnxruntime/build/wasm-threads
+  EXTRA_FLAGS=(--enable_wasm_threads --enable_wasm_simd)
+fi
 
 python onnxruntime/tools/ci_build/build.py \
---build_dir onnxruntime/build/wasm \
+--build_dir "$BUILD_DIR" \
 --config=MinSizeRel \
 --build_wasm_static_lib \
 --parallel \
@@ -12,4 +22,5 @@ python onnxruntime/tools/ci_build/build.py \
 --include_ops_by_config model.required_operators_and_types.config \
 --enable_reduced_operator_type_support \
 --cmake_extra_defines CMAKE_POLICY_VERSION_MINIMUM=3.5 \
---skip_tests
+--skip_tests \
+"${EXTRA_FLAGS[@]}"
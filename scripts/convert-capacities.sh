@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Convert the model-<capacity>.onnx exports in a directory (tiny, small, medium, large, full)
+# into the model-<capacity>.ort files that EngineOptions::model_dir expects.
+# usage: ./convert-capacities.sh <dir>
+
+set -e
+
+dir=${1:-.}
+for capacity in tiny small medium large full; do
+    onnx="$dir/model-$capacity.onnx"
+    if [ -f "$onnx" ]; then
+        # writes model-$capacity.ort next to the input
+        python -m onnxruntime.tools.convert_onnx_models_to_ort "$onnx" --enable_type_reduction
+    else
+        echo "skipping $capacity, no $onnx"
+    fi
+done
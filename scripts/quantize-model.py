@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+"""Quantize a CREPE ONNX model to int8.
+
+dynamic: weights int8, activations quantized on the fly (no calibration needed)
+static:  weights and activations int8 (QDQ), activation ranges calibrated on frames taken from
+         the given 16 kHz mono wav files plus synthetic tones, sweeps and noise
+
+usage: python quantize-model.py model.onnx model-int8.onnx [--mode static] [--calibration a.wav ...]
+
+Then convert with convert_onnx_models_to_ort (or convert-capacities.sh after renaming to
+model-<capacity>-int8.onnx). The quantized graph needs int8 operators that the reduced ORT build
+leaves out, so merge its required_operators config into model.required_operators_and_types.config
+and rebuild the runtime (build-mac.sh / build-wasm.sh) before loading it.
+"""
+
+import argparse
+import wave
+
+import numpy as np
+from onnxruntime.quantization import (CalibrationDataReader, QuantFormat, QuantType,
+                                      quantize_dynamic, quantize_static)
+
+SAMPLE_RATE = 16000
+FRAME_LENGTH = 1024
+FFT_HOP = 160
+
+
+def read_wav(path):
+    with wave.open(path, "rb") as f:
+        if f.getsampwidth() != 2:
+            raise ValueError(f"{path}: only 16-bit pcm wav is supported for calibration")
+        audio = np.frombuffer(f.readframes(f.getnframes()), dtype=np.int16).astype(np.float32)
+        audio = audio.reshape(-1, f.getnchannels()).mean(axis=1) / 32768.0
+        rate = f.getframerate()
+    if rate != SAMPLE_RATE:
+        # calibration only needs representative levels, linear interpolation is enough
+        t = np.arange(0, len(audio) / rate, 1.0 / SAMPLE_RATE)
+        audio = np.interp(t, np.arange(len(audio)) / rate, audio).astype(np.float32)
+    return audio
+
+
+def synthetic_signals(seconds=2.0):
+    t = np.arange(int(seconds * SAMPLE_RATE)) / SAMPLE_RATE
+    signals = [0.5 * np.sin(2 * np.pi * f * t) for f in (55.0, 110.0, 220.0, 440.0, 880.0, 1760.0)]
+    phase = 2 * np.pi * 50.0 * seconds / np.log(2000.0 / 50.0) * \
+        (np.power(2000.0 / 50.0, t / seconds) - 1.0)
+    signals.append(0.5 * np.sin(phase))
+    signals.append(0.1 * np.random.default_rng(0).standard_normal(len(t)))
+    return [s.astype(np.float32) for s in signals]
+
+
+def frames(audio):
+    """Normalized model input frames, as crepe::frame_audio produces them"""
+    count = 1 + (len(audio) - FRAME_LENGTH) // FFT_HOP
+    if count <= 0:
+        return np.zeros((0, FRAME_LENGTH), dtype=np.float32)
+    index = np.arange(FRAME_LENGTH)[None, :] + FFT_HOP * np.arange(count)[:, None]
+    framed = audio[index]
+    framed = framed - framed.mean(axis=1, keepdims=True)
+    std = framed.std(axis=1, keepdims=True)
+    return (framed / np.where(std > 1e-10, std, 1.0)).astype(np.float32)
+
+
+class FrameReader(CalibrationDataReader):
+    def __init__(self, input_name, audio, batch_size, max_frames):
+        batches = np.concatenate([frames(a) for a in audio])
+        rng = np.random.default_rng(0)
+        if len(batches) > max_frames:
+            batches = batches[rng.choice(len(batches), max_frames, replace=False)]
+        self.batches = iter([{input_name: batches[i:i + batch_size]}
+                             for i in range(0, len(batches), batch_size)])
+
+    def get_next(self):
+        return next(self.batches, None)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--mode", choices=["dynamic", "static"], default="dynamic")
+    parser.add_argument("--calibration", nargs="*", default=[], help="16-bit wav files")
+    parser.add_argument("--max-frames", type=int, default=4096)
+    parser.add_argument("--batch", type=int, default=64)
+    args = parser.parse_args()
+
+    if args.mode == "dynamic":
+        quantize_dynamic(args.input, args.output, weight_type=QuantType.QInt8, per_channel=True)
+    else:
+        import onnx
+        input_name = onnx.load(args.input).graph.input[0].name
+        audio = [read_wav(path) for path in args.calibration] + synthetic_signals()
+        reader = FrameReader(input_name, audio, args.batch, args.max_frames)
+        quantize_static(args.input, args.output, reader, quant_format=QuantFormat.QDQ,
+                        activation_type=QuantType.QInt8, weight_type=QuantType.QInt8,
+                        per_channel=True)
+
+    print(f"wrote {args.output} ({args.mode})")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,654 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "crepe.hpp"
+#include "decoding.hpp"
+#include "file_analysis.hpp"
+#include "metrics.hpp"
+#include "signals.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig
+{
+    double seconds = 60.0;
+    std::vector<std::string> signals = {"sine", "sweep", "noise"};
+    int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int batch_size = crepe::constants::BATCH_SIZE;
+    int repeats = 3;
+    int latency_iterations = 500;
+    std::string json_path; // stdout when empty
+    bool engine_stats = false;
+
+    // comparison mode: a candidate model (e.g. int8) against the reference model
+    std::string compare_path;
+    std::string reference_path; // embedded model when empty
+    std::string wav_path = "sweep.wav"; // compared as well when it exists
+
+    // cascade mode: a screen model in front of a full model, against the full model alone
+    std::string cascade_path;
+    std::string screen_path; // embedded model when empty
+};
+
+// Per-stage wall time over the whole signal, in seconds
+struct StageTimes
+{
+    double framing = 0.0;
+    double normalize = 0.0;
+    double model = 0.0;
+    double decode = 0.0; // argmax
+    double decode_weighted = 0.0;
+    double decode_viterbi = 0.0;
+};
+
+struct ScalingPoint
+{
+    std::string mode;
+    int threads;
+    double frames_per_second;
+};
+
+struct SignalReport
+{
+    std::string name;
+    int num_frames;
+    StageTimes stages;
+    double end_to_end;
+    std::vector<ScalingPoint> scaling;
+};
+
+double seconds_since(const Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Best of `repeats` runs, the least disturbed by the rest of the machine
+template <typename Fn>
+double time_best(const int repeats, Fn &&fn)
+{
+    double best = 0.0;
+    for (int r = 0; r < std::max(repeats, 1); r++)
+    {
+        const auto start = Clock::now();
+        fn();
+        const double elapsed = seconds_since(start);
+        best = r == 0 ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+int count_frames(const std::vector<float> &audio)
+{
+    using namespace crepe::constants;
+    const int length = static_cast<int>(audio.size());
+    return length < FRAME_LENGTH ? 0 : (length - FRAME_LENGTH) / FFT_HOP + 1;
+}
+
+StageTimes time_stages(crepe::Engine &engine, const std::vector<float> &audio,
+                       const BenchConfig &config)
+{
+    using namespace crepe::constants;
+
+    const int num_frames = count_frames(audio);
+    crepe::InferenceOptions options;
+    options.batch_size = config.batch_size;
+
+    std::vector<float> frames(static_cast<size_t>(num_frames) * FRAME_LENGTH);
+    std::vector<float> activations(static_cast<size_t>(num_frames) * OUTPUT_SIZE);
+
+    StageTimes times;
+    times.framing = time_best(config.repeats, [&] {
+        crepe::frame_audio(audio.data(), num_frames, FFT_HOP, frames.data());
+    });
+
+    // the per-frame copy + normalize_audio path the framing kernel replaced
+    times.normalize = time_best(config.repeats, [&] {
+        for (int i = 0; i < num_frames; i++)
+        {
+            Eigen::Map<Eigen::VectorXf> frame(frames.data() + static_cast<size_t>(i) * FRAME_LENGTH,
+                                              FRAME_LENGTH);
+            frame = Eigen::Map<const Eigen::VectorXf>(audio.data() + i * FFT_HOP, FRAME_LENGTH);
+            crepe::normalize_audio(frame);
+        }
+    });
+
+    times.model = time_best(config.repeats, [&] {
+        engine.infer(frames.data(), num_frames, activations.data(), options);
+    });
+
+    volatile float sink = 0.0f; // keep the decode loop alive
+    times.decode = time_best(config.repeats, [&] {
+        for (int i = 0; i < num_frames; i++)
+        {
+            const float *activation = activations.data() + static_cast<size_t>(i) * OUTPUT_SIZE;
+            const float pitch = crepe::get_pitch_from_crepe(activation, OUTPUT_SIZE);
+            const float confidence =
+                Eigen::Map<const Eigen::VectorXf>(activation, OUTPUT_SIZE).maxCoeff();
+            sink = sink + pitch * confidence;
+        }
+    });
+
+    times.decode_weighted = time_best(config.repeats, [&] {
+        for (int i = 0; i < num_frames; i++)
+        {
+            const float *activation = activations.data() + static_cast<size_t>(i) * OUTPUT_SIZE;
+            const int bin = crepe::argmax_bin(activation);
+            sink = sink + crepe::local_average_pitch(activation, bin) * activation[bin];
+        }
+    });
+
+    crepe::ViterbiDecoder viterbi;
+    std::vector<float> pitches(num_frames);
+    times.decode_viterbi = time_best(config.repeats, [&] {
+        viterbi.decode(activations.data(), num_frames, pitches.data());
+    });
+
+    return times;
+}
+
+std::vector<int> thread_counts(const int max_threads)
+{
+    std::vector<int> counts;
+    for (int t = 1; t < max_threads; t *= 2)
+    {
+        counts.push_back(t);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// Throughput with t pooled single-threaded sessions, and with one session of t intra-op threads
+std::vector<ScalingPoint> measure_scaling(const std::vector<float> &audio,
+                                          const BenchConfig &config)
+{
+    const int num_frames = count_frames(audio);
+    crepe::InferenceOptions options;
+    options.batch_size = config.batch_size;
+
+    std::vector<ScalingPoint> points;
+    for (const char *mode : {"sessions", "intra_op"})
+    {
+        for (const int threads : thread_counts(config.max_threads))
+        {
+            crepe::EngineOptions engine_options;
+            if (std::string(mode) == "sessions")
+                engine_options.num_sessions = threads;
+            else
+                engine_options.intra_op_threads = threads;
+
+            crepe::Engine engine(engine_options);
+            crepe::PredictionResults results;
+            engine.run(audio.data(), 1024, crepe::constants::SAMPLE_RATE, results); // warm-up
+
+            const double elapsed = time_best(config.repeats, [&] {
+                engine.run(audio.data(), static_cast<int>(audio.size()),
+                           crepe::constants::SAMPLE_RATE, results, options);
+            });
+            points.push_back({mode, threads, num_frames / elapsed});
+        }
+    }
+    return points;
+}
+
+std::vector<double> single_frame_latencies(const BenchConfig &config)
+{
+    using namespace crepe::constants;
+
+    const std::vector<float> audio = crepe::signals::sine(440.0, 1.0, SAMPLE_RATE);
+    crepe::Engine engine;
+    crepe::PredictionResults results;
+
+    for (int i = 0; i < 20; i++) // warm-up
+    {
+        engine.run(audio.data(), FRAME_LENGTH, SAMPLE_RATE, results);
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(config.latency_iterations);
+    for (int i = 0; i < config.latency_iterations; i++)
+    {
+        const auto start = Clock::now();
+        engine.run(audio.data(), FRAME_LENGTH, SAMPLE_RATE, results);
+        latencies.push_back(seconds_since(start) * 1e3);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+double percentile(const std::vector<double> &sorted, const double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    const auto index = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+std::string to_json(const BenchConfig &config, const std::vector<SignalReport> &reports,
+                    const std::vector<double> &latencies, const std::string &engine_stats)
+{
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"config\": {\"seconds\": " << config.seconds
+        << ", \"batch_size\": " << config.batch_size
+        << ", \"max_threads\": " << config.max_threads
+        << ", \"repeats\": " << config.repeats
+        << ", \"kernels\": \"" << crepe::simd::kernel_path() << "\"},\n";
+
+    out << "  \"signals\": [\n";
+    for (size_t s = 0; s < reports.size(); s++)
+    {
+        const SignalReport &report = reports[s];
+        const auto ms = [](const double seconds) { return seconds * 1e3; };
+
+        out << "    {\n";
+        out << "      \"name\": \"" << report.name << "\",\n";
+        out << "      \"frames\": " << report.num_frames << ",\n";
+        out << "      \"stages_ms\": {\"framing\": " << ms(report.stages.framing)
+            << ", \"normalize_audio\": " << ms(report.stages.normalize)
+            << ", \"session_run\": " << ms(report.stages.model)
+            << ", \"decode\": " << ms(report.stages.decode)
+            << ", \"decode_weighted_average\": " << ms(report.stages.decode_weighted)
+            << ", \"decode_viterbi\": " << ms(report.stages.decode_viterbi) << "},\n";
+        out << "      \"end_to_end\": {\"ms\": " << ms(report.end_to_end)
+            << ", \"frames_per_second\": " << report.num_frames / report.end_to_end
+            << ", \"real_time_factor\": " << report.end_to_end / config.seconds << "},\n";
+
+        out << "      \"scaling\": [";
+        for (size_t p = 0; p < report.scaling.size(); p++)
+        {
+            const ScalingPoint &point = report.scaling[p];
+            // speedup against the single-thread point of the same mode
+            const auto base = std::find_if(report.scaling.begin(), report.scaling.end(),
+                                           [&](const ScalingPoint &other) {
+                                               return other.mode == point.mode &&
+                                                      other.threads == 1;
+                                           });
+            out << (p ? ", " : "") << "{\"mode\": \"" << point.mode
+                << "\", \"threads\": " << point.threads
+                << ", \"frames_per_second\": " << point.frames_per_second
+                << ", \"speedup\": " << point.frames_per_second / base->frames_per_second << "}";
+        }
+        out << "]\n";
+        out << "    }" << (s + 1 < reports.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    out << "  \"single_frame_latency_ms\": {\"p50\": " << percentile(latencies, 50)
+        << ", \"p90\": " << percentile(latencies, 90)
+        << ", \"p99\": " << percentile(latencies, 99)
+        << ", \"max\": " << (latencies.empty() ? 0.0 : latencies.back()) << "}";
+    if (!engine_stats.empty())
+    {
+        out << ",\n  \"engine_stats\": " << engine_stats;
+    }
+    out << "\n}\n";
+    return out.str();
+}
+
+struct ComparisonReport
+{
+    std::string name;
+    int num_frames;
+    crepe::metrics::Accuracy accuracy;
+    double reference_fps;
+    double candidate_fps;
+};
+
+// The wav file (when it loads) and the synthetic signals, by name
+std::vector<std::pair<std::string, std::vector<float>>> comparison_inputs(
+    const BenchConfig &config)
+{
+    using namespace crepe::constants;
+
+    std::vector<std::pair<std::string, std::vector<float>>> inputs;
+    try
+    {
+        inputs.emplace_back(config.wav_path, crepe::load_audio(config.wav_path));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Skipping " << config.wav_path << ": " << e.what() << std::endl;
+    }
+    for (const std::string &name : config.signals)
+    {
+        inputs.emplace_back(name, crepe::signals::by_name(name, config.seconds, SAMPLE_RATE));
+    }
+    return inputs;
+}
+
+// Accuracy of the candidate model against the reference model's output, and both speeds
+std::vector<ComparisonReport> compare_models(const BenchConfig &config)
+{
+    using namespace crepe::constants;
+
+    const auto inputs = comparison_inputs(config);
+
+    crepe::EngineOptions reference_options;
+    reference_options.model_path = config.reference_path;
+    crepe::EngineOptions candidate_options;
+    candidate_options.model_path = config.compare_path;
+    crepe::Engine reference(reference_options);
+    crepe::Engine candidate(candidate_options);
+
+    crepe::InferenceOptions options;
+    options.batch_size = config.batch_size;
+
+    std::vector<ComparisonReport> reports;
+    for (const auto &[name, audio] : inputs)
+    {
+        if (audio.empty())
+        {
+            std::cerr << "Unknown signal: " << name << std::endl;
+            continue;
+        }
+        std::cerr << "Comparing on " << name << std::endl;
+
+        const int length = static_cast<int>(audio.size());
+        crepe::PredictionResults expected;
+        crepe::PredictionResults results;
+        reference.run(audio.data(), FRAME_LENGTH, SAMPLE_RATE, results); // warm-up
+        candidate.run(audio.data(), FRAME_LENGTH, SAMPLE_RATE, results);
+
+        ComparisonReport report;
+        report.name = name;
+        report.num_frames = count_frames(audio);
+        const double reference_time = time_best(config.repeats, [&] {
+            reference.run(audio.data(), length, SAMPLE_RATE, expected, options);
+        });
+        const double candidate_time = time_best(config.repeats, [&] {
+            candidate.run(audio.data(), length, SAMPLE_RATE, results, options);
+        });
+        report.reference_fps = report.num_frames / reference_time;
+        report.candidate_fps = report.num_frames / candidate_time;
+        report.accuracy = crepe::metrics::compare(expected, results);
+
+        std::cerr << "  RPA(50c) " << report.accuracy.raw_pitch_accuracy << ", voicing agreement "
+            << report.accuracy.voicing_agreement << ", " << report.candidate_fps << " vs "
+            << report.reference_fps << " frames/s" << std::endl;
+        reports.push_back(std::move(report));
+    }
+    return reports;
+}
+
+std::string comparison_json(const BenchConfig &config,
+                            const std::vector<ComparisonReport> &reports)
+{
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"reference\": \""
+        << (config.reference_path.empty() ? "embedded" : config.reference_path) << "\",\n";
+    out << "  \"candidate\": \"" << config.compare_path << "\",\n";
+    out << "  \"inputs\": [\n";
+    for (size_t r = 0; r < reports.size(); r++)
+    {
+        const ComparisonReport &report = reports[r];
+        const crepe::metrics::Accuracy &accuracy = report.accuracy;
+        out << "    {\"name\": \"" << report.name << "\", \"frames\": " << report.num_frames
+            << ", \"raw_pitch_accuracy\": " << accuracy.raw_pitch_accuracy
+            << ", \"voicing_agreement\": " << accuracy.voicing_agreement
+            << ", \"voicing_precision\": " << accuracy.voicing_precision
+            << ", \"voicing_recall\": " << accuracy.voicing_recall
+            << ", \"mean_cents_error\": " << accuracy.mean_cents_error
+            << ", \"max_cents_error\": " << accuracy.max_cents_error
+            << ", \"reference_frames_per_second\": " << report.reference_fps
+            << ", \"candidate_frames_per_second\": " << report.candidate_fps
+            << ", \"speedup\": " << report.candidate_fps / report.reference_fps << "}"
+            << (r + 1 < reports.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+struct CascadeReport
+{
+    std::string name;
+    crepe::CascadeSummary summary;
+    crepe::metrics::Accuracy accuracy; // of the cascade against the full model alone
+    double full_fps;
+    double cascade_fps;
+};
+
+// The cascade against the full model alone: frames escalated, accuracy delta and speeds
+std::vector<CascadeReport> compare_cascade(const BenchConfig &config)
+{
+    using namespace crepe::constants;
+
+    crepe::EngineOptions screen_options;
+    screen_options.model_path = config.screen_path;
+    crepe::EngineOptions full_options;
+    full_options.model_path = config.cascade_path;
+    crepe::Engine screen(screen_options);
+    crepe::Engine full(full_options);
+
+    crepe::CascadeOptions options;
+    options.inference.batch_size = config.batch_size;
+
+    std::vector<CascadeReport> reports;
+    for (const auto &[name, audio] : comparison_inputs(config))
+    {
+        if (audio.empty())
+        {
+            std::cerr << "Unknown signal: " << name << std::endl;
+            continue;
+        }
+        std::cerr << "Cascade on " << name << std::endl;
+
+        const int length = static_cast<int>(audio.size());
+        crepe::PredictionResults expected;
+        crepe::PredictionResults results;
+        screen.run(audio.data(), FRAME_LENGTH, SAMPLE_RATE, results); // warm-up
+        full.run(audio.data(), FRAME_LENGTH, SAMPLE_RATE, results);
+
+        CascadeReport report;
+        report.name = name;
+        const double full_time = time_best(config.repeats, [&] {
+            full.run(audio.data(), length, SAMPLE_RATE, expected, options.inference);
+        });
+        const double cascade_time = time_best(config.repeats, [&] {
+            results = full.run_cascade(screen, audio.data(), length, SAMPLE_RATE, options,
+                                       &report.summary);
+        });
+        report.full_fps = report.summary.num_frames / full_time;
+        report.cascade_fps = report.summary.num_frames / cascade_time;
+        report.accuracy = crepe::metrics::compare(expected, results);
+
+        std::cerr << "  escalated " << report.summary.escalated << " of "
+            << report.summary.num_frames << ", RPA(50c) " << report.accuracy.raw_pitch_accuracy
+            << ", " << report.cascade_fps << " vs " << report.full_fps << " frames/s"
+            << std::endl;
+        reports.push_back(std::move(report));
+    }
+    return reports;
+}
+
+std::string cascade_json(const BenchConfig &config, const std::vector<CascadeReport> &reports)
+{
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"screen\": \"" << (config.screen_path.empty() ? "embedded" : config.screen_path)
+        << "\",\n";
+    out << "  \"full\": \"" << config.cascade_path << "\",\n";
+    out << "  \"inputs\": [\n";
+    for (size_t r = 0; r < reports.size(); r++)
+    {
+        const CascadeReport &report = reports[r];
+        const crepe::CascadeSummary &summary = report.summary;
+        const crepe::metrics::Accuracy &accuracy = report.accuracy;
+        out << "    {\"name\": \"" << report.name << "\", \"frames\": " << summary.num_frames
+            << ", \"escalated\": " << summary.escalated
+            << ", \"escalated_ambiguous\": " << summary.ambiguous
+            << ", \"escalated_pitch_change\": " << summary.pitch_changed
+            << ", \"escalated_refresh\": " << summary.refreshed
+            << ", \"raw_pitch_accuracy\": " << accuracy.raw_pitch_accuracy
+            << ", \"voicing_agreement\": " << accuracy.voicing_agreement
+            << ", \"mean_cents_error\": " << accuracy.mean_cents_error
+            << ", \"max_cents_error\": " << accuracy.max_cents_error
+            << ", \"full_frames_per_second\": " << report.full_fps
+            << ", \"cascade_frames_per_second\": " << report.cascade_fps
+            << ", \"speedup\": " << report.cascade_fps / report.full_fps << "}"
+            << (r + 1 < reports.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+void write_report(const BenchConfig &config, const std::string &json)
+{
+    if (config.json_path.empty())
+    {
+        std::cout << json;
+    }
+    else
+    {
+        std::ofstream(config.json_path) << json;
+        std::cerr << "Report written to " << config.json_path << std::endl;
+    }
+}
+
+std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+void print_usage()
+{
+    std::cerr << "Usage: crepe_bench [options]\n"
+        << "  --seconds N             synthetic signal length (default 60)\n"
+        << "  --signals a,b           of sine,sweep,noise (the default),vibrato,glissando,\n"
+        << "                          harmonics,noisy\n"
+        << "  --threads N             max threads for the scaling report\n"
+        << "  --batch N               frames per session.Run\n"
+        << "  --repeats N             best-of repeats per measurement (default 3)\n"
+        << "  --latency-iterations N  single-frame calls to sample (default 500)\n"
+        << "  --json PATH             write the JSON report to PATH instead of stdout\n"
+        << "  --stats                 include the engine's runtime stats in the report\n"
+        << "  --compare MODEL.ort     accuracy and speed of MODEL against the reference model\n"
+        << "  --reference MODEL.ort   reference for --compare (default the embedded model)\n"
+        << "  --wav PATH              file compared along with the signals (default sweep.wav)\n"
+        << "  --cascade MODEL         cascade with MODEL as the full model against MODEL alone\n"
+        << "  --screen MODEL          screen model for --cascade (default the embedded model)\n";
+}
+} // namespace
+
+int main(const int argc, char **argv)
+{
+    BenchConfig config;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--seconds" && has_value)
+            config.seconds = std::stod(argv[++i]);
+        else if (arg == "--signals" && has_value)
+            config.signals = split(argv[++i]);
+        else if (arg == "--threads" && has_value)
+            config.max_threads = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--batch" && has_value)
+            config.batch_size = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--repeats" && has_value)
+            config.repeats = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--latency-iterations" && has_value)
+            config.latency_iterations = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--json" && has_value)
+            config.json_path = argv[++i];
+        else if (arg == "--stats")
+            config.engine_stats = true;
+        else if (arg == "--compare" && has_value)
+            config.compare_path = argv[++i];
+        else if (arg == "--reference" && has_value)
+            config.reference_path = argv[++i];
+        else if (arg == "--wav" && has_value)
+            config.wav_path = argv[++i];
+        else if (arg == "--cascade" && has_value)
+            config.cascade_path = argv[++i];
+        else if (arg == "--screen" && has_value)
+            config.screen_path = argv[++i];
+        else
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    crepe::stats::enable(config.engine_stats);
+    std::cerr << "Kernels: " << crepe::simd::kernel_path() << std::endl;
+
+    try
+    {
+        if (!config.compare_path.empty())
+        {
+            write_report(config, comparison_json(config, compare_models(config)));
+            return 0;
+        }
+        if (!config.cascade_path.empty())
+        {
+            write_report(config, cascade_json(config, compare_cascade(config)));
+            return 0;
+        }
+
+        crepe::Engine engine;
+        crepe::InferenceOptions options;
+        options.batch_size = config.batch_size;
+
+        std::vector<SignalReport> reports;
+        for (const std::string &name : config.signals)
+        {
+            const std::vector<float> audio =
+                crepe::signals::by_name(name, config.seconds, crepe::constants::SAMPLE_RATE);
+            if (audio.empty())
+            {
+                std::cerr << "Unknown signal: " << name << std::endl;
+                return 1;
+            }
+
+            std::cerr << "Benchmarking " << name << " (" << config.seconds << "s)" << std::endl;
+
+            SignalReport report;
+            report.name = name;
+            report.num_frames = count_frames(audio);
+            report.stages = time_stages(engine, audio, config);
+
+            crepe::PredictionResults results;
+            report.end_to_end = time_best(config.repeats, [&] {
+                engine.run(audio.data(), static_cast<int>(audio.size()),
+                           crepe::constants::SAMPLE_RATE, results, options);
+            });
+            report.scaling = measure_scaling(audio, config);
+
+            std::cerr << "  " << report.num_frames / report.end_to_end << " frames/s, RTF "
+                << report.end_to_end / config.seconds << std::endl;
+            reports.push_back(std::move(report));
+        }
+
+        const std::vector<double> latencies = single_frame_latencies(config);
+        const std::string json = to_json(
+            config, reports, latencies,
+            config.engine_stats ? crepe::stats::to_json(crepe::stats::snapshot()) : "");
+
+        write_report(config, json);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
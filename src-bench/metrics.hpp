@@ -0,0 +1,91 @@
+#ifndef CREPE_BENCH_METRICS_HPP
+#define CREPE_BENCH_METRICS_HPP
+
+// Pitch tracking accuracy metrics (as in mir_eval), against a reference track that is either
+// ground truth or another model's output on the same frames
+
+#include "crepe.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace crepe::metrics
+{
+inline float to_cents(const float frequency)
+{
+    return constants::CENTS_CONVERSION * std::log2(frequency / constants::BASE_FREQUENCY);
+}
+
+struct Accuracy
+{
+    int reference_voiced = 0; // frames voiced in the reference
+    double raw_pitch_accuracy = 0.0; // of those, the fraction within the cents threshold
+    double voicing_agreement = 0.0; // frames where both agree on voiced/unvoiced
+    double voicing_precision = 0.0; // estimated voiced frames that are voiced in the reference
+    double voicing_recall = 0.0; // reference voiced frames the estimate also voices
+    double mean_cents_error = 0.0; // over reference voiced frames
+    double max_cents_error = 0.0;
+};
+
+// Raw pitch accuracy ignores the estimate's voicing decision, as in mir_eval
+inline Accuracy compare(const Eigen::Ref<const Eigen::VectorXf> &reference_pitches,
+                        const Eigen::Ref<const Eigen::Array<bool, Eigen::Dynamic, 1>> &
+                        reference_voiced,
+                        const PredictionResults &estimate, const float threshold_cents = 50.0f)
+{
+    Accuracy accuracy;
+    const int num_frames = std::min(static_cast<int>(reference_pitches.size()),
+                                    estimate.num_frames);
+    if (num_frames == 0)
+    {
+        return accuracy;
+    }
+
+    int within = 0;
+    int agree = 0;
+    int estimate_voiced = 0;
+    int both_voiced = 0;
+    double total_error = 0.0;
+    for (int i = 0; i < num_frames; i++)
+    {
+        const bool reference = reference_voiced(i);
+        const bool voiced = estimate.voiced(i);
+        agree += reference == voiced;
+        estimate_voiced += voiced;
+        both_voiced += reference && voiced;
+        if (!reference)
+        {
+            continue;
+        }
+
+        accuracy.reference_voiced++;
+        const double error = estimate.pitches(i) > 0.0f
+                                 ? std::abs(to_cents(estimate.pitches(i)) -
+                                            to_cents(reference_pitches(i)))
+                                 : constants::CENTS_CONVERSION * 10.0; // no estimate at all
+        within += error <= threshold_cents;
+        total_error += error;
+        accuracy.max_cents_error = std::max(accuracy.max_cents_error, error);
+    }
+
+    const auto ratio = [](const int a, const int b) {
+        return b > 0 ? static_cast<double>(a) / b : 1.0;
+    };
+    accuracy.raw_pitch_accuracy = ratio(within, accuracy.reference_voiced);
+    accuracy.voicing_agreement = ratio(agree, num_frames);
+    accuracy.voicing_precision = ratio(both_voiced, estimate_voiced);
+    accuracy.voicing_recall = ratio(both_voiced, accuracy.reference_voiced);
+    accuracy.mean_cents_error = accuracy.reference_voiced > 0
+                                    ? total_error / accuracy.reference_voiced
+                                    : 0.0;
+    return accuracy;
+}
+
+inline Accuracy compare(const PredictionResults &reference, const PredictionResults &estimate,
+                        const float threshold_cents = 50.0f)
+{
+    return compare(reference.pitches, reference.voiced, estimate, threshold_cents);
+}
+} // namespace crepe::metrics
+
+#endif //CREPE_BENCH_METRICS_HPP
@@ -0,0 +1,172 @@
+#ifndef CREPE_SIGNALS_HPP
+#define CREPE_SIGNALS_HPP
+
+// Deterministic synthetic test signals, so benchmarks and tests need no audio files
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace crepe::signals
+{
+constexpr double TWO_PI = 6.283185307179586;
+
+inline size_t num_samples(const double seconds, const int sample_rate)
+{
+    return static_cast<size_t>(seconds * sample_rate);
+}
+
+inline std::vector<float> sine(const double frequency, const double seconds, const int sample_rate,
+                               const float amplitude = 0.5f)
+{
+    std::vector<float> audio(num_samples(seconds, sample_rate));
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        audio[i] = amplitude * static_cast<float>(
+                       std::sin(TWO_PI * frequency * static_cast<double>(i) / sample_rate));
+    }
+    return audio;
+}
+
+// Exponential sweep, pitch moves linearly in cents from f_start to f_end
+inline std::vector<float> sweep(const double f_start, const double f_end, const double seconds,
+                                const int sample_rate, const float amplitude = 0.5f)
+{
+    std::vector<float> audio(num_samples(seconds, sample_rate));
+    const double rate = std::log(f_end / f_start) / seconds;
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        const double t = static_cast<double>(i) / sample_rate;
+        // integral of f_start * exp(rate * t)
+        const double phase = rate == 0.0
+                                 ? f_start * t
+                                 : f_start * (std::exp(rate * t) - 1.0) / rate;
+        audio[i] = amplitude * static_cast<float>(std::sin(TWO_PI * phase));
+    }
+    return audio;
+}
+
+inline std::vector<float> noise(const double seconds, const int sample_rate,
+                                const float amplitude = 0.5f, const uint32_t seed = 1)
+{
+    std::vector<float> audio(num_samples(seconds, sample_rate));
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> distribution(-amplitude, amplitude);
+    for (float &sample : audio)
+    {
+        sample = distribution(generator);
+    }
+    return audio;
+}
+
+// Pitch at time t of a vibrato swinging depth_cents either way of frequency, rate_hz times a
+// second
+inline double vibrato_frequency(const double frequency, const double depth_cents,
+                                const double rate_hz, const double t)
+{
+    return frequency * std::exp2(depth_cents / 1200.0 * std::sin(TWO_PI * rate_hz * t));
+}
+
+// Sine following vibrato_frequency
+inline std::vector<float> vibrato(const double frequency, const double depth_cents,
+                                  const double rate_hz, const double seconds,
+                                  const int sample_rate, const float amplitude = 0.5f)
+{
+    std::vector<float> audio(num_samples(seconds, sample_rate));
+    double phase = 0.0;
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        const double t = static_cast<double>(i) / sample_rate;
+        audio[i] = amplitude * static_cast<float>(std::sin(TWO_PI * phase));
+        phase += vibrato_frequency(frequency, depth_cents, rate_hz, t) / sample_rate;
+    }
+    return audio;
+}
+
+// f_start held for the first third, a glide linear in cents over the second, f_end held after
+inline double glissando_frequency(const double f_start, const double f_end, const double seconds,
+                                  const double t)
+{
+    const double position = std::clamp(3.0 * t / seconds - 1.0, 0.0, 1.0);
+    return f_start * std::pow(f_end / f_start, position);
+}
+
+inline std::vector<float> glissando(const double f_start, const double f_end, const double seconds,
+                                    const int sample_rate, const float amplitude = 0.5f)
+{
+    std::vector<float> audio(num_samples(seconds, sample_rate));
+    double phase = 0.0;
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        const double t = static_cast<double>(i) / sample_rate;
+        audio[i] = amplitude * static_cast<float>(std::sin(TWO_PI * phase));
+        phase += glissando_frequency(f_start, f_end, seconds, t) / sample_rate;
+    }
+    return audio;
+}
+
+// Harmonics 2 to last_harmonic of frequency at equal level, nothing at frequency itself
+inline std::vector<float> missing_fundamental(const double frequency, const int last_harmonic,
+                                              const double seconds, const int sample_rate,
+                                              const float amplitude = 0.5f)
+{
+    std::vector<float> audio(num_samples(seconds, sample_rate));
+    const float level = amplitude / static_cast<float>(std::max(last_harmonic - 1, 1));
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        const double t = static_cast<double>(i) / sample_rate;
+        double sample = 0.0;
+        for (int h = 2; h <= last_harmonic; h++)
+        {
+            sample += std::sin(TWO_PI * h * frequency * t);
+        }
+        audio[i] = level * static_cast<float>(sample);
+    }
+    return audio;
+}
+
+// sine() plus white noise snr_db below it
+inline std::vector<float> noisy_sine(const double frequency, const double snr_db,
+                                     const double seconds, const int sample_rate,
+                                     const float amplitude = 0.5f, const uint32_t seed = 1)
+{
+    std::vector<float> audio = sine(frequency, seconds, sample_rate, amplitude);
+
+    // uniform noise in [-a, a] has power a^2 / 3, the sine amplitude^2 / 2
+    const double noise_power = amplitude * amplitude / 2.0 * std::pow(10.0, -snr_db / 10.0);
+    const auto noise_amplitude = static_cast<float>(std::sqrt(3.0 * noise_power));
+    const std::vector<float> added = noise(seconds, sample_rate, noise_amplitude, seed);
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        audio[i] += added[i];
+    }
+    return audio;
+}
+
+// By name, for command line selection: "sine", "sweep", "noise", "vibrato", "glissando",
+// "harmonics" (missing fundamental) or "noisy" (a sine at 10 dB SNR)
+inline std::vector<float> by_name(const std::string &name, const double seconds,
+                                  const int sample_rate)
+{
+    if (name == "sine")
+        return sine(440.0, seconds, sample_rate);
+    if (name == "sweep")
+        return sweep(110.0, 1760.0, seconds, sample_rate);
+    if (name == "noise")
+        return noise(seconds, sample_rate);
+    if (name == "vibrato")
+        return vibrato(330.0, 50.0, 5.5, seconds, sample_rate);
+    if (name == "glissando")
+        return glissando(220.0, 880.0, seconds, sample_rate);
+    if (name == "harmonics")
+        return missing_fundamental(150.0, 6, seconds, sample_rate);
+    if (name == "noisy")
+        return noisy_sine(440.0, 10.0, seconds, sample_rate);
+    return {};
+}
+} // namespace crepe::signals
+
+#endif //CREPE_SIGNALS_HPP
@@ -1,77 +1,148 @@
 #include <iostream>
 #include <vector>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <numbers>
+#include <semaphore>
 #include <thread>
-#include "../deps/queue/readerwriterqueue.h"
 
-#define MINIAUDIO_IMPLEMENTATION
-#include "miniaudio.h"
+#include "miniaudio.h" // implementation is compiled into crepe_core
 #include "crepe.hpp"
+#include "analytics.hpp"
+#include "batch_analysis.hpp"
+#include "file_analysis.hpp"
+#include "stats.hpp"
+#include "track_file.hpp"
 
+using Clock = std::chrono::steady_clock;
 
-class AudioProcessor
+// Blocks of captured samples handed from the audio callback to the analysis thread without locks
+// or allocation. The callback is the only producer and the analysis thread the only consumer;
+// the semaphore counts ready blocks, so the consumer sleeps until there is one.
+class CaptureQueue
 {
-private:
-    moodycamel::ReaderWriterQueue<float> queue;
-    std::atomic<bool> finished{false};
-    size_t frame_size;
-
 public:
-    explicit AudioProcessor(const size_t size) : queue(size * 10), frame_size(size)
+    static constexpr size_t BLOCK_SAMPLES = 256;
+    static constexpr size_t NUM_BLOCKS = 256; // about 4 s at 16 kHz
+
+    struct Block
     {
-    }
+        std::array<float, BLOCK_SAMPLES> samples;
+        size_t count;
+        Clock::time_point captured; // entry of the callback that delivered it
+        // samples dropped before this block since the start, so the consumer can place it on
+        // the timeline despite a gap
+        uint64_t dropped_before;
+    };
 
-    void push(const float *data, const size_t count)
+    // Audio callback side, never blocks: blocks that do not fit are dropped and counted
+    void push(const float *data, size_t count, const Clock::time_point captured)
     {
-        for (size_t i = 0; i < count; i++)
+        while (count > 0)
         {
-            queue.enqueue(data[i]);
+            const size_t head = write_index.load(std::memory_order_relaxed);
+            if (head - read_index.load(std::memory_order_acquire) == NUM_BLOCKS)
+            {
+                // the rest of this push, every block of it
+                dropped.fetch_add((count + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES,
+                                  std::memory_order_relaxed);
+                dropped_total += count;
+                dropped_samples.store(dropped_total, std::memory_order_relaxed);
+                return;
+            }
+
+            Block &block = blocks[head % NUM_BLOCKS];
+            block.count = std::min(count, BLOCK_SAMPLES);
+            std::copy_n(data, block.count, block.samples.begin());
+            block.captured = captured;
+            block.dropped_before = dropped_total;
+            write_index.store(head + 1, std::memory_order_release);
+            ready.release();
+
+            data += block.count;
+            count -= block.count;
         }
     }
 
-    bool get_frame(std::vector<float> &frame)
+    // Analysis side: the oldest block once one is ready, nullptr after timeout. pop() it when done.
+    const Block *wait(const std::chrono::milliseconds timeout)
     {
-        if (finished && queue.size_approx() < frame_size)
-        {
-            return false;
-        }
+        return ready.try_acquire_for(timeout) ? front() : nullptr;
+    }
 
-        //until we have enough data
-        while (queue.size_approx() < frame_size && !finished)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
+    // The oldest block if one is ready, without waiting
+    const Block *try_next()
+    {
+        return ready.try_acquire() ? front() : nullptr;
+    }
 
-        if (queue.size_approx() < frame_size)
-        {
-            return false;
-        }
+    void pop()
+    {
+        read_index.store(read_index.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_release);
+    }
 
-        frame.resize(frame_size);
-        for (size_t i = 0; i < frame_size; i++)
-        {
-            float value;
-            if (bool success = queue.try_dequeue(value); !success)
-                return false;
-            frame[i] = value;
-        }
-        return true;
+    uint64_t dropped_blocks() const { return dropped.load(std::memory_order_relaxed); }
+
+    uint64_t dropped_sample_count() const
+    {
+        return dropped_samples.load(std::memory_order_relaxed);
     }
 
-    void set_finished()
+private:
+    std::array<Block, NUM_BLOCKS> blocks{};
+    std::atomic<size_t> write_index{0};
+    std::atomic<size_t> read_index{0};
+    std::counting_semaphore<> ready{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> dropped_samples{0};
+    uint64_t dropped_total = 0; // producer only
+
+    const Block *front() const
     {
-        finished = true;
+        return &blocks[read_index.load(std::memory_order_relaxed) % NUM_BLOCKS];
     }
 };
 
-//miniaudio callbacl
+struct Capture
+{
+    CaptureQueue queue;
+    float tone_hz = 0.0f; // when set, a test tone replaces the input (the null backend is silent)
+    double tone_phase = 0.0;
+};
+
+//miniaudio callback
 void data_callback(ma_device *device, void *output, const void *input, ma_uint32 frame_count)
 {
-    auto *processor = static_cast<AudioProcessor *>(device->pUserData);
-    const auto *in_samples = static_cast<const float *>(input);
+    const Clock::time_point captured = Clock::now();
+    auto *capture = static_cast<Capture *>(device->pUserData);
 
-    //push
-    processor->push(in_samples, frame_count * device->capture.channels);
+    if (capture->tone_hz > 0.0f)
+    {
+        std::array<float, CaptureQueue::BLOCK_SAMPLES> tone;
+        constexpr double two_pi = 2.0 * std::numbers::pi;
+        const double step = two_pi * capture->tone_hz / device->sampleRate;
+        for (ma_uint32 done = 0; done < frame_count;)
+        {
+            const ma_uint32 count = std::min<ma_uint32>(frame_count - done, tone.size());
+            for (ma_uint32 i = 0; i < count; i++)
+            {
+                tone[i] = 0.5f * static_cast<float>(std::sin(capture->tone_phase));
+                capture->tone_phase = std::fmod(capture->tone_phase + step, two_pi);
+            }
+            capture->queue.push(tone.data(), count, captured);
+            done += count;
+        }
+    }
+    else if (input != nullptr)
+    {
+        capture->queue.push(static_cast<const float *>(input),
+                            frame_count * device->capture.channels, captured);
+    }
 
     // clear if it's required
     if (output != nullptr)
@@ -80,68 +151,304 @@ void data_callback(ma_device *device, void *output, const void *input, ma_uint32
     }
 }
 
-int main()
+// Live pitch from the default capture device (or miniaudio's null backend), until Enter or for
+// duration_seconds. Every 10 ms hop is analysed as soon as the block completing it arrives, and
+// the time from that block's callback to its pitch is reported as p50/p99 at the end.
+int analyse_live(const bool null_backend, const double duration_seconds)
 {
-    try
+    using namespace crepe::constants;
+
+    ma_context context;
+    const ma_backend null_backends[] = {ma_backend_null};
+    if (null_backend && ma_context_init(null_backends, 1, nullptr, &context) != MA_SUCCESS)
     {
-        //init miniaudio
-        ma_device_config config = ma_device_config_init(ma_device_type_capture);
-        config.capture.format = ma_format_f32;
-        config.capture.channels = 1; // Mono for simplicity
-        config.sampleRate = crepe::constants::SAMPLE_RATE;
-        config.dataCallback = data_callback;
+        std::cerr << "Error: Failed to initialize the null audio backend" << std::endl;
+        return 1;
+    }
 
-        AudioProcessor processor(crepe::constants::FRAME_LENGTH);
-        config.pUserData = &processor;
+    Capture capture;
+    capture.tone_hz = null_backend ? 220.0f : 0.0f;
 
-        ma_device device;
-        if (ma_device_init(nullptr, &config, &device) != MA_SUCCESS)
-        {
-            std::cerr << "Error: Failed to initialize audio device" << std::endl;
-        }
+    //init miniaudio
+    ma_device_config config = ma_device_config_init(ma_device_type_capture);
+    config.capture.format = ma_format_f32;
+    config.capture.channels = 1; // Mono for simplicity
+    config.sampleRate = SAMPLE_RATE;
+    config.periodSizeInFrames = FFT_HOP; // one callback per hop
+    config.dataCallback = data_callback;
+    config.pUserData = &capture;
 
-        if (ma_device_start(&device) != MA_SUCCESS)
+    ma_device device;
+    if (ma_device_init(null_backend ? &context : nullptr, &config, &device) != MA_SUCCESS)
+    {
+        std::cerr << "Error: Failed to initialize audio device" << std::endl;
+        if (null_backend)
         {
-            ma_device_uninit(&device);
-            std::cerr << "Error: Failed to start audio device" << std::endl;
+            ma_context_uninit(&context);
         }
+        return 1;
+    }
 
-        std::cout << "Recording. Press Enter to stop." << std::endl;
+    //analysis thread
+    std::atomic<bool> running{true};
+    crepe::stats::Histogram latency_us;
+    int64_t dropped_frames = 0;
+    crepe::OnlineAnalytics analytics;
+    std::thread analysis_thread([&]() {
+        crepe::CrepeStream stream;
+        crepe::PredictionResults results;
+        results.pitches.resize(BATCH_SIZE);
+        results.confidences.resize(BATCH_SIZE);
+        results.times.resize(BATCH_SIZE);
+        results.voiced.resize(BATCH_SIZE);
 
-        //analysis thread
-        std::atomic<bool> running{true};
-        std::thread analysis_thread([&]() {
-            std::vector<float> frame;
-            while (running)
+        // end sample (exclusive) and capture time of every block not yet fully consumed by frames
+        std::deque<std::pair<int64_t, Clock::time_point>> arrivals;
+        int64_t samples = 0;
+
+        // the stream only sees the samples that were kept: where each capture gap falls in it
+        // and the samples dropped up to there, to shift frame times back onto the wall clock
+        std::deque<std::pair<int64_t, uint64_t>> gaps;
+        uint64_t gap_samples = 0; // dropped before the last block pushed
+        uint64_t time_shift = 0; // dropped before the frames being emitted
+
+        while (running)
+        {
+            const CaptureQueue::Block *block = capture.queue.wait(std::chrono::milliseconds(100));
+            // catch up on any backlog before running the model
+            for (; block != nullptr; block = capture.queue.try_next())
+            {
+                if (block->dropped_before != gap_samples)
+                {
+                    gap_samples = block->dropped_before;
+                    gaps.emplace_back(samples, gap_samples);
+                }
+                stream.push(block->samples.data(), block->count);
+                samples += static_cast<int64_t>(block->count);
+                arrivals.emplace_back(samples, block->captured);
+                capture.queue.pop();
+            }
+
+            int count;
+            while ((count = stream.poll(results)) > 0)
             {
-                if (processor.get_frame(frame))
+                const Clock::time_point now = Clock::now();
+                const int64_t first = stream.frames_emitted() - count;
+                for (int i = 0; i < count; i++)
                 {
-                    // Run inference on the frame
-                    // Display the detected pitch
-                    if (crepe::PredictionResults results = crepe::run_inference(
-                        frame, crepe::constants::SAMPLE_RATE); results.num_frames > 0)
+                    // the frame could be analysed once the block holding its last sample arrived
+                    const int64_t frame_end = (first + i) * FFT_HOP + FRAME_LENGTH;
+                    while (arrivals.size() > 1 && arrivals.front().first < frame_end)
                     {
-                        std::cout << "Pitch: " << results.pitches(0) << " Hz, Confidence: "
-                            << results.confidences(0) << "   \r" << std::flush;
+                        arrivals.pop_front();
                     }
+                    const std::chrono::duration<double, std::micro> latency =
+                        now - arrivals.front().second;
+                    latency_us.add(latency.count());
+
+                    // frames starting after a gap move by the audio it lost
+                    while (!gaps.empty() && gaps.front().first <= (first + i) * FFT_HOP)
+                    {
+                        time_shift = gaps.front().second;
+                        gaps.pop_front();
+                    }
+                    results.times(i) += static_cast<float>(time_shift) / SAMPLE_RATE;
                 }
+                analytics.push(results);
+
+                // Display the latest detected pitch
+                const int last = count - 1;
+                std::cout << "Pitch: " << results.pitches(last) << " Hz, Confidence: "
+                    << results.confidences(last) << "   \r" << std::flush;
             }
-        });
+        }
+        dropped_frames = stream.dropped_frames();
+        analytics.finish();
+    });
 
-        // Wait for user to press Enter
+    if (ma_device_start(&device) != MA_SUCCESS)
+    {
+        std::cerr << "Error: Failed to start audio device" << std::endl;
+        running = false;
+    }
+    else if (duration_seconds > 0.0)
+    {
+        std::cout << "Recording for " << duration_seconds << "s." << std::endl;
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration_seconds));
+    }
+    else
+    {
+        std::cout << "Recording. Press Enter to stop." << std::endl;
         std::cin.get();
+    }
 
-        running = false;
-        processor.set_finished();
+    ma_device_uninit(&device);
+    running = false;
+    analysis_thread.join();
+    if (null_backend)
+    {
+        ma_context_uninit(&context);
+    }
+
+    std::cout << "\nRecording stopped." << std::endl;
+    std::cerr << "Latency from capture to pitch over " << latency_us.count << " frames: p50 "
+        << latency_us.percentile(50) / 1000.0 << " ms, p99 " << latency_us.percentile(99) / 1000.0
+        << " ms, max " << latency_us.max / 1000.0 << " ms (" << capture.queue.dropped_blocks()
+        << " blocks and " << dropped_frames << " frames dropped)" << std::endl;
+    if (const uint64_t lost = capture.queue.dropped_sample_count(); lost > 0)
+    {
+        std::cerr << "Capture overran, " << static_cast<double>(lost) / SAMPLE_RATE
+            << "s of audio lost; frame times skip over the gaps" << std::endl;
+    }
+    std::cerr << analytics.num_notes() << " notes, " << analytics.num_voiced_frames() << " of "
+        << analytics.num_frames() << " frames voiced" << std::endl;
+    return 0;
+}
+
+// Offline analysis of a file of any length, CSV on stdout
+int analyse_file(const std::string &path)
+{
+    std::cout << "time,pitch,confidence,voiced\n";
+    const crepe::FileAnalysisSummary summary =
+        crepe::analyze_file(path, crepe::csv_sink(std::cout));
+    std::cerr << "Analysed " << summary.num_frames << " frames ("
+        << summary.duration_seconds << "s, source " << summary.source_sample_rate << "Hz, "
+        << summary.source_channels << " channels)" << std::endl;
+    return 0;
+}
+
+// Note events of a file of any length, segmented while it is analysed, CSV on stdout
+int analyse_notes(const std::string &path)
+{
+    std::cout << "onset,offset,median_pitch,stability_cents,confidence,frames\n";
+    crepe::OnlineAnalytics analytics({}, [](const crepe::NoteEvent &note) {
+        std::cout << note.onset << ',' << note.offset << ',' << note.median_pitch << ','
+            << note.stability_cents << ',' << note.mean_confidence << ',' << note.num_frames
+            << '\n';
+    });
+    const crepe::FileAnalysisSummary summary = crepe::analyze_file(
+        path, [&analytics](const crepe::PredictionResults &chunk) { analytics.push(chunk); });
+    analytics.finish();
+
+    const crepe::PredictionAnalytics totals = analytics.summary();
+    std::cerr << "Found " << analytics.num_notes() << " notes in " << summary.num_frames
+        << " frames (" << summary.duration_seconds << "s, " << analytics.num_voiced_frames()
+        << " voiced, pitch " << totals.min_frequency << "-" << totals.max_frequency
+        << "Hz, mean confidence " << totals.mean_confidence << ")" << std::endl;
+    return 0;
+}
+
+// Offline analysis into a compact track file (see track_file.hpp)
+int analyse_to_track(const std::string &path, const std::string &track_path)
+{
+    crepe::TrackWriter writer(track_path);
+    const crepe::FileAnalysisSummary summary = crepe::analyze_file(
+        path, [&writer](const crepe::PredictionResults &chunk) { writer.append(chunk); });
+    writer.close();
+    std::cerr << "Wrote " << writer.num_frames() << " frames (" << summary.duration_seconds
+        << "s) to " << track_path << std::endl;
+    return 0;
+}
+
+// One pitch track per channel of a multitrack file, CSV on stdout
+int analyse_channels(const std::string &path)
+{
+    int num_channels = 0;
+    int sample_rate = 0;
+    const std::vector<float> audio = crepe::load_audio_channels(path, &num_channels, &sample_rate);
+    const int length = num_channels > 0 ? static_cast<int>(audio.size()) / num_channels : 0;
 
-        if (analysis_thread.joinable())
+    const std::vector<crepe::PredictionResults> tracks = crepe::run_multichannel(
+        audio.data(), length, num_channels, crepe::ChannelLayout::Interleaved, sample_rate);
+
+    std::cout << "channel,time,pitch,confidence,voiced\n";
+    for (int c = 0; c < num_channels; c++)
+    {
+        const crepe::PredictionResults &track = tracks[c];
+        for (int i = 0; i < track.num_frames; i++)
         {
-            analysis_thread.join();
+            std::cout << c << ',' << track.times(i) << ',' << track.pitches(i) << ','
+                << track.confidences(i) << ',' << (track.voiced(i) ? 1 : 0) << '\n';
         }
+    }
+    std::cerr << "Analysed " << num_channels << " channels of "
+        << (num_channels > 0 ? tracks[0].num_frames : 0) << " frames (source " << sample_rate
+        << "Hz)" << std::endl;
+    return 0;
+}
 
-        ma_device_uninit(&device);
-        std::cout << "\nRecording stopped." << std::endl;
+// Corpus analysis, one CSV row per file in completion order
+int analyse_batch(const std::vector<std::string> &paths)
+{
+    std::cout << "file,frames,duration,voiced_ratio,mean_voiced_pitch,error\n";
+    const crepe::BatchAnalysisSummary summary = crepe::analyze_batch(
+        paths, [](crepe::BatchItem &item) {
+            const crepe::PredictionResults &results = item.results;
+            const int voiced = static_cast<int>(results.voiced.count());
+            const float mean_pitch =
+                voiced > 0 ? results.voiced.select(results.pitches.array(), 0.0f).sum() / voiced
+                           : 0.0f;
+            std::cout << item.path << ',' << results.num_frames << ',' << item.duration_seconds
+                << ',' << (results.num_frames > 0
+                               ? static_cast<float>(voiced) / results.num_frames
+                               : 0.0f)
+                << ',' << mean_pitch << ',' << item.error << '\n';
+        });
+    std::cerr << "Analysed " << summary.num_clips << " files (" << summary.num_failed
+        << " failed), " << summary.num_frames << " frames in " << summary.num_batches
+        << " batches, " << summary.audio_seconds << "s of audio in " << summary.wall_seconds
+        << "s" << std::endl;
+    return summary.num_failed == 0 ? 0 : 1;
+}
+
+int main(const int argc, char **argv)
+{
+    try
+    {
+        if (argc == 3 && std::string(argv[1]) == "--file")
+        {
+            return analyse_file(argv[2]);
+        }
+        if (argc == 3 && std::string(argv[1]) == "--notes")
+        {
+            return analyse_notes(argv[2]);
+        }
+        if (argc == 4 && std::string(argv[1]) == "--track")
+        {
+            return analyse_to_track(argv[2], argv[3]);
+        }
+        if (argc == 3 && std::string(argv[1]) == "--channels")
+        {
+            return analyse_channels(argv[2]);
+        }
+        if (argc >= 3 && std::string(argv[1]) == "--batch")
+        {
+            return analyse_batch(std::vector<std::string>(argv + 2, argv + argc));
+        }
 
+        // live input, optionally on the null backend and for a fixed time
+        bool null_backend = false;
+        double duration_seconds = 0.0;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            if (arg == "--null")
+            {
+                null_backend = true;
+            }
+            else if (arg == "--duration" && i + 1 < argc)
+            {
+                duration_seconds = std::stod(argv[++i]);
+            }
+            else
+            {
+                std::cerr << "Usage: crepe_cli [--null] [--duration seconds] | --file path | "
+                    "--notes path | --track path out | --channels path | --batch paths..."
+                    << std::endl;
+                return 1;
+            }
+        }
+        return analyse_live(null_backend, duration_seconds);
     }
     catch (const std::exception &e)
     {
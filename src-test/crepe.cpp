@@ -1,10 +1,79 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <future>
+#include <new>
+#include <thread>
 #include <vector>
 #include "crepe.hpp"
+#include "stats.hpp"
+#include "analytics.hpp"
+#include "batch_analysis.hpp"
+#include "batch_scheduler.hpp"
+#include "decoding.hpp"
+#include "file_analysis.hpp"
+#include "native_model.hpp"
+#include "resampler.hpp"
+#include "track_file.hpp"
+#include "../src-bench/metrics.hpp"
+#include "../src-bench/signals.hpp"
 #include "../deps/miniaudio/miniaudio.h"
 
+// Heap allocation counter for the zero-allocation checks, only counts while enabled
+namespace {
+std::atomic<bool> g_count_allocations{false};
+std::atomic<size_t> g_allocations{0};
+}
+
+// Every replaced form is kept out of line: GCC otherwise inlines them and pairs the malloc/free
+// inside with the operator new/delete at the call site (-Wmismatched-new-delete)
+[[gnu::noinline]] void *operator new(const std::size_t size)
+{
+    if (g_count_allocations.load(std::memory_order_relaxed))
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void *operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    if (g_count_allocations.load(std::memory_order_relaxed))
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc wants a multiple of the alignment
+    const auto align = static_cast<std::size_t>(alignment);
+    if (void *ptr = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) /
+                                                  align * align))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
 std::vector<float> load_wav_file(const std::string &filename, int *out_sample_rate,
                                  std::string *error_msg)
 {
@@ -98,4 +167,1041 @@ TEST_CASE("Frequency Analysis with CREPE - Detailed Output", "[crepe]") {
         CHECK(analytics.max_frequency > analytics.min_frequency);
         CHECK(analytics.time_pitch_correlation > 0.9f);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Batched inference matches per-frame inference", "[crepe][batch]") {
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+
+    crepe::InferenceOptions single;
+    single.batch_size = 1;
+    const crepe::PredictionResults reference = crepe::run_inference(audio_data, sample_rate, single);
+
+    // 37 does not divide the frame count, so the last batch is ragged
+    for (const int batch_size : {7, 37, crepe::constants::BATCH_SIZE, 4096}) {
+        INFO("Batch size: " << batch_size);
+        crepe::InferenceOptions options;
+        options.batch_size = batch_size;
+        const crepe::PredictionResults batched = crepe::run_inference(audio_data, sample_rate, options);
+
+        REQUIRE(batched.num_frames == reference.num_frames);
+        CHECK(batched.times.isApprox(reference.times));
+        CHECK((batched.confidences - reference.confidences).cwiseAbs().maxCoeff() < 1e-4f);
+        CHECK((batched.pitches - reference.pitches).cwiseAbs().maxCoeff() < 1e-3f);
+    }
+}
+
+
+TEST_CASE("Streaming matches offline inference", "[crepe][stream]") {
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+    REQUIRE(sample_rate == crepe::constants::SAMPLE_RATE);
+
+    const crepe::PredictionResults offline = crepe::run_inference(audio_data, sample_rate);
+
+    crepe::CrepeStream stream;
+    crepe::PredictionResults chunk;
+    chunk.pitches.resize(crepe::constants::BATCH_SIZE);
+    chunk.confidences.resize(crepe::constants::BATCH_SIZE);
+    chunk.times.resize(crepe::constants::BATCH_SIZE);
+
+    std::vector<float> pitches;
+    std::vector<float> times;
+
+    // awkward push sizes so frames straddle pushes and the ring wraps
+    constexpr size_t push_size = 333;
+    for (size_t pos = 0; pos < audio_data.size(); pos += push_size) {
+        const size_t count = std::min(push_size, audio_data.size() - pos);
+        stream.push(audio_data.data() + pos, count);
+        while (stream.poll(chunk) > 0) {
+            for (int i = 0; i < chunk.num_frames; i++) {
+                pitches.push_back(chunk.pitches(i));
+                times.push_back(chunk.times(i));
+            }
+        }
+    }
+
+    CHECK(stream.dropped_frames() == 0);
+    REQUIRE(static_cast<int>(pitches.size()) == offline.num_frames);
+    for (int i = 0; i < offline.num_frames; i++) {
+        CHECK(times[i] == Catch::Approx(offline.times(i)));
+        CHECK(pitches[i] == Catch::Approx(offline.pitches(i)).epsilon(1e-3));
+    }
+}
+
+
+TEST_CASE("Independent engines with a session pool", "[crepe][engine]") {
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+
+    crepe::EngineOptions engine_options;
+    engine_options.intra_op_threads = 2;
+    engine_options.num_sessions = 3;
+    crepe::Engine engine(engine_options);
+
+    crepe::InferenceOptions options;
+    options.batch_size = 16; // several batches, so the pool is actually shared
+
+    const crepe::PredictionResults reference = crepe::run_inference(audio_data, sample_rate);
+
+    // concurrent callers on one engine each lease their own sessions
+    std::vector<crepe::PredictionResults> results(4);
+    std::vector<std::thread> callers;
+    for (auto &result : results) {
+        callers.emplace_back([&] { result = engine.run(audio_data, sample_rate, options); });
+    }
+    for (auto &caller : callers) {
+        caller.join();
+    }
+
+    for (const auto &result : results) {
+        REQUIRE(result.num_frames == reference.num_frames);
+        CHECK((result.pitches - reference.pitches).cwiseAbs().maxCoeff() < 1e-3f);
+    }
+}
+
+
+TEST_CASE("Steady-state inference does not allocate per frame", "[crepe][alloc]") {
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+
+    constexpr int short_frames = 64;
+    constexpr int long_frames = 256;
+    const auto frames_to_samples = [](const int frames) {
+        return crepe::constants::FRAME_LENGTH + (frames - 1) * crepe::constants::FFT_HOP;
+    };
+    REQUIRE(static_cast<int>(audio_data.size()) >= frames_to_samples(long_frames));
+
+    crepe::Engine engine;
+    crepe::InferenceOptions options;
+    options.batch_size = long_frames; // one session.Run per call for both lengths
+
+    crepe::PredictionResults short_results;
+    crepe::PredictionResults long_results;
+
+    // warm-up: bound tensors for both batch sizes, result vectors and the ORT arena
+    for (int i = 0; i < 3; i++) {
+        engine.run(audio_data.data(), frames_to_samples(short_frames), sample_rate, short_results,
+                   options);
+        engine.run(audio_data.data(), frames_to_samples(long_frames), sample_rate, long_results,
+                   options);
+    }
+
+    const auto count_allocations = [&](const int frames, crepe::PredictionResults &results) {
+        g_allocations = 0;
+        g_count_allocations = true;
+        engine.run(audio_data.data(), frames_to_samples(frames), sample_rate, results, options);
+        g_count_allocations = false;
+        return g_allocations.load();
+    };
+
+    const size_t short_allocations = count_allocations(short_frames, short_results);
+    const size_t long_allocations = count_allocations(long_frames, long_results);
+
+    INFO("Allocations for " << short_frames << " frames: " << short_allocations);
+    INFO("Allocations for " << long_frames << " frames: " << long_allocations);
+    REQUIRE(long_results.num_frames == long_frames);
+
+    // whatever session.Run needs internally is per call, nothing scales with the frame count
+    CHECK(long_allocations == short_allocations);
+}
+
+
+TEST_CASE("Sliding-window framing matches normalize_audio", "[crepe][framing]") {
+    using namespace crepe::constants;
+
+    int sample_rate = 0;
+    std::string error_msg;
+    std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+
+    // dc offset over the first half and digital silence at the end
+    for (size_t i = 0; i < audio_data.size() / 2; i++)
+        audio_data[i] += 0.25f;
+    std::fill(audio_data.end() - 4 * FRAME_LENGTH, audio_data.end(), 0.0f);
+
+    const int num_frames = (static_cast<int>(audio_data.size()) - FRAME_LENGTH) / FFT_HOP + 1;
+    std::vector<float> frames(static_cast<size_t>(num_frames) * FRAME_LENGTH);
+    crepe::frame_audio(audio_data.data(), num_frames, FFT_HOP, frames.data());
+
+    float max_error = 0.0f;
+    Eigen::VectorXf frame(FRAME_LENGTH);
+    for (int i = 0; i < num_frames; i++) {
+        frame = Eigen::Map<const Eigen::VectorXf>(audio_data.data() + i * FFT_HOP, FRAME_LENGTH);
+        crepe::normalize_audio(frame);
+        const Eigen::Map<const Eigen::VectorXf> framed(frames.data() + static_cast<size_t>(i) * FRAME_LENGTH,
+                                                       FRAME_LENGTH);
+        max_error = std::max(max_error, (framed - frame).cwiseAbs().maxCoeff());
+    }
+
+    INFO("Max abs error: " << max_error);
+    CHECK(max_error < 1e-3f);
+}
+
+
+TEST_CASE("Runtime stats count frames and batches", "[crepe][stats]") {
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+
+    crepe::InferenceOptions options;
+    options.batch_size = 50;
+
+    crepe::stats::reset();
+    crepe::stats::enable(true);
+    const crepe::PredictionResults results = crepe::run_inference(audio_data, sample_rate, options);
+    crepe::stats::enable(false);
+
+    const crepe::stats::Snapshot snapshot = crepe::stats::snapshot();
+    INFO(crepe::stats::to_json(snapshot));
+    CHECK(snapshot.frames == static_cast<uint64_t>(results.num_frames));
+    CHECK(snapshot.run_calls == static_cast<uint64_t>((results.num_frames + 49) / 50));
+    CHECK(snapshot.batch_sizes.max == 50.0);
+    CHECK(snapshot.model_us.count == snapshot.run_calls);
+    CHECK(snapshot.preprocess_us.count == snapshot.run_calls);
+
+    // latencies of whole model batches (hundreds of ms) keep their own buckets
+    crepe::stats::Histogram latency_us;
+    for (int i = 0; i < 98; i++) {
+        latency_us.add(1000.0);
+    }
+    latency_us.add(200000.0);
+    latency_us.add(250000.0);
+    CHECK(latency_us.percentile(50) < 2000.0);
+    CHECK(latency_us.percentile(99) >= 200000.0);
+    CHECK(latency_us.percentile(99) < 250000.0);
+    CHECK(latency_us.percentile(100) == 250000.0);
+
+    // and beyond the last bucket, the max is reported
+    latency_us.add(100e6);
+    CHECK(latency_us.percentile(100) == 100e6);
+}
+
+
+TEST_CASE("Silence gate skips quiet frames", "[crepe][gate]") {
+    using namespace crepe::constants;
+
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> sweep = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!sweep.empty());
+
+    // one second of digital silence either side of the sweep
+    std::vector<float> audio_data(SAMPLE_RATE, 0.0f);
+    audio_data.insert(audio_data.end(), sweep.begin(), sweep.end());
+    audio_data.insert(audio_data.end(), SAMPLE_RATE, 0.0f);
+
+    const crepe::PredictionResults ungated = crepe::run_inference(audio_data, sample_rate);
+
+    crepe::InferenceOptions options;
+    options.silence_threshold_db = -60.0f;
+
+    crepe::stats::reset();
+    crepe::stats::enable(true);
+    const crepe::PredictionResults gated = crepe::run_inference(audio_data, sample_rate, options);
+    crepe::stats::enable(false);
+
+    REQUIRE(gated.num_frames == ungated.num_frames);
+    CHECK(crepe::stats::snapshot().frames < static_cast<uint64_t>(gated.num_frames));
+
+    // frames wholly inside the silence are gated, frames wholly inside the sweep are not
+    const int leading_silent = (SAMPLE_RATE - FRAME_LENGTH) / FFT_HOP + 1;
+    for (int i = 0; i < leading_silent; i++) {
+        CHECK(gated.confidences(i) == 0.0f);
+        CHECK_FALSE(gated.voiced(i));
+    }
+
+    const int first_sweep = SAMPLE_RATE / FFT_HOP;
+    const int last_sweep = (SAMPLE_RATE + static_cast<int>(sweep.size()) - FRAME_LENGTH) / FFT_HOP;
+    for (int i = first_sweep; i <= last_sweep; i++) {
+        CHECK(gated.pitches(i) == Catch::Approx(ungated.pitches(i)).epsilon(1e-3));
+        CHECK(gated.voiced(i) == ungated.voiced(i));
+    }
+}
+
+
+TEST_CASE("Adaptive hop refines only where pitch moves", "[crepe][adaptive]") {
+    using namespace crepe::constants;
+
+    // two sustained notes with a jump between them
+    std::vector<float> audio_data = crepe::signals::sine(220.0, 2.0, SAMPLE_RATE);
+    const std::vector<float> second = crepe::signals::sine(330.0, 2.0, SAMPLE_RATE);
+    audio_data.insert(audio_data.end(), second.begin(), second.end());
+
+    const crepe::PredictionResults full = crepe::run_inference(audio_data, SAMPLE_RATE);
+
+    crepe::InferenceOptions options;
+    options.coarse_hop_frames = 6;
+
+    crepe::stats::reset();
+    crepe::stats::enable(true);
+    const crepe::PredictionResults adaptive = crepe::run_inference(audio_data, SAMPLE_RATE, options);
+    crepe::stats::enable(false);
+
+    const uint64_t evaluated = crepe::stats::snapshot().frames;
+    INFO("Model frames: " << evaluated << " of " << full.num_frames);
+    REQUIRE(adaptive.num_frames == full.num_frames);
+    CHECK(evaluated < static_cast<uint64_t>(full.num_frames) / 3);
+
+    float max_cents_error = 0.0f;
+    for (int i = 0; i < full.num_frames; i++) {
+        if (!full.voiced(i))
+            continue;
+        const float cents_error = 1200.0f * std::abs(std::log2(adaptive.pitches(i) / full.pitches(i)));
+        max_cents_error = std::max(max_cents_error, cents_error);
+    }
+    INFO("Max cents error: " << max_cents_error);
+    CHECK(max_cents_error <= options.refine_cents_threshold);
+}
+
+
+TEST_CASE("Chunked file analysis matches whole-buffer inference", "[crepe][file]") {
+    int sample_rate = 0;
+    std::string error_msg;
+    const std::vector<float> audio_data = load_wav_file("sweep.wav", &sample_rate, &error_msg);
+    REQUIRE(!audio_data.empty());
+    REQUIRE(sample_rate == crepe::constants::SAMPLE_RATE);
+
+    const crepe::PredictionResults whole = crepe::run_inference(audio_data, sample_rate);
+
+    // small chunks so frames straddle chunk boundaries many times
+    crepe::FileAnalysisOptions options;
+    options.chunk_frames = 37;
+    options.queue_depth = 2;
+
+    std::vector<float> pitches;
+    std::vector<float> times;
+    int chunks = 0;
+    const crepe::FileAnalysisSummary summary = crepe::analyze_file(
+        "sweep.wav",
+        [&](const crepe::PredictionResults &chunk) {
+            chunks++;
+            for (int i = 0; i < chunk.num_frames; i++) {
+                pitches.push_back(chunk.pitches(i));
+                times.push_back(chunk.times(i));
+            }
+        },
+        options);
+
+    CHECK(chunks > 1);
+    REQUIRE(summary.num_frames == whole.num_frames);
+    REQUIRE(static_cast<int>(pitches.size()) == whole.num_frames);
+    for (int i = 0; i < whole.num_frames; i++) {
+        CHECK(times[i] == Catch::Approx(whole.times(i)));
+        CHECK(pitches[i] == Catch::Approx(whole.pitches(i)).epsilon(1e-3));
+    }
+
+    // the Viterbi path runs across chunk boundaries instead of restarting at each one
+    crepe::InferenceOptions viterbi;
+    viterbi.decoder = crepe::PitchDecoder::Viterbi;
+    const crepe::PredictionResults smoothed =
+        crepe::run_inference(audio_data, sample_rate, viterbi);
+    options.inference = viterbi;
+    pitches.clear();
+    times.clear();
+    crepe::analyze_file(
+        "sweep.wav",
+        [&](const crepe::PredictionResults &chunk) {
+            for (int i = 0; i < chunk.num_frames; i++) {
+                pitches.push_back(chunk.pitches(i));
+                times.push_back(chunk.times(i));
+            }
+        },
+        options);
+    REQUIRE(static_cast<int>(pitches.size()) == smoothed.num_frames);
+    int agree = 0;
+    for (int i = 0; i < smoothed.num_frames; i++) {
+        CHECK(times[i] == Catch::Approx(smoothed.times(i)));
+        agree += std::abs(crepe::metrics::to_cents(pitches[i]) -
+                          crepe::metrics::to_cents(smoothed.pitches(i))) < 1.0f;
+    }
+    CHECK(agree > smoothed.num_frames * 9 / 10);
+
+    CHECK_THROWS_AS(crepe::analyze_file("missing.wav", [](const crepe::PredictionResults &) {}),
+                    std::runtime_error);
+}
+
+TEST_CASE("Non-16k input is resampled before framing", "[crepe][resample]") {
+    const int source_rate = 44100;
+    const std::vector<float> audio = crepe::signals::sine(440.0, 1.0, source_rate);
+
+    // offline path
+    const crepe::PredictionResults offline = crepe::run_inference(audio, source_rate);
+    // one second of input comes out as one second on the 16 kHz grid
+    REQUIRE(offline.num_frames ==
+            (crepe::constants::SAMPLE_RATE - crepe::constants::FRAME_LENGTH) /
+                    crepe::constants::FFT_HOP +
+                1);
+    const int middle = offline.num_frames / 2;
+    CHECK(offline.pitches(middle) == Catch::Approx(440.0f).epsilon(0.02));
+
+    // streaming path, pushed in uneven blocks so the filter state crosses push boundaries
+    crepe::CrepeStream stream({}, 0, source_rate);
+    crepe::PredictionResults streamed;
+    std::vector<float> pitches;
+    std::vector<float> times;
+    for (size_t pos = 0; pos < audio.size(); pos += 1001) {
+        stream.push(audio.data() + pos, std::min<size_t>(1001, audio.size() - pos));
+        // one poll per push keeps up, an empty results object is sized to the stream
+        stream.poll(streamed);
+        for (int i = 0; i < streamed.num_frames; i++) {
+            pitches.push_back(streamed.pitches(i));
+            times.push_back(streamed.times(i));
+        }
+    }
+    CHECK(stream.dropped_frames() == 0);
+    REQUIRE(pitches.size() > static_cast<size_t>(middle));
+    CHECK(pitches[middle] == Catch::Approx(440.0f).epsilon(0.02));
+    // the resampler delay is taken off, so times refer to the input like the offline ones
+    const float delay = static_cast<float>(crepe::Resampler(source_rate).delay()) /
+                        crepe::constants::SAMPLE_RATE;
+    CHECK(delay > 0.0f);
+    CHECK(times[middle] == Catch::Approx(offline.times(middle) - delay).margin(1e-5));
+
+    // resampling a 16 kHz signal up and back down is close to the identity
+    const std::vector<float> tone = crepe::signals::sine(300.0, 0.25, crepe::constants::SAMPLE_RATE);
+    const std::vector<float> up =
+        crepe::resample(tone.data(), tone.size(), crepe::constants::SAMPLE_RATE, 48000);
+    const std::vector<float> back = crepe::resample(up.data(), up.size(), 48000);
+    REQUIRE(back.size() == tone.size());
+    for (size_t i = 256; i + 256 < tone.size(); i++) {
+        CHECK(back[i] == Catch::Approx(tone[i]).margin(1e-3));
+    }
+
+    // at 192 kHz the transition band is narrow in input samples and the filter needs over 1000
+    // taps: a tone above the 8 kHz Nyquist would alias to 6 kHz, one below passes unchanged
+    const int high_rate = 192000;
+    const auto rms = [](const std::vector<float> &signal) {
+        double sum = 0.0;
+        for (size_t i = 1024; i + 1024 < signal.size(); i++) {
+            sum += static_cast<double>(signal[i]) * signal[i];
+        }
+        return std::sqrt(sum / static_cast<double>(signal.size() - 2048));
+    };
+    const std::vector<float> above = crepe::signals::sine(10000.0, 0.5, high_rate);
+    const std::vector<float> below = crepe::signals::sine(1000.0, 0.5, high_rate);
+    const double aliased = rms(crepe::resample(above.data(), above.size(), high_rate));
+    const double passed = rms(crepe::resample(below.data(), below.size(), high_rate));
+    CHECK(passed == Catch::Approx(rms(below)).epsilon(1e-3));
+    CHECK(20.0 * std::log10(aliased / passed) < -70.0);
+}
+
+TEST_CASE("Batch analysis packs clips into shared batches", "[crepe][batch]") {
+    const int sample_rate = crepe::constants::SAMPLE_RATE;
+
+    // lengths from shorter than one frame to several batches, one clip at another rate
+    const std::vector<std::vector<float>> audio = {
+        crepe::signals::sine(220.0, 0.05, sample_rate),
+        crepe::signals::sine(330.0, 0.2, sample_rate),
+        crepe::signals::sweep(200.0, 800.0, 1.5, sample_rate),
+        crepe::signals::sine(440.0, 0.5, 44100),
+        crepe::signals::noise(0.3, sample_rate),
+    };
+    std::vector<crepe::AudioClip> clips;
+    for (size_t c = 0; c < audio.size(); c++) {
+        clips.push_back({audio[c].data(), audio[c].size(), c == 3 ? 44100 : sample_rate});
+    }
+
+    crepe::BatchAnalysisOptions options;
+    options.num_threads = 3;
+    options.max_open_clips = 2;
+    options.inference.batch_size = 16;
+
+    std::vector<crepe::PredictionResults> results(clips.size());
+    std::vector<int> deliveries(clips.size(), 0);
+    const crepe::BatchAnalysisSummary summary = crepe::analyze_batch(
+        clips,
+        [&](crepe::BatchItem &item) {
+            deliveries[item.index]++;
+            results[item.index] = std::move(item.results);
+        },
+        options);
+
+    CHECK(summary.num_clips == clips.size());
+    CHECK(summary.num_failed == 0);
+    for (size_t c = 0; c < clips.size(); c++) {
+        CHECK(deliveries[c] == 1);
+        const crepe::PredictionResults expected =
+            crepe::run_inference(clips[c].audio_data, static_cast<int>(clips[c].length),
+                                 clips[c].sample_rate);
+        REQUIRE(results[c].num_frames == expected.num_frames);
+        for (int i = 0; i < expected.num_frames; i++) {
+            CHECK(results[c].times(i) == Catch::Approx(expected.times(i)));
+            CHECK(results[c].pitches(i) == Catch::Approx(expected.pitches(i)).epsilon(1e-3));
+        }
+    }
+
+    // unreadable files are reported per item instead of failing the run
+    std::vector<std::string> failed_paths;
+    const crepe::BatchAnalysisSummary missing = crepe::analyze_batch(
+        std::vector<std::string>{"missing.wav", "sweep.wav"},
+        [&](crepe::BatchItem &item) {
+            if (!item.error.empty()) {
+                failed_paths.push_back(item.path);
+            }
+        },
+        options);
+    CHECK(missing.num_failed == 1);
+    CHECK(failed_paths == std::vector<std::string>{"missing.wav"});
+
+    // adaptive clips are analysed whole on the pool workers, with the same result
+    options.inference.coarse_hop_frames = 6;
+    std::vector<crepe::PredictionResults> adaptive(clips.size());
+    crepe::analyze_batch(
+        clips, [&](crepe::BatchItem &item) { adaptive[item.index] = std::move(item.results); },
+        options);
+    for (size_t c = 0; c < clips.size(); c++) {
+        const crepe::PredictionResults expected =
+            crepe::run_inference(clips[c].audio_data, static_cast<int>(clips[c].length),
+                                 clips[c].sample_rate, options.inference);
+        REQUIRE(adaptive[c].num_frames == expected.num_frames);
+        for (int i = 0; i < expected.num_frames; i++) {
+            CHECK(adaptive[c].pitches(i) == Catch::Approx(expected.pitches(i)).epsilon(1e-3));
+        }
+    }
+}
+
+TEST_CASE("Scheduler batches concurrent requests together", "[crepe][batch]") {
+    const int sample_rate = crepe::constants::SAMPLE_RATE;
+    const std::vector<std::vector<float>> audio = {
+        crepe::signals::sine(220.0, 0.2, sample_rate),
+        crepe::signals::sweep(200.0, 800.0, 0.7, sample_rate),
+        crepe::signals::sine(440.0, 0.5, 44100),
+        crepe::signals::sine(330.0, 0.3, sample_rate),
+        crepe::signals::noise(0.4, sample_rate),
+        crepe::signals::sine(550.0, 1.0, sample_rate),
+    };
+    const auto rate_of = [&](const size_t c) { return c == 2 ? 44100 : sample_rate; };
+
+    crepe::EngineOptions engine_options;
+    engine_options.num_sessions = 2;
+    crepe::Engine engine(engine_options);
+
+    crepe::BatchSchedulerOptions options;
+    options.inference.batch_size = 32;
+    options.max_delay_ms = 500.0; // long enough that only full batches run until the end
+
+    std::vector<std::future<crepe::PredictionResults>> futures(audio.size());
+    crepe::stats::reset();
+    crepe::stats::enable(true);
+    {
+        crepe::BatchScheduler scheduler(engine, options);
+        std::vector<std::thread> callers;
+        for (size_t c = 0; c < audio.size(); c++) {
+            callers.emplace_back([&, c] { futures[c] = scheduler.submit(audio[c], rate_of(c)); });
+        }
+        for (std::thread &caller : callers) {
+            caller.join();
+        }
+
+        // shorter than a frame, answered right away through the callback
+        int short_frames = -1;
+        scheduler.submit(std::vector<float>(100, 0.0f), sample_rate,
+                         [&](crepe::PredictionResults results, const std::exception_ptr &error) {
+                             CHECK_FALSE(error);
+                             short_frames = results.num_frames;
+                         });
+        CHECK(short_frames == 0);
+    }
+    crepe::stats::enable(false);
+
+    const crepe::stats::Snapshot snapshot = crepe::stats::snapshot();
+    INFO(crepe::stats::to_json(snapshot));
+    CHECK(snapshot.batch_sizes.max == options.inference.batch_size);
+    CHECK(snapshot.request_us.count == audio.size() + 1);
+
+    for (size_t c = 0; c < audio.size(); c++) {
+        const crepe::PredictionResults results = futures[c].get();
+        const crepe::PredictionResults expected = crepe::run_inference(
+            audio[c].data(), static_cast<int>(audio[c].size()), rate_of(c));
+        REQUIRE(results.num_frames == expected.num_frames);
+        for (int i = 0; i < expected.num_frames; i++) {
+            CHECK(results.times(i) == Catch::Approx(expected.times(i)));
+            CHECK(results.pitches(i) == Catch::Approx(expected.pitches(i)).epsilon(1e-3));
+        }
+    }
+}
+
+TEST_CASE("Multichannel tracking keeps channels apart", "[crepe][multichannel]") {
+    constexpr int rate = crepe::constants::SAMPLE_RATE;
+    const std::vector<std::vector<float>> channels = {
+        crepe::signals::sine(220.0, 1.0, rate),
+        crepe::signals::sweep(300.0, 900.0, 1.0, rate),
+        crepe::signals::sine(660.0, 1.0, rate),
+    };
+    const int num_channels = static_cast<int>(channels.size());
+    const int length = static_cast<int>(channels[0].size());
+
+    std::vector<float> interleaved(static_cast<size_t>(length) * num_channels);
+    std::vector<float> planar;
+    for (int c = 0; c < num_channels; c++) {
+        for (int t = 0; t < length; t++) {
+            interleaved[static_cast<size_t>(t) * num_channels + c] = channels[c][t];
+        }
+        planar.insert(planar.end(), channels[c].begin(), channels[c].end());
+    }
+
+    crepe::InferenceOptions options;
+    options.batch_size = 48; // batches straddle channel boundaries
+    const std::vector<crepe::PredictionResults> from_interleaved = crepe::run_multichannel(
+        interleaved.data(), length, num_channels, crepe::ChannelLayout::Interleaved, rate, options);
+    const std::vector<crepe::PredictionResults> from_planar = crepe::run_multichannel(
+        planar.data(), length, num_channels, crepe::ChannelLayout::Planar, rate, options);
+
+    REQUIRE(from_interleaved.size() == channels.size());
+    REQUIRE(from_planar.size() == channels.size());
+    for (int c = 0; c < num_channels; c++) {
+        const crepe::PredictionResults expected = crepe::run_inference(channels[c], rate);
+        REQUIRE(from_interleaved[c].num_frames == expected.num_frames);
+        REQUIRE(from_planar[c].num_frames == expected.num_frames);
+        for (int i = 0; i < expected.num_frames; i++) {
+            CHECK(from_interleaved[c].times(i) == Catch::Approx(expected.times(i)));
+            CHECK(from_interleaved[c].pitches(i) == Catch::Approx(expected.pitches(i)).epsilon(1e-4));
+            CHECK(from_planar[c].pitches(i) == Catch::Approx(expected.pitches(i)).epsilon(1e-4));
+        }
+    }
+
+    // other rates are resampled per channel
+    const std::vector<float> left = crepe::signals::sine(220.0, 1.0, 44100);
+    const std::vector<float> right = crepe::signals::sine(440.0, 1.0, 44100);
+    std::vector<float> stereo;
+    for (size_t t = 0; t < left.size(); t++) {
+        stereo.push_back(left[t]);
+        stereo.push_back(right[t]);
+    }
+    const std::vector<crepe::PredictionResults> resampled = crepe::run_multichannel(
+        stereo.data(), static_cast<int>(left.size()), 2, crepe::ChannelLayout::Interleaved, 44100);
+    const crepe::PredictionResults expected_right = crepe::run_inference(right, 44100);
+    REQUIRE(resampled[1].num_frames == expected_right.num_frames);
+    for (int i = 0; i < expected_right.num_frames; i++) {
+        CHECK(resampled[1].pitches(i) == Catch::Approx(expected_right.pitches(i)).epsilon(1e-4));
+    }
+}
+
+TEST_CASE("Track files round-trip and answer time-range queries", "[crepe][track]") {
+    const crepe::PredictionResults results = crepe::run_inference(
+        crepe::signals::sweep(100.0, 1000.0, 2.0, crepe::constants::SAMPLE_RATE),
+        crepe::constants::SAMPLE_RATE);
+    REQUIRE(results.num_frames > 100);
+
+    crepe::TrackHeader header;
+    header.chunk_frames = 64; // several chunks and a partial last one
+    {
+        crepe::TrackWriter writer("sweep.trk", header);
+        writer.append(results);
+        writer.append(results);
+        CHECK(writer.num_frames() == 2 * results.num_frames);
+    }
+
+    const crepe::TrackReader reader("sweep.trk");
+    REQUIRE(reader.num_frames() == 2 * results.num_frames);
+
+    crepe::PredictionResults all;
+    REQUIRE(reader.read_frames(0, static_cast<int>(reader.num_frames()), all) ==
+            reader.num_frames());
+    for (int i = 0; i < all.num_frames; i++) {
+        const int source = i % results.num_frames;
+        CHECK(all.times(i) == Catch::Approx(i * 0.01f));
+        CHECK(all.pitches(i) == Catch::Approx(results.pitches(source)).epsilon(1e-4));
+        CHECK(all.confidences(i) == Catch::Approx(results.confidences(source)).margin(0.5 / 255));
+        CHECK(all.voiced(i) == results.voiced(source));
+    }
+
+    // frames whose time is in [0.5, 0.75)
+    crepe::PredictionResults range;
+    REQUIRE(reader.read_range(0.5, 0.75, range) == 25);
+    CHECK(range.times(0) == Catch::Approx(0.5f));
+    CHECK(range.pitches(0) == Catch::Approx(results.pitches(50)).epsilon(1e-4));
+    CHECK(reader.read_range(1000.0, 1001.0, range) == 0);
+
+    std::ofstream("not_a.trk") << "not a track file";
+    CHECK_THROWS_AS(crepe::TrackReader("not_a.trk"), std::runtime_error);
+
+    // a bad header is rejected before the existing track is truncated
+    crepe::TrackHeader bad;
+    bad.hop = 0;
+    CHECK_THROWS_AS(crepe::TrackWriter("sweep.trk", bad), std::invalid_argument);
+    CHECK(crepe::TrackReader("sweep.trk").num_frames() == 2 * results.num_frames);
+
+    // results without a voicing flag per frame
+    crepe::PredictionResults unvoiced = results;
+    unvoiced.voiced.resize(0);
+    crepe::TrackWriter writer("unvoiced.trk", header);
+    CHECK_THROWS_AS(writer.append(unvoiced), std::invalid_argument);
+}
+
+TEST_CASE("Activation cache skips the model for audio it has seen", "[crepe][cache]") {
+    const std::vector<float> audio =
+        crepe::signals::sweep(150.0, 900.0, 2.0, crepe::constants::SAMPLE_RATE);
+    const crepe::PredictionResults uncached =
+        crepe::run_inference(audio, crepe::constants::SAMPLE_RATE);
+
+    std::filesystem::remove_all("activation_cache");
+    crepe::EngineOptions options;
+    options.activation_cache_dir = "activation_cache";
+    crepe::Engine engine(options);
+
+    crepe::stats::reset();
+    crepe::stats::enable(true);
+    const crepe::PredictionResults first = engine.run(audio, crepe::constants::SAMPLE_RATE);
+    const uint64_t first_frames = crepe::stats::snapshot().frames;
+
+    // a different voicing threshold is only a decoding change
+    crepe::InferenceOptions strict;
+    strict.voicing_threshold = 0.8f;
+    const crepe::PredictionResults second =
+        engine.run(audio, crepe::constants::SAMPLE_RATE, strict);
+    const uint64_t second_frames = crepe::stats::snapshot().frames - first_frames;
+    crepe::stats::enable(false);
+
+    CHECK(first_frames == static_cast<uint64_t>(uncached.num_frames));
+    CHECK(second_frames == 0);
+
+    REQUIRE(second.num_frames == uncached.num_frames);
+    for (int i = 0; i < uncached.num_frames; i++) {
+        CHECK(first.pitches(i) == Catch::Approx(uncached.pitches(i)));
+        // fp16 entries, a near-tie may land on the neighbouring 20 cent bin
+        CHECK(std::abs(crepe::metrics::to_cents(second.pitches(i)) -
+                       crepe::metrics::to_cents(uncached.pitches(i))) <= 21.0f);
+        CHECK(second.confidences(i) == Catch::Approx(uncached.confidences(i)).margin(2e-3));
+        CHECK(second.voiced(i) == (second.confidences(i) >= 0.8f));
+    }
+
+    // other audio is a miss
+    std::vector<float> other = audio;
+    other[0] += 0.25f;
+    crepe::stats::reset();
+    crepe::stats::enable(true);
+    engine.run(other, crepe::constants::SAMPLE_RATE);
+    crepe::stats::enable(false);
+    CHECK(crepe::stats::snapshot().frames == static_cast<uint64_t>(uncached.num_frames));
+}
+
+TEST_CASE("Weighted average and Viterbi decoding", "[crepe][decoder]") {
+    using crepe::constants::OUTPUT_SIZE;
+
+    // the SIMD argmax keeps the first of equal maxima
+    std::vector<float> row(OUTPUT_SIZE, 0.25f);
+    row[37] = 0.5f;
+    row[301] = 0.5f;
+    CHECK(crepe::argmax_bin(row.data()) == 37);
+    CHECK(crepe::local_average_cents(row.data(), 37) > crepe::bin_to_cents(36.0f));
+
+    // halfway between two bins, where the argmax is 10 cents off
+    const float cents = crepe::bin_to_cents(227.5f);
+    const float frequency = crepe::cents_to_frequency(cents);
+    const std::vector<float> tone =
+        crepe::signals::sine(frequency, 1.0, crepe::constants::SAMPLE_RATE);
+    crepe::InferenceOptions weighted;
+    weighted.decoder = crepe::PitchDecoder::WeightedAverage;
+    const crepe::PredictionResults plain =
+        crepe::run_inference(tone, crepe::constants::SAMPLE_RATE);
+    const crepe::PredictionResults refined =
+        crepe::run_inference(tone, crepe::constants::SAMPLE_RATE, weighted);
+    REQUIRE(refined.num_frames == plain.num_frames);
+    double plain_error = 0.0;
+    double refined_error = 0.0;
+    for (int i = 0; i < plain.num_frames; i++) {
+        plain_error += std::abs(crepe::metrics::to_cents(plain.pitches(i)) - cents);
+        refined_error += std::abs(crepe::metrics::to_cents(refined.pitches(i)) - cents);
+        CHECK(refined.confidences(i) == plain.confidences(i));
+    }
+    CHECK(refined_error < plain_error);
+
+    // a steady track with one frame jumping an octave up
+    constexpr int num_frames = 60;
+    std::vector<float> activations(static_cast<size_t>(num_frames) * OUTPUT_SIZE);
+    for (int t = 0; t < num_frames; t++) {
+        const int peak = t == 30 ? 260 : 200 + t / 10;
+        for (int b = 0; b < OUTPUT_SIZE; b++) {
+            activations[static_cast<size_t>(t) * OUTPUT_SIZE + b] =
+                0.9f * std::exp(-0.5f * static_cast<float>((b - peak) * (b - peak)) / 2.0f);
+        }
+    }
+    crepe::ViterbiDecoder decoder;
+    std::vector<int> path(num_frames);
+    decoder.decode_path(activations.data(), num_frames, path.data());
+    CHECK(crepe::argmax_bin(activations.data() + 30 * OUTPUT_SIZE) == 260);
+    CHECK(std::abs(path[30] - 203) <= 1);
+    for (int t = 0; t < num_frames; t++) {
+        if (t != 30)
+            CHECK(path[t] == 200 + t / 10);
+    }
+    std::vector<float> pitches(num_frames);
+    decoder.decode(activations.data(), num_frames, pitches.data());
+
+    // fixed lag: every frame is decided lag frames late, the end by flush
+    crepe::OnlineViterbi online(16);
+    std::vector<float> streamed;
+    for (int t = 0; t < num_frames; t++) {
+        float pitch;
+        float confidence;
+        if (online.push(activations.data() + static_cast<size_t>(t) * OUTPUT_SIZE, pitch,
+                        confidence))
+            streamed.push_back(pitch);
+        CHECK(online.frames_decided() == std::max(t + 1 - 16, 0));
+    }
+    std::vector<float> tail(16);
+    std::vector<float> tail_confidences(16);
+    CHECK(online.flush(tail.data(), tail_confidences.data(), 16) == 16);
+    streamed.insert(streamed.end(), tail.begin(), tail.end());
+    REQUIRE(streamed.size() == pitches.size());
+    for (int t = 0; t < num_frames; t++)
+        CHECK(streamed[t] == Catch::Approx(pitches[t]));
+
+    // the engine and the stream on real audio
+    const std::vector<float> audio =
+        crepe::signals::sweep(150.0, 600.0, 2.0, crepe::constants::SAMPLE_RATE);
+    crepe::InferenceOptions viterbi;
+    viterbi.decoder = crepe::PitchDecoder::Viterbi;
+    const crepe::PredictionResults smoothed =
+        crepe::run_inference(audio, crepe::constants::SAMPLE_RATE, viterbi);
+    const crepe::PredictionResults reference =
+        crepe::run_inference(audio, crepe::constants::SAMPLE_RATE, weighted);
+    REQUIRE(smoothed.num_frames == reference.num_frames);
+    int agree = 0;
+    for (int i = 0; i < smoothed.num_frames; i++) {
+        CHECK(smoothed.confidences(i) == reference.confidences(i));
+        agree += std::abs(crepe::metrics::to_cents(smoothed.pitches(i)) -
+                          crepe::metrics::to_cents(reference.pitches(i))) < 25.0f;
+    }
+    CHECK(agree > smoothed.num_frames * 9 / 10);
+
+    crepe::CrepeStream stream(viterbi, 32);
+    crepe::PredictionResults chunk;
+    chunk.pitches.resize(32);
+    chunk.confidences.resize(32);
+    chunk.times.resize(32);
+    std::vector<float> stream_pitches;
+    const auto collect = [&] {
+        for (int i = 0; i < chunk.num_frames; i++) {
+            CHECK(chunk.times(i) == Catch::Approx(stream_pitches.size() * 0.01f));
+            stream_pitches.push_back(chunk.pitches(i));
+        }
+    };
+    for (size_t pos = 0; pos < audio.size(); pos += 480) {
+        stream.push(audio.data() + pos, std::min<size_t>(480, audio.size() - pos));
+        while (stream.pending_frames() > 0) {
+            stream.poll(chunk);
+            collect();
+        }
+    }
+    stream.flush(chunk);
+    collect();
+    REQUIRE(stream_pitches.size() == static_cast<size_t>(smoothed.num_frames));
+    int stream_agree = 0;
+    for (int i = 0; i < smoothed.num_frames; i++) {
+        stream_agree += std::abs(crepe::metrics::to_cents(stream_pitches[i]) -
+                                 crepe::metrics::to_cents(smoothed.pitches(i))) < 1.0f;
+    }
+    CHECK(stream_agree > smoothed.num_frames * 9 / 10);
+}
+
+TEST_CASE("Online analytics segments notes as frames arrive", "[crepe][analytics]") {
+    // 220 Hz with vibrato, a gap, a blip too short to be a note, then 330 Hz stepping straight
+    // (legato) into 440 Hz
+    std::vector<std::pair<float, float>> track; // pitch, confidence
+    for (int i = 0; i < 30; i++) {
+        track.emplace_back(220.0f * std::pow(2.0f, 0.2f * std::sin(0.5f * i) / 12.0f), 0.9f);
+    }
+    for (int i = 0; i < 5; i++) {
+        track.emplace_back(180.0f, 0.1f);
+    }
+    for (int i = 0; i < 3; i++) {
+        track.emplace_back(500.0f, 0.8f);
+    }
+    track.emplace_back(0.0f, 0.0f);
+    for (int i = 0; i < 20; i++) {
+        track.emplace_back(330.0f, 0.7f);
+    }
+    for (int i = 0; i < 12; i++) {
+        track.emplace_back(440.0f, 0.8f);
+    }
+
+    crepe::PredictionResults results;
+    const int n = static_cast<int>(track.size());
+    results.num_frames = n;
+    results.times.resize(n);
+    results.pitches.resize(n);
+    results.confidences.resize(n);
+    results.voiced.resize(n);
+    for (int i = 0; i < n; i++) {
+        results.times(i) = 0.01f * static_cast<float>(i);
+        results.pitches(i) = track[i].first;
+        results.confidences(i) = track[i].second;
+        results.voiced(i) = track[i].second >= crepe::constants::CONFIDENCE_THRESHOLD;
+    }
+
+    crepe::OnlineAnalyticsOptions options;
+    options.window_frames = 20;
+    std::vector<crepe::NoteEvent> notes;
+    crepe::OnlineAnalytics analytics(options, [&](const crepe::NoteEvent &note) {
+        notes.push_back(note);
+    });
+    for (int i = 0; i < n; i++) {
+        analytics.push(results.times(i), results.pitches(i), results.confidences(i));
+        if (i == 29) {
+            CHECK(notes.empty()); // still open
+        }
+    }
+    CHECK(notes.size() == 2);
+    analytics.finish();
+
+    REQUIRE(notes.size() == 3);
+    CHECK(analytics.num_notes() == 3);
+    CHECK(notes[0].onset == Catch::Approx(0.0f));
+    CHECK(notes[0].offset == Catch::Approx(0.30f));
+    CHECK(notes[0].num_frames == 30);
+    CHECK(notes[0].median_pitch == Catch::Approx(220.0f).epsilon(0.01));
+    CHECK(notes[0].stability_cents > 5.0f);
+    CHECK(notes[0].stability_cents < 20.0f);
+    CHECK(notes[1].onset == Catch::Approx(0.39f));
+    CHECK(notes[1].num_frames == 20);
+    CHECK(notes[1].median_pitch == Catch::Approx(330.0f));
+    CHECK(notes[1].stability_cents == Catch::Approx(0.0f).margin(1e-3));
+    CHECK(notes[2].onset == Catch::Approx(0.59f));
+    CHECK(notes[2].offset == Catch::Approx(0.71f));
+    CHECK(notes[2].mean_confidence == Catch::Approx(0.8f));
+
+    // whole-track statistics match a pass over the full arrays
+    const crepe::PredictionAnalytics online = analytics.summary();
+    CHECK(online.min_frequency == results.pitches.minCoeff());
+    CHECK(online.max_frequency == results.pitches.maxCoeff());
+    CHECK(online.mean_confidence == Catch::Approx(results.confidences.mean()));
+    CHECK(online.time_pitch_correlation ==
+          Catch::Approx(crepe::calculate_correlation(results.times, results.pitches)).epsilon(1e-4));
+    CHECK(analytics.num_voiced_frames() == results.voiced.count());
+
+    // the window holds the last 20 frames: 8 of 330 Hz and 12 of 440 Hz
+    const crepe::WindowStats window = analytics.window();
+    CHECK(window.num_frames == 20);
+    CHECK(window.voiced_ratio == Catch::Approx(1.0f));
+    CHECK(window.mean_confidence == Catch::Approx((8 * 0.7f + 12 * 0.8f) / 20.0f));
+    CHECK(window.mean_voiced_pitch ==
+          Catch::Approx(330.0f * std::pow(440.0f / 330.0f, 12.0f / 20.0f)).epsilon(1e-4));
+
+    analytics.reset();
+    CHECK(analytics.num_frames() == 0);
+    CHECK(analytics.window().num_frames == 0);
+}
+
+TEST_CASE("Cascade only escalates ambiguous or moving frames", "[crepe][cascade]") {
+    const int sample_rate = crepe::constants::SAMPLE_RATE;
+    const std::vector<float> sine = crepe::signals::sine(440.0, 2.0, sample_rate);
+    const std::vector<float> sweep = crepe::signals::sweep(200.0, 800.0, 2.0, sample_rate);
+
+    // the same model on both sides, so every kept frame must reproduce the plain run
+    crepe::Engine screen;
+    crepe::Engine full;
+    for (const std::vector<float> *audio : {&sine, &sweep}) {
+        const int length = static_cast<int>(audio->size());
+        const crepe::PredictionResults expected = full.run(audio->data(), length, sample_rate);
+
+        crepe::CascadeSummary summary;
+        const crepe::PredictionResults results =
+            full.run_cascade(screen, audio->data(), length, sample_rate, {}, &summary);
+        REQUIRE(results.num_frames == expected.num_frames);
+        CHECK(summary.num_frames == expected.num_frames);
+        CHECK(summary.escalated ==
+              summary.ambiguous + summary.pitch_changed + summary.refreshed);
+        for (int i = 0; i < expected.num_frames; i++) {
+            CHECK(results.pitches(i) == Catch::Approx(expected.pitches(i)).epsilon(1e-3));
+            CHECK(results.confidences(i) == Catch::Approx(expected.confidences(i)));
+        }
+
+        if (audio == &sine) {
+            CHECK(summary.escalated < expected.num_frames / 10);
+        } else {
+            CHECK(summary.pitch_changed > 0); // 2 octaves over 2 s, 12 cents per frame
+        }
+    }
+
+    // everything ambiguous: the full model runs on every frame
+    crepe::CascadeOptions always;
+    always.ambiguous_low = 0.0f;
+    always.ambiguous_high = 2.0f;
+    crepe::CascadeSummary summary;
+    full.run_cascade(screen, sweep.data(), static_cast<int>(sweep.size()), sample_rate, always,
+                     &summary);
+    CHECK(summary.escalated == summary.num_frames);
+    CHECK(summary.ambiguous == summary.num_frames);
+}
+
+TEST_CASE("Engines load capacities from mapped model files", "[crepe][engine]") {
+    const std::vector<float> audio =
+        crepe::signals::sweep(200.0, 800.0, 1.0, crepe::constants::SAMPLE_RATE);
+    const crepe::PredictionResults embedded =
+        crepe::run_inference(audio, crepe::constants::SAMPLE_RATE);
+
+    crepe::EngineOptions options;
+    options.model_dir = "models";
+    options.capacity = crepe::Capacity::Tiny;
+    options.num_sessions = 2;
+    crepe::Engine mapped(options);
+    // the default backend picks the file format, .onnx weights for the native one
+    CHECK(mapped.model_path() == (options.backend == crepe::Backend::Native
+                                      ? "models/model-tiny.onnx"
+                                      : "models/model-tiny.ort"));
+
+    // a second engine over the same file shares the mapping
+    crepe::Engine second(options);
+
+    const crepe::PredictionResults results = mapped.run(audio, crepe::constants::SAMPLE_RATE);
+    const crepe::PredictionResults again = second.run(audio, crepe::constants::SAMPLE_RATE);
+    REQUIRE(results.num_frames == embedded.num_frames);
+    for (int i = 0; i < embedded.num_frames; i++) {
+        CHECK(results.pitches(i) == Catch::Approx(embedded.pitches(i)));
+        CHECK(again.pitches(i) == Catch::Approx(embedded.pitches(i)));
+    }
+
+    crepe::EngineOptions missing;
+    missing.model_path = "models/missing.ort";
+    CHECK_THROWS_AS(crepe::Engine(missing), std::runtime_error);
+
+    crepe::EngineOptions not_embedded;
+    not_embedded.capacity = crepe::Capacity::Full;
+    CHECK_THROWS_AS(crepe::Engine(not_embedded), std::invalid_argument);
+}
+
+#ifdef CREPE_WITH_ORT
+TEST_CASE("Native backend matches the ONNX Runtime model", "[crepe][native]") {
+    const std::vector<float> audio =
+        crepe::signals::sweep(100.0, 1000.0, 1.0, crepe::constants::SAMPLE_RATE);
+    const crepe::PredictionResults reference =
+        crepe::run_inference(audio, crepe::constants::SAMPLE_RATE);
+
+    crepe::EngineOptions options;
+    options.backend = crepe::Backend::Native;
+    options.intra_op_threads = 2;
+    crepe::Engine native(options);
+
+    const crepe::PredictionResults results = native.run(audio, crepe::constants::SAMPLE_RATE);
+    REQUIRE(results.num_frames == reference.num_frames);
+    for (int i = 0; i < reference.num_frames; i++) {
+        CHECK(results.pitches(i) == Catch::Approx(reference.pitches(i)).epsilon(1e-3));
+        CHECK(results.confidences(i) == Catch::Approx(reference.confidences(i)).margin(1e-3));
+    }
+}
+#endif
+
+TEST_CASE("Native backend rejects what it cannot read", "[crepe][native]") {
+    // the native backend only reads float ONNX graphs
+    crepe::EngineOptions int8;
+    int8.backend = crepe::Backend::Native;
+    int8.precision = crepe::Precision::Int8;
+    int8.model_dir = "models";
+    CHECK_THROWS_AS(crepe::Engine(int8), std::invalid_argument);
+
+    const unsigned char garbage[] = {0x08, 0x07, 0x12, 0x03, 'b', 'a', 'd'};
+    CHECK_THROWS_AS(crepe::NativeWeights::from_onnx(garbage, sizeof(garbage)),
+                    std::runtime_error);
+}
@@ -0,0 +1,529 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "crepe.hpp"
+#include "activation_cache.hpp"
+#include "batch_scheduler.hpp"
+#include "file_analysis.hpp"
+#include "track_file.hpp"
+#include "../src-bench/metrics.hpp"
+#include "../src-bench/signals.hpp"
+
+// Golden-output regression suite. Every engine configuration is run over the same synthetic and
+// recorded signals and checked against stored golden activations and pitch tracks, with its
+// accuracy and throughput reported side by side, so an optimisation that trades accuracy for
+// speed shows up as a failure rather than as a faster benchmark.
+//
+// CREPE_UPDATE_GOLDEN=1 regenerates the stored outputs from the reference configuration,
+// CREPE_GOLDEN_REPORT=<path> also writes the report as JSON, and CREPE_GOLDEN_THROUGHPUT=1 turns
+// the throughput floors into checks (on a quiet machine; they are only reported otherwise).
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using crepe::constants::SAMPLE_RATE;
+
+const std::string GOLDEN_DIR = std::string(CREPE_TEST_DATA_DIR) + "/golden";
+
+// with CREPE_GOLDEN_THROUGHPUT throughput is the best of this many passes over every signal,
+// one pass is only ~1k frames
+constexpr int TIMED_PASSES = 5;
+
+struct GoldenSignal {
+    std::string name;
+    std::vector<float> audio;
+    std::function<double(double)> f0; // true pitch at a time, empty when unknown
+};
+
+const std::vector<GoldenSignal> &golden_signals()
+{
+    namespace signals = crepe::signals;
+    static const std::vector<GoldenSignal> list = [] {
+        std::vector<GoldenSignal> result;
+        for (const double frequency : {32.7, 65.4, 130.8, 261.6, 523.3, 1046.5, 2000.0}) {
+            result.push_back({"tone-" + std::to_string(static_cast<int>(frequency)),
+                              signals::sine(frequency, 0.4, SAMPLE_RATE),
+                              [frequency](double) { return frequency; }});
+        }
+        result.push_back({"vibrato-330", signals::vibrato(330.0, 50.0, 5.5, 0.8, SAMPLE_RATE),
+                          [](const double t) {
+                              return signals::vibrato_frequency(330.0, 50.0, 5.5, t);
+                          }});
+        result.push_back({"glissando-220-880", signals::glissando(220.0, 880.0, 0.8, SAMPLE_RATE),
+                          [](const double t) {
+                              return signals::glissando_frequency(220.0, 880.0, 0.8, t);
+                          }});
+        result.push_back({"missing-fundamental-150",
+                          signals::missing_fundamental(150.0, 6, 0.4, SAMPLE_RATE),
+                          [](double) { return 150.0; }});
+        for (const int snr : {20, 10, 0}) {
+            result.push_back({"noisy-440-snr" + std::to_string(snr),
+                              signals::noisy_sine(440.0, snr, 0.4, SAMPLE_RATE),
+                              [](double) { return 440.0; }});
+        }
+        result.push_back({"sweep.wav", crepe::load_audio(std::string(CREPE_TEST_DATA_DIR) +
+                                                         "/sweep.wav"), {}});
+        return result;
+    }();
+    return list;
+}
+
+bool env_flag(const char *name)
+{
+    const char *value = std::getenv(name);
+    return value && std::string(value) == "1";
+}
+
+bool updating_golden()
+{
+    return env_flag("CREPE_UPDATE_GOLDEN");
+}
+
+bool checking_throughput()
+{
+    return env_flag("CREPE_GOLDEN_THROUGHPUT");
+}
+
+int count_frames(const std::vector<float> &audio)
+{
+    using namespace crepe::constants;
+    const int length = static_cast<int>(audio.size());
+    return length < FRAME_LENGTH ? 0 : (length - FRAME_LENGTH) / FFT_HOP + 1;
+}
+
+std::string track_path(const GoldenSignal &signal)
+{
+    return GOLDEN_DIR + "/" + signal.name + ".trk";
+}
+
+std::string activations_path(const GoldenSignal &signal)
+{
+    return GOLDEN_DIR + "/" + signal.name + ".act";
+}
+
+crepe::PredictionResults read_golden_track(const GoldenSignal &signal)
+{
+    crepe::PredictionResults track;
+    const crepe::TrackReader reader(track_path(signal));
+    reader.read_frames(0, static_cast<int>(reader.num_frames()), track);
+    return track;
+}
+
+// The true pitch at the centre of every frame, all voiced
+crepe::PredictionResults truth_track(const GoldenSignal &signal)
+{
+    using namespace crepe::constants;
+    const int num_frames = count_frames(signal.audio);
+    crepe::PredictionResults truth;
+    truth.num_frames = num_frames;
+    truth.pitches.resize(num_frames);
+    truth.voiced.setConstant(num_frames, true);
+    for (int i = 0; i < num_frames; i++) {
+        const double centre = static_cast<double>(i * FFT_HOP + FRAME_LENGTH / 2) / SAMPLE_RATE;
+        truth.pitches(i) = static_cast<float>(signal.f0(centre));
+    }
+    return truth;
+}
+
+// How a configuration turns audio into a pitch track
+enum class Path {
+    Run, // Engine::run
+    Stream, // CrepeStream, 10 ms pushes
+    Scheduler, // BatchScheduler, every signal submitted at once
+    Cascade // Engine::run_cascade behind a default (tiny) screen engine
+};
+
+struct Configuration {
+    std::string name{};
+    crepe::EngineOptions engine{};
+    crepe::InferenceOptions inference{};
+    Path path = Path::Run;
+    bool prime = false; // run every signal once before the timed pass (fills the cache)
+
+    // per signal, against the golden track
+    double min_pitch_accuracy = 0.98; // raw pitch accuracy, 50 cents
+    double min_voicing = 0.95; // voicing precision and recall
+    double max_cents_error = 5.0; // golden pitches are stored in quarter cents
+    double max_mean_cents_error = 1.0;
+
+    // frames per second over all signals, relative to the reference configuration. Loose
+    // enough for timing noise, but a path that falls well behind fails (CREPE_GOLDEN_THROUGHPUT).
+    double min_relative_throughput = 0.5;
+};
+
+std::vector<Configuration> configurations()
+{
+    std::vector<Configuration> list;
+    list.push_back({"reference"});
+
+    Configuration native{"native"};
+    native.engine.backend = crepe::Backend::Native;
+    list.push_back(native);
+
+    Configuration single{"batch-1"};
+    single.inference.batch_size = 1;
+    list.push_back(single);
+
+    Configuration ragged{"batch-7"};
+    ragged.inference.batch_size = 7;
+    list.push_back(ragged);
+
+    Configuration sessions{"sessions-4-batch-16"};
+    sessions.engine.num_sessions = 4;
+    sessions.inference.batch_size = 16;
+    list.push_back(sessions);
+
+    Configuration threads{"intra-op-4"};
+    threads.engine.intra_op_threads = 4;
+    list.push_back(threads);
+
+    // the golden tracks are argmax decoded in 20 cent bins, a steady tone between bins is off
+    // by the same amount on every frame
+    Configuration weighted{"weighted-average"};
+    weighted.inference.decoder = crepe::PitchDecoder::WeightedAverage;
+    weighted.max_cents_error = 30.0;
+    weighted.max_mean_cents_error = 25.0;
+    list.push_back(weighted);
+
+    Configuration viterbi{"viterbi"};
+    viterbi.inference.decoder = crepe::PitchDecoder::Viterbi;
+    viterbi.min_pitch_accuracy = 0.95;
+    viterbi.min_voicing = 0.9;
+    viterbi.max_cents_error = 30.0;
+    viterbi.max_mean_cents_error = 25.0;
+    list.push_back(viterbi);
+
+    // exists to be faster than the reference
+    Configuration adaptive{"adaptive-hop-4"};
+    adaptive.inference.coarse_hop_frames = 4;
+    adaptive.min_pitch_accuracy = 0.9;
+    adaptive.min_voicing = 0.85;
+    adaptive.max_cents_error = 50.0;
+    adaptive.max_mean_cents_error = 10.0;
+    adaptive.min_relative_throughput = 1.0;
+    list.push_back(adaptive);
+
+    Configuration gated{"silence-gate-60db"};
+    gated.inference.silence_threshold_db = -60.0f;
+    list.push_back(gated);
+
+    Configuration stream{"stream"};
+    stream.path = Path::Stream;
+    list.push_back(stream);
+
+    Configuration scheduler{"scheduler"};
+    scheduler.path = Path::Scheduler;
+    scheduler.engine.num_sessions = 2;
+    list.push_back(scheduler);
+
+    Configuration cached{"activation-cache-fp16"};
+    cached.engine.activation_cache_dir = "golden_activation_cache";
+    cached.prime = true;
+    cached.min_relative_throughput = 2.0; // nothing left to run but decoding
+    list.push_back(cached);
+
+    // the full capacity behind the tiny screen, only when its model is in models/
+    // (scripts/convert-capacities.sh). The golden tracks are the tiny model's, so escalated
+    // frames are held to the same bounds as int8.
+#ifdef CREPE_WITH_ORT
+    const char *full_model = "models/model-full.ort";
+#else
+    const char *full_model = "models/model-full.onnx";
+#endif
+    if (std::filesystem::exists(full_model)) {
+        Configuration cascade{"cascade-full"};
+        cascade.path = Path::Cascade;
+        cascade.engine.capacity = crepe::Capacity::Full;
+        cascade.engine.model_dir = "models";
+        cascade.min_pitch_accuracy = 0.9;
+        cascade.min_voicing = 0.85;
+        cascade.max_cents_error = 100.0;
+        cascade.max_mean_cents_error = 20.0;
+        cascade.min_relative_throughput = 0.0; // escalated frames run a far larger model
+        list.push_back(cascade);
+    }
+
+#ifdef CREPE_WITH_ORT
+    // only when a quantized model has been made (scripts/quantize-model.py)
+    if (std::filesystem::exists("models/model-tiny-int8.ort")) {
+        Configuration int8{"int8"};
+        int8.engine.precision = crepe::Precision::Int8;
+        int8.engine.model_dir = "models";
+        int8.min_pitch_accuracy = 0.9;
+        int8.min_voicing = 0.85;
+        int8.max_cents_error = 100.0;
+        int8.max_mean_cents_error = 20.0;
+        list.push_back(int8);
+    }
+#endif
+    return list;
+}
+
+// Every golden signal through one configuration, in order
+std::vector<crepe::PredictionResults> run_configuration(const Configuration &configuration,
+                                                        crepe::Engine &engine)
+{
+    using namespace crepe::constants;
+    const std::vector<GoldenSignal> &signals = golden_signals();
+    std::vector<crepe::PredictionResults> tracks(signals.size());
+
+    switch (configuration.path) {
+    case Path::Run:
+        for (size_t s = 0; s < signals.size(); s++) {
+            engine.run(signals[s].audio.data(), static_cast<int>(signals[s].audio.size()),
+                       SAMPLE_RATE, tracks[s], configuration.inference);
+        }
+        break;
+    case Path::Stream:
+        for (size_t s = 0; s < signals.size(); s++) {
+            const std::vector<float> &audio = signals[s].audio;
+            const int num_frames = count_frames(audio);
+            crepe::PredictionResults &track = tracks[s];
+            track.num_frames = num_frames;
+            track.pitches.resize(num_frames);
+            track.confidences.resize(num_frames);
+            track.times.resize(num_frames);
+            track.voiced.resize(num_frames);
+
+            crepe::CrepeStream stream(engine, configuration.inference, num_frames + 1);
+            crepe::PredictionResults chunk;
+            int written = 0;
+            for (size_t i = 0; i < audio.size(); i += FFT_HOP) {
+                stream.push(audio.data() + i, std::min<size_t>(FFT_HOP, audio.size() - i));
+                for (int n; (n = stream.poll(chunk)) > 0; written += n) {
+                    track.pitches.segment(written, n) = chunk.pitches.head(n);
+                    track.confidences.segment(written, n) = chunk.confidences.head(n);
+                    track.times.segment(written, n) = chunk.times.head(n);
+                    track.voiced.segment(written, n) = chunk.voiced.head(n);
+                }
+            }
+            REQUIRE(written == num_frames);
+        }
+        break;
+    case Path::Scheduler: {
+        crepe::BatchSchedulerOptions options;
+        options.inference = configuration.inference;
+        crepe::BatchScheduler scheduler(engine, options);
+        std::vector<std::future<crepe::PredictionResults>> futures;
+        for (const GoldenSignal &signal : signals) {
+            futures.push_back(scheduler.submit(signal.audio));
+        }
+        for (size_t s = 0; s < signals.size(); s++) {
+            tracks[s] = futures[s].get();
+        }
+        break;
+    }
+    case Path::Cascade: {
+        static crepe::Engine screen;
+        crepe::CascadeOptions options;
+        options.inference = configuration.inference;
+        for (size_t s = 0; s < signals.size(); s++) {
+            tracks[s] = engine.run_cascade(screen, signals[s].audio.data(),
+                                           static_cast<int>(signals[s].audio.size()),
+                                           SAMPLE_RATE, options);
+        }
+        break;
+    }
+    }
+    return tracks;
+}
+
+struct ReportRow {
+    std::string configuration;
+    double min_pitch_accuracy = 1.0; // worst signal, against the golden tracks
+    double min_voicing_precision = 1.0;
+    double min_voicing_recall = 1.0;
+    double max_cents_error = 0.0;
+    double max_mean_cents_error = 0.0; // worst signal
+    double truth_pitch_accuracy = 0.0; // mean over the synthetic signals, against the true pitch
+    double frames_per_second = 0.0;
+};
+
+void print_report(const std::vector<ReportRow> &rows)
+{
+    std::cout << std::left << std::setw(24) << "configuration" << std::right << std::setw(10)
+        << "rpa" << std::setw(10) << "v.prec" << std::setw(10) << "v.recall" << std::setw(12)
+        << "max cents" << std::setw(12) << "mean cents" << std::setw(12) << "truth rpa"
+        << std::setw(12) << "frames/s" << "\n";
+    std::cout << std::fixed;
+    for (const ReportRow &row : rows) {
+        std::cout << std::left << std::setw(24) << row.configuration << std::right
+            << std::setprecision(4) << std::setw(10) << row.min_pitch_accuracy << std::setw(10)
+            << row.min_voicing_precision << std::setw(10) << row.min_voicing_recall
+            << std::setprecision(1) << std::setw(12) << row.max_cents_error << std::setw(12)
+            << row.max_mean_cents_error << std::setprecision(4) << std::setw(12)
+            << row.truth_pitch_accuracy << std::setprecision(0) << std::setw(12)
+            << row.frames_per_second << "\n";
+    }
+    std::cout << std::defaultfloat << std::flush;
+}
+
+void write_json_report(const std::string &path, const std::vector<ReportRow> &rows)
+{
+    std::ofstream out(path);
+    out << "{\"configurations\": [\n";
+    for (size_t r = 0; r < rows.size(); r++) {
+        const ReportRow &row = rows[r];
+        out << "  {\"name\": \"" << row.configuration << "\""
+            << ", \"min_raw_pitch_accuracy\": " << row.min_pitch_accuracy
+            << ", \"min_voicing_precision\": " << row.min_voicing_precision
+            << ", \"min_voicing_recall\": " << row.min_voicing_recall
+            << ", \"max_cents_error\": " << row.max_cents_error
+            << ", \"max_mean_cents_error\": " << row.max_mean_cents_error
+            << ", \"truth_raw_pitch_accuracy\": " << row.truth_pitch_accuracy
+            << ", \"frames_per_second\": " << row.frames_per_second << "}"
+            << (r + 1 < rows.size() ? "," : "") << "\n";
+    }
+    out << "]}\n";
+}
+} // namespace
+
+TEST_CASE("Reference activations match the golden ones", "[golden]") {
+    using namespace crepe::constants;
+    crepe::Engine engine;
+
+    const bool update = updating_golden();
+    if (update) {
+        std::filesystem::create_directories(GOLDEN_DIR);
+    }
+
+    for (const GoldenSignal &signal : golden_signals()) {
+        INFO(signal.name);
+        const int num_frames = count_frames(signal.audio);
+        std::vector<float> activations(static_cast<size_t>(num_frames) * OUTPUT_SIZE);
+        crepe::PredictionResults scratch;
+        scratch.pitches.resize(num_frames);
+        scratch.confidences.resize(num_frames);
+        scratch.voiced.resize(num_frames);
+        engine.run_frames(signal.audio.data(), num_frames, scratch, 0, activations.data());
+
+        if (update) {
+            crepe::ActivationCache::Writer writer(activations_path(signal), num_frames);
+            writer.write(0, num_frames, activations.data());
+            writer.commit();
+
+            crepe::TrackWriter track(track_path(signal));
+            track.append(engine.run(signal.audio, SAMPLE_RATE));
+            track.close();
+            continue;
+        }
+
+        const auto golden = crepe::ActivationCache::Entry::open(activations_path(signal),
+                                                                num_frames);
+        INFO("missing or stale golden activations, regenerate with CREPE_UPDATE_GOLDEN=1");
+        REQUIRE(golden != nullptr);
+        std::vector<float> expected(activations.size());
+        golden->read(0, num_frames, expected.data());
+
+        // fp16 storage and other backends stay well inside this
+        float max_difference = 0.0f;
+        for (size_t i = 0; i < activations.size(); i++) {
+            max_difference = std::max(max_difference, std::abs(activations[i] - expected[i]));
+        }
+        CHECK(max_difference < 0.02f);
+    }
+}
+
+TEST_CASE("Engine configurations match the golden tracks", "[golden]") {
+    const std::vector<GoldenSignal> &signals = golden_signals();
+    std::vector<crepe::PredictionResults> golden;
+    for (const GoldenSignal &signal : signals) {
+        INFO("missing golden track for " << signal.name << ", regenerate with "
+             "CREPE_UPDATE_GOLDEN=1");
+        REQUIRE(std::filesystem::exists(track_path(signal)));
+        golden.push_back(read_golden_track(signal));
+        REQUIRE(golden.back().num_frames == count_frames(signal.audio));
+    }
+
+    int total_frames = 0;
+    for (const GoldenSignal &signal : signals) {
+        total_frames += count_frames(signal.audio);
+    }
+
+    std::vector<ReportRow> rows;
+    for (const Configuration &configuration : configurations()) {
+        INFO(configuration.name);
+        if (!configuration.engine.activation_cache_dir.empty()) {
+            std::filesystem::remove_all(configuration.engine.activation_cache_dir);
+        }
+        crepe::Engine engine(configuration.engine);
+
+        // sessions are created on first use, keep that out of the timing
+        crepe::PredictionResults warm_up;
+        engine.run(signals[0].audio.data(), static_cast<int>(signals[0].audio.size()), SAMPLE_RATE,
+                   warm_up, configuration.inference);
+        if (configuration.prime) {
+            run_configuration(configuration, engine);
+        }
+
+        std::vector<crepe::PredictionResults> tracks;
+        double best_seconds = std::numeric_limits<double>::infinity();
+        const int passes = checking_throughput() ? TIMED_PASSES : 1;
+        for (int pass = 0; pass < passes; pass++) {
+            const Clock::time_point start = Clock::now();
+            tracks = run_configuration(configuration, engine);
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            best_seconds = std::min(best_seconds, elapsed.count());
+        }
+
+        ReportRow row;
+        row.configuration = configuration.name;
+        row.frames_per_second = total_frames / best_seconds;
+        int with_truth = 0;
+        for (size_t s = 0; s < signals.size(); s++) {
+            INFO(signals[s].name);
+            REQUIRE(tracks[s].num_frames == golden[s].num_frames);
+
+            const crepe::metrics::Accuracy accuracy = crepe::metrics::compare(golden[s], tracks[s]);
+            CHECK(accuracy.raw_pitch_accuracy >= configuration.min_pitch_accuracy);
+            CHECK(accuracy.voicing_precision >= configuration.min_voicing);
+            CHECK(accuracy.voicing_recall >= configuration.min_voicing);
+            CHECK(accuracy.max_cents_error <= configuration.max_cents_error);
+            CHECK(accuracy.mean_cents_error <= configuration.max_mean_cents_error);
+
+            row.min_pitch_accuracy = std::min(row.min_pitch_accuracy,
+                                              accuracy.raw_pitch_accuracy);
+            row.min_voicing_precision = std::min(row.min_voicing_precision,
+                                                 accuracy.voicing_precision);
+            row.min_voicing_recall = std::min(row.min_voicing_recall, accuracy.voicing_recall);
+            row.max_cents_error = std::max(row.max_cents_error, accuracy.max_cents_error);
+            row.max_mean_cents_error = std::max(row.max_mean_cents_error,
+                                                accuracy.mean_cents_error);
+
+            if (signals[s].f0) {
+                row.truth_pitch_accuracy +=
+                    crepe::metrics::compare(truth_track(signals[s]), tracks[s]).raw_pitch_accuracy;
+                with_truth++;
+            }
+        }
+        row.truth_pitch_accuracy /= std::max(with_truth, 1);
+
+        // the reference runs first
+        if (!rows.empty() && checking_throughput()) {
+            CHECK(row.frames_per_second >=
+                  configuration.min_relative_throughput * rows.front().frames_per_second);
+        }
+        rows.push_back(row);
+
+        if (!configuration.engine.activation_cache_dir.empty()) {
+            std::filesystem::remove_all(configuration.engine.activation_cache_dir);
+        }
+    }
+
+    print_report(rows);
+    if (const char *path = std::getenv("CREPE_GOLDEN_REPORT")) {
+        write_json_report(path, rows);
+    }
+}
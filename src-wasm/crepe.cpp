@@ -2,48 +2,150 @@
 #include <emscripten/bind.h>
 
 #include "crepe.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <vector>
-#include <cstring> 
 
 namespace {
-    constexpr size_t MAX_AUDIO_SAMPLES = 16000; 
-    constexpr size_t MAX_FRAMES = 100;
-
-    float g_audio_buffer[MAX_AUDIO_SAMPLES];
-    float g_result_buffer[1 + MAX_FRAMES * 3];
+    std::vector<float> g_result_buffer;
     std::vector<float> g_audio_vector;
+
+    // Header of a single-producer single-consumer sample ring, shared with web/crepe-stream.js.
+    // write/read are free-running sample counters (capacity is a power of two), data is the byte
+    // offset of the samples in the same buffer. The producer (AudioWorklet) only moves write and
+    // overruns, the consumer (crepe_stream_process) only moves read.
+    struct RingHeader {
+        uint32_t write;
+        uint32_t read;
+        uint32_t capacity;
+        uint32_t overruns; // samples the producer dropped because the ring was full
+        uint32_t data;
+        uint32_t reserved[3];
+    };
+
+    struct WasmStream {
+        std::unique_ptr<crepe::Engine> engine; // only for an explicit thread count
+        std::unique_ptr<crepe::CrepeStream> stream;
+        RingHeader ring{};
+        std::vector<float> ring_data;
+        crepe::PredictionResults results; // capacity max_frames, exposed as views
+    };
+
+    uint32_t ceil_power_of_two(const uint32_t value) {
+        uint32_t power = 1;
+        while (power < value)
+            power <<= 1;
+        return power;
+    }
 }
 
 
 extern "C" {
 EMSCRIPTEN_KEEPALIVE
 float* analyse_audio(const float* audio_data, const int length) {
-    const float* inference_data;
-    const int valid_length = std::min(length, static_cast<int>(MAX_AUDIO_SAMPLES));
+    const crepe::PredictionResults results = crepe::run_inference(
+        audio_data, length, crepe::constants::SAMPLE_RATE);
 
-    if (length <= MAX_AUDIO_SAMPLES) {
-        inference_data = audio_data;
-    } else {
-        memcpy(g_audio_buffer, audio_data, valid_length * sizeof(float));
-        inference_data = g_audio_buffer;
+    g_result_buffer.resize(1 + static_cast<size_t>(results.num_frames) * 3);
+    g_result_buffer[0] = static_cast<float>(results.num_frames);
+
+    for (int i = 0; i < results.num_frames; i++) {
+        const int base_idx = 1 + i * 3;
+        g_result_buffer[base_idx] = results.pitches(i);
+        g_result_buffer[base_idx + 1] = results.confidences(i);
+        g_result_buffer[base_idx + 2] = results.times(i);
     }
 
-    auto [pitches, confidences, times, num_frames] = crepe::run_inference(
-        inference_data, valid_length, crepe::constants::SAMPLE_RATE);
+    return g_result_buffer.data();
+}
+
+// Live analysis of audio at input_sample_rate. The caller fills the ring returned by
+// crepe_stream_ring (from an AudioWorklet when the module memory is shared) and calls
+// crepe_stream_process, which returns how many new frames are in the result arrays.
+// Up to max_frames are analysed per call, older pending frames are dropped.
+// threads > 0 gives the stream an engine of its own with that many intra-op threads.
+EMSCRIPTEN_KEEPALIVE
+WasmStream* crepe_stream_create(const int input_sample_rate, const int ring_samples,
+                                const int max_frames, const int threads) {
+    auto* handle = new WasmStream;
+    if (threads > 0) {
+        crepe::EngineOptions options;
+        options.intra_op_threads = threads;
+        handle->engine = std::make_unique<crepe::Engine>(options);
+    }
+    crepe::Engine& engine = handle->engine ? *handle->engine : crepe::Engine::default_engine();
+    handle->stream = std::make_unique<crepe::CrepeStream>(
+        engine, crepe::InferenceOptions{}, max_frames, input_sample_rate);
+
+    handle->ring_data.assign(ceil_power_of_two(static_cast<uint32_t>(ring_samples)), 0.0f);
+    handle->ring.capacity = static_cast<uint32_t>(handle->ring_data.size());
+    handle->ring.data = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(handle->ring_data.data()));
+
+    handle->results.pitches.resize(max_frames);
+    handle->results.confidences.resize(max_frames);
+    handle->results.times.resize(max_frames);
+    handle->results.voiced.resize(max_frames);
+    return handle;
+}
 
-    const int safe_frames = std::min(num_frames, static_cast<int>(MAX_FRAMES));
-    g_result_buffer[0] = static_cast<float>(safe_frames);
+EMSCRIPTEN_KEEPALIVE
+RingHeader* crepe_stream_ring(WasmStream* handle) {
+    return &handle->ring;
+}
 
-    for (int i = 0; i < safe_frames; i++) {
-        const int base_idx = 1 + i * 3;
-        g_result_buffer[base_idx] = pitches(i);
-        g_result_buffer[base_idx + 1] = confidences(i);
-        g_result_buffer[base_idx + 2] = times(i);
+EMSCRIPTEN_KEEPALIVE
+int crepe_stream_process(WasmStream* handle) {
+    RingHeader& ring = handle->ring;
+    const uint32_t write = std::atomic_ref(ring.write).load(std::memory_order_acquire);
+    uint32_t read = ring.read;
+
+    // at most two runs, before and after the wrap
+    while (read != write) {
+        const uint32_t position = read & (ring.capacity - 1);
+        const uint32_t run = std::min(write - read, ring.capacity - position);
+        handle->stream->push(handle->ring_data.data() + position, run);
+        read += run;
     }
+    std::atomic_ref(ring.read).store(read, std::memory_order_release);
+
+    return handle->stream->poll(handle->results);
+}
 
-    return g_result_buffer;
+EMSCRIPTEN_KEEPALIVE
+const float* crepe_stream_pitches(WasmStream* handle) {
+    return handle->results.pitches.data();
+}
+
+EMSCRIPTEN_KEEPALIVE
+const float* crepe_stream_confidences(WasmStream* handle) {
+    return handle->results.confidences.data();
+}
+
+EMSCRIPTEN_KEEPALIVE
+const float* crepe_stream_times(WasmStream* handle) {
+    return handle->results.times.data();
+}
+
+EMSCRIPTEN_KEEPALIVE
+double crepe_stream_dropped_frames(WasmStream* handle) {
+    return static_cast<double>(handle->stream->dropped_frames());
+}
+
+EMSCRIPTEN_KEEPALIVE
+void crepe_stream_reset(WasmStream* handle) {
+    handle->stream->reset();
+    std::atomic_ref(handle->ring.read)
+        .store(std::atomic_ref(handle->ring.write).load(std::memory_order_acquire),
+               std::memory_order_release);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void crepe_stream_destroy(WasmStream* handle) {
+    delete handle;
+}
 }
-} 
 
 emscripten::val analysePitch(const emscripten::val& audio_array) {
     const auto length = audio_array["length"].as<unsigned>();
@@ -79,4 +181,4 @@ emscripten::val analysePitch(const emscripten::val& audio_array) {
 
 EMSCRIPTEN_BINDINGS(crepe_module) {
     emscripten::function("analysePitch", &analysePitch);
-}
\ No newline at end of file
+}
@@ -0,0 +1,107 @@
+// Headless check of the streaming entry points: feeds a tone through the ring the way the
+// AudioWorklet does (128-sample render quanta) and checks the tracked pitch.
+//
+// usage: node src-wasm/test-stream.js build-wasm/src-wasm/crepe_wasm_simd_threads.js
+
+const path = require('path');
+const { CrepeRing, CrepeStream } = require('../web/crepe-stream.js');
+
+const SAMPLE_RATE = 44100;
+const QUANTUM = 128;
+const FREQUENCIES = [110, 220, 440, 880];
+const SECONDS = 1;
+
+function fail(message) {
+    console.error(`FAILED: ${message}`);
+    process.exit(1);
+}
+
+function median(values) {
+    const sorted = Float32Array.from(values).sort();
+    return sorted[sorted.length >> 1];
+}
+
+function checkRing() {
+    // wraps, partial writes when full, overrun counting
+    const source = CrepeRing.create(8);
+    const target = CrepeRing.create(16);
+    const block = Float32Array.from({ length: 6 }, (_, i) => i);
+    source.write(block);
+    source.pipeTo(target);
+    if (source.write(block) !== 6 || source.write(block) !== 2 || source.overruns() !== 4) {
+        fail('ring did not drop the samples that do not fit');
+    }
+    source.pipeTo(target);
+    const expected = [0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1];
+    if (target.available() !== expected.length ||
+        expected.some((value, i) => target.data[i] !== value)) {
+        fail('ring samples out of order across the wrap');
+    }
+
+    // pages without cross-origin isolation have no SharedArrayBuffer, rings fall back to plain
+    // buffers filled by the worker
+    const saved = globalThis.SharedArrayBuffer;
+    delete globalThis.SharedArrayBuffer;
+    const plain = CrepeRing.create(8);
+    globalThis.SharedArrayBuffer = saved;
+    plain.write(block);
+    if (plain.shared || plain.available() !== block.length) {
+        fail('ring without SharedArrayBuffer');
+    }
+}
+
+async function main() {
+    const modulePath = process.argv[2];
+    if (!modulePath) {
+        fail('usage: node test-stream.js path/to/crepe_wasm*.js');
+    }
+    checkRing();
+
+    const CrepeModule = require(path.resolve(modulePath));
+    const module = await CrepeModule();
+    const threads = typeof SharedArrayBuffer !== 'undefined' &&
+                    module.HEAPF32.buffer instanceof SharedArrayBuffer ? 2 : 0;
+
+    for (const frequency of FREQUENCIES) {
+        const stream = new CrepeStream(module, SAMPLE_RATE, { maxFrames: 32, threads });
+        const pitches = [];
+        const quantum = new Float32Array(QUANTUM);
+        let processed = 0;
+
+        for (let offset = 0; offset < SECONDS * SAMPLE_RATE; offset += QUANTUM) {
+            for (let i = 0; i < QUANTUM; i++) {
+                quantum[i] = 0.5 * Math.sin(2 * Math.PI * frequency * (offset + i) / SAMPLE_RATE);
+            }
+            stream.ring.write(quantum);
+
+            // the worker's timer, every ~20 ms of audio
+            if ((offset / QUANTUM) % 7 === 6) {
+                const count = stream.process();
+                for (let i = 0; i < count; i++) {
+                    pitches.push(stream.pitches[i]);
+                }
+                processed += count;
+            }
+        }
+
+        const expectedFrames = Math.floor((SECONDS * 16000 - 1024) / 160);
+        if (processed < expectedFrames - 8) {
+            fail(`${frequency} Hz: ${processed} frames, expected about ${expectedFrames}`);
+        }
+        if (stream.ring.overruns() !== 0 || stream.droppedFrames() !== 0) {
+            fail(`${frequency} Hz: samples or frames were dropped`);
+        }
+        const cents = 1200 * Math.log2(median(pitches) / frequency);
+        console.log(`${frequency} Hz: ${processed} frames, median ${median(pitches).toFixed(1)} Hz ` +
+                    `(${cents.toFixed(1)} cents), shared memory ${stream.shared}`);
+        if (Math.abs(cents) > 50) {
+            fail(`${frequency} Hz tracked ${cents.toFixed(1)} cents off`);
+        }
+        stream.destroy();
+    }
+
+    console.log('PASSED');
+    process.exit(0);
+}
+
+main().catch(error => fail(error.stack || error.message));
@@ -0,0 +1,211 @@
+#include "activation_cache.hpp"
+#include "crepe.hpp"
+#include "mapped_file.hpp"
+#include "simd.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+namespace crepe
+{
+namespace
+{
+constexpr char MAGIC[8] = {'C', 'R', 'E', 'P', 'E', 'A', 'C', 'T'};
+constexpr uint32_t VERSION = 1;
+
+struct EntryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t output_size;
+    int64_t num_frames;
+    uint64_t reserved;
+};
+static_assert(sizeof(EntryHeader) == 32);
+
+constexpr uint64_t PRIME_1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t PRIME_2 = 0xc2b2ae3d27d4eb4full;
+
+uint64_t rotate_left(const uint64_t x, const int bits)
+{
+    return (x << bits) | (x >> (64 - bits));
+}
+
+uint64_t mix(uint64_t lane, const uint64_t word)
+{
+    lane += word * PRIME_2;
+    return rotate_left(lane, 31) * PRIME_1;
+}
+
+std::string to_hex(const uint64_t value)
+{
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+} // namespace
+
+uint64_t hash_bytes(const void *data, const size_t size, const uint64_t seed)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    uint64_t lanes[4] = {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1};
+
+    // 32 bytes per round, one word per lane, so the four multiply chains overlap
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int l = 0; l < 4; l++)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i + 8 * l, sizeof(word));
+            lanes[l] = mix(lanes[l], word);
+        }
+    }
+
+    uint64_t hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) +
+                    rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18);
+    hash += size;
+    for (; i < size; i++)
+    {
+        hash = rotate_left(hash ^ (bytes[i] * PRIME_1), 11) * PRIME_2;
+    }
+
+    // final avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+ActivationCache::ActivationCache(std::string directory, const void *model_data,
+                                 const size_t model_size, const std::string &backend)
+    : directory(std::move(directory)),
+      model_id(backend + "-" + to_hex(hash_bytes(model_data, model_size)))
+{
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error)
+    {
+        throw std::runtime_error("Failed to create activation cache directory " +
+                                 this->directory + ": " + error.message());
+    }
+}
+
+std::string ActivationCache::entry_path(const float *audio_data, const int length) const
+{
+    const uint64_t hash = hash_bytes(audio_data, static_cast<size_t>(length) * sizeof(float));
+    return directory + "/" + model_id + "-" + to_hex(hash) + ".act";
+}
+
+std::unique_ptr<ActivationCache::Entry> ActivationCache::Entry::open(const std::string &path,
+                                                                     const int num_frames)
+{
+    std::error_code error;
+    if (!std::filesystem::exists(path, error))
+    {
+        return nullptr;
+    }
+
+    auto entry = std::make_unique<Entry>();
+    try
+    {
+        entry->file = std::make_shared<MappedFile>(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        return nullptr; // removed since, treat as a miss
+    }
+
+    const size_t data_bytes = static_cast<size_t>(num_frames) * constants::OUTPUT_SIZE *
+                              sizeof(uint16_t);
+    EntryHeader header{};
+    if (entry->file->size() != sizeof(header) + data_bytes)
+    {
+        return nullptr;
+    }
+    std::memcpy(&header, entry->file->data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.output_size != constants::OUTPUT_SIZE || header.num_frames != num_frames)
+    {
+        return nullptr;
+    }
+
+    // the header keeps the data 8-byte aligned in the page-aligned mapping
+    entry->halves = reinterpret_cast<const uint16_t *>(entry->file->data() + sizeof(header));
+    return entry;
+}
+
+void ActivationCache::Entry::read(const int first, const int count, float *activations) const
+{
+    simd::halves_to_floats(halves + static_cast<size_t>(first) * constants::OUTPUT_SIZE,
+                           activations, static_cast<size_t>(count) * constants::OUTPUT_SIZE);
+}
+
+ActivationCache::Writer::Writer(std::string path, const int num_frames)
+    : path(std::move(path))
+{
+    static std::atomic<uint64_t> counter{0};
+    temp_path = this->path + ".tmp" + std::to_string(counter.fetch_add(1)) + "-" +
+                to_hex(reinterpret_cast<uintptr_t>(this));
+    out.open(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to create activation cache entry: " + temp_path);
+    }
+
+    EntryHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.output_size = constants::OUTPUT_SIZE;
+    header.num_frames = num_frames;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+ActivationCache::Writer::~Writer()
+{
+    if (!committed)
+    {
+        out.close();
+        std::error_code error;
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+void ActivationCache::Writer::write(const int first, const int count, const float *activations)
+{
+    const size_t values = static_cast<size_t>(count) * constants::OUTPUT_SIZE;
+
+    std::lock_guard lock(mutex);
+    halves.resize(values);
+    simd::floats_to_halves(activations, halves.data(), values);
+    out.seekp(static_cast<std::streamoff>(sizeof(EntryHeader) +
+                                          static_cast<size_t>(first) * constants::OUTPUT_SIZE *
+                                          sizeof(uint16_t)));
+    out.write(reinterpret_cast<const char *>(halves.data()),
+              static_cast<std::streamsize>(values * sizeof(uint16_t)));
+}
+
+void ActivationCache::Writer::commit()
+{
+    out.close();
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write activation cache entry: " + temp_path);
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error)
+    {
+        throw std::runtime_error("Failed to store activation cache entry " + path + ": " +
+                                 error.message());
+    }
+    committed = true;
+}
+} // namespace crepe
@@ -0,0 +1,84 @@
+#ifndef CREPE_ACTIVATION_CACHE_HPP
+#define CREPE_ACTIVATION_CACHE_HPP
+
+// Internal on-disk cache of raw [num_frames, OUTPUT_SIZE] model activations, one file per
+// (model, audio) pair, stored as fp16 and read back through a mapping. With it, decoding
+// changes (voicing threshold, silence gate, decoders) never re-run the model on audio it has
+// already seen.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace crepe
+{
+class MappedFile;
+
+// 64-bit non-cryptographic content hash (four interleaved multiply-rotate lanes)
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+
+class ActivationCache
+{
+public:
+    // Entries are keyed by the model too (a hash of its bytes and the backend name), so models
+    // can share a directory. The directory is created when missing.
+    ActivationCache(std::string directory, const void *model_data, size_t model_size,
+                    const std::string &backend);
+
+    // File of the entry for length samples of 16 kHz audio
+    std::string entry_path(const float *audio_data, int length) const;
+
+    // A cached entry, mapped read-only
+    class Entry
+    {
+    public:
+        // Null on a miss, or when the file is not an entry of num_frames frames
+        static std::unique_ptr<Entry> open(const std::string &path, int num_frames);
+
+        // Activations of frames [first, first + count) as floats
+        void read(int first, int count, float *activations) const;
+
+    private:
+        std::shared_ptr<const MappedFile> file;
+        const uint16_t *halves = nullptr;
+    };
+
+    // Fills a temporary file that commit() renames into place, so readers (also in other
+    // processes) only ever see complete entries. Uncommitted files are removed.
+    class Writer
+    {
+    public:
+        Writer(std::string path, int num_frames);
+
+        ~Writer();
+
+        Writer(const Writer &) = delete;
+
+        Writer &operator=(const Writer &) = delete;
+
+        // Frames [first, first + count), in any order, from any thread
+        void write(int first, int count, const float *activations);
+
+        // Throws std::runtime_error when the file could not be written
+        void commit();
+
+    private:
+        std::string path;
+        std::string temp_path;
+        std::ofstream out;
+        bool committed = false;
+        std::mutex mutex;
+        std::vector<uint16_t> halves;
+    };
+
+private:
+    std::string directory;
+    std::string model_id;
+};
+} // namespace crepe
+
+#endif //CREPE_ACTIVATION_CACHE_HPP
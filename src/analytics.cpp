@@ -0,0 +1,173 @@
+#include "analytics.hpp"
+#include "decoding.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace crepe
+{
+namespace
+{
+float frequency_to_cents(const float frequency)
+{
+    using namespace constants;
+    return CENTS_CONVERSION * std::log2(frequency / BASE_FREQUENCY);
+}
+} // namespace
+
+OnlineAnalytics::OnlineAnalytics(const OnlineAnalyticsOptions &options, NoteSink sink)
+    : options(options), sink(std::move(sink)), ring(std::max(options.window_frames, 1))
+{
+    this->options.min_note_frames = std::max(options.min_note_frames, 1);
+}
+
+void OnlineAnalytics::push(const float time, const float pitch, const float confidence)
+{
+    // whole track
+    count++;
+    min_pitch = count == 1 ? pitch : std::min(min_pitch, pitch);
+    max_pitch = count == 1 ? pitch : std::max(max_pitch, pitch);
+    const double n = static_cast<double>(count);
+    const double time_delta = time - mean_time;
+    const double pitch_delta = pitch - mean_pitch;
+    mean_time += time_delta / n;
+    mean_pitch += pitch_delta / n;
+    mean_confidence += (confidence - mean_confidence) / n;
+    m2_time += time_delta * (time - mean_time);
+    m2_pitch += pitch_delta * (pitch - mean_pitch);
+    co_moment += time_delta * (pitch - mean_pitch);
+
+    const bool voiced = confidence >= options.voicing_threshold && pitch > 0.0f;
+    const float cents = voiced ? frequency_to_cents(pitch) : 0.0f;
+    voiced_count += voiced;
+
+    // window: retire the oldest frame once it is full
+    if (ring_size == static_cast<int>(ring.size()))
+    {
+        const WindowFrame &oldest = ring[ring_next];
+        sum_confidence -= oldest.confidence;
+        if (oldest.voiced)
+        {
+            window_voiced--;
+            sum_cents -= oldest.cents;
+            sum_cents_squared -= static_cast<double>(oldest.cents) * oldest.cents;
+        }
+    }
+    else
+    {
+        ring_size++;
+    }
+    ring[ring_next] = {confidence, cents, voiced};
+    ring_next = (ring_next + 1) % static_cast<int>(ring.size());
+    sum_confidence += confidence;
+    if (voiced)
+    {
+        window_voiced++;
+        sum_cents += cents;
+        sum_cents_squared += static_cast<double>(cents) * cents;
+    }
+
+    // notes
+    if (!note_pitches.empty() &&
+        (!voiced || std::abs(cents - note_last_cents) > options.split_cents))
+    {
+        close_note();
+    }
+    if (!voiced)
+    {
+        return;
+    }
+    if (note_pitches.empty())
+    {
+        note_onset = time;
+        note_mean_cents = 0.0;
+        note_m2_cents = 0.0;
+        note_sum_confidence = 0.0;
+    }
+    note_pitches.push_back(pitch);
+    const double cents_delta = cents - note_mean_cents;
+    note_mean_cents += cents_delta / static_cast<double>(note_pitches.size());
+    note_m2_cents += cents_delta * (cents - note_mean_cents);
+    note_sum_confidence += confidence;
+    note_last_time = time;
+    note_last_cents = cents;
+}
+
+void OnlineAnalytics::push(const PredictionResults &results)
+{
+    for (int i = 0; i < results.num_frames; i++)
+    {
+        push(results.times(i), results.pitches(i), results.confidences(i));
+    }
+}
+
+void OnlineAnalytics::finish()
+{
+    if (!note_pitches.empty())
+    {
+        close_note();
+    }
+}
+
+void OnlineAnalytics::reset()
+{
+    *this = OnlineAnalytics(options, std::move(sink));
+}
+
+PredictionAnalytics OnlineAnalytics::summary() const
+{
+    PredictionAnalytics analytics;
+    analytics.min_frequency = min_pitch;
+    analytics.max_frequency = max_pitch;
+    analytics.mean_confidence = static_cast<float>(mean_confidence);
+
+    // 0 rather than NaN when either side is constant
+    const double norm = std::sqrt(m2_time) * std::sqrt(m2_pitch);
+    analytics.time_pitch_correlation = norm > 0.0 ? static_cast<float>(co_moment / norm) : 0.0f;
+    return analytics;
+}
+
+WindowStats OnlineAnalytics::window() const
+{
+    WindowStats stats;
+    stats.num_frames = ring_size;
+    if (ring_size == 0)
+    {
+        return stats;
+    }
+    stats.mean_confidence = static_cast<float>(sum_confidence / ring_size);
+    stats.voiced_ratio = static_cast<float>(window_voiced) / static_cast<float>(ring_size);
+    if (window_voiced > 0)
+    {
+        const double mean = sum_cents / window_voiced;
+        const double variance = std::max(sum_cents_squared / window_voiced - mean * mean, 0.0);
+        stats.mean_voiced_pitch = cents_to_frequency(static_cast<float>(mean));
+        stats.voiced_pitch_stddev_cents = static_cast<float>(std::sqrt(variance));
+    }
+    return stats;
+}
+
+void OnlineAnalytics::close_note()
+{
+    const int frames = static_cast<int>(note_pitches.size());
+    if (frames >= options.min_note_frames)
+    {
+        NoteEvent note;
+        note.onset = note_onset;
+        note.offset = note_last_time + static_cast<float>(constants::FFT_HOP) /
+                      static_cast<float>(constants::SAMPLE_RATE);
+        std::nth_element(note_pitches.begin(), note_pitches.begin() + frames / 2,
+                         note_pitches.end());
+        note.median_pitch = note_pitches[frames / 2];
+        note.stability_cents = static_cast<float>(std::sqrt(note_m2_cents / frames));
+        note.mean_confidence = static_cast<float>(note_sum_confidence / frames);
+        note.num_frames = frames;
+        notes++;
+        if (sink)
+        {
+            sink(note);
+        }
+    }
+    note_pitches.clear();
+}
+} // namespace crepe
@@ -0,0 +1,129 @@
+#ifndef CREPE_ANALYTICS_HPP
+#define CREPE_ANALYTICS_HPP
+
+// Incremental statistics and note segmentation over a pitch track as it is produced, for
+// streams and out-of-core analysis. Every frame is folded in once, in O(1) (amortized for the
+// median of a note), and nothing of the track is kept beyond the open note and the window.
+
+#include "crepe.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace crepe
+{
+// One stretch of voiced frames at a steady pitch
+struct NoteEvent
+{
+    float onset = 0.0f; // time of the first frame, in seconds
+    float offset = 0.0f; // end of the last frame's hop
+    float median_pitch = 0.0f; // Hz
+    float stability_cents = 0.0f; // standard deviation of the pitch around its mean
+    float mean_confidence = 0.0f;
+    int num_frames = 0;
+};
+
+// Called as soon as a note has ended (and was long enough), in time order
+using NoteSink = std::function<void(const NoteEvent &note)>;
+
+struct OnlineAnalyticsOptions
+{
+    // Frames at or above this confidence (with a pitch) are voiced and can belong to a note
+    float voicing_threshold = constants::CONFIDENCE_THRESHOLD;
+
+    // Shorter voiced runs are not reported as notes
+    int min_note_frames = constants::MIN_FRAMES;
+
+    // A pitch step between consecutive voiced frames larger than this starts a new note, so
+    // legato note changes split while vibrato and slow glides do not
+    float split_cents = 50.0f;
+
+    // Frames covered by the windowed statistics (100 frames = 1 second)
+    int window_frames = 100;
+};
+
+// Statistics over the frames currently in the window
+struct WindowStats
+{
+    int num_frames = 0;
+    float mean_confidence = 0.0f;
+    float voiced_ratio = 0.0f;
+    float mean_voiced_pitch = 0.0f; // Hz, 0 without voiced frames
+    float voiced_pitch_stddev_cents = 0.0f;
+};
+
+class OnlineAnalytics
+{
+public:
+    explicit OnlineAnalytics(const OnlineAnalyticsOptions &options = {}, NoteSink sink = {});
+
+    // Frames must arrive in time order
+    void push(float time, float pitch, float confidence);
+
+    // Every frame of a results chunk (num_frames of them)
+    void push(const PredictionResults &results);
+
+    // Ends the open note at the end of the input, reporting it if it is long enough
+    void finish();
+
+    void reset();
+
+    // Over every frame pushed so far, as calculate_analytics over the whole track would give
+    // (source_data is null)
+    PredictionAnalytics summary() const;
+
+    WindowStats window() const;
+
+    int64_t num_frames() const { return count; }
+
+    int64_t num_voiced_frames() const { return voiced_count; }
+
+    int64_t num_notes() const { return notes; }
+
+private:
+    OnlineAnalyticsOptions options;
+    NoteSink sink;
+
+    // whole track: running extremes, means and co-moment of time and pitch (Welford)
+    int64_t count = 0;
+    int64_t voiced_count = 0;
+    int64_t notes = 0;
+    float min_pitch = 0.0f;
+    float max_pitch = 0.0f;
+    double mean_time = 0.0;
+    double mean_pitch = 0.0;
+    double mean_confidence = 0.0;
+    double m2_time = 0.0;
+    double m2_pitch = 0.0;
+    double co_moment = 0.0;
+
+    // window: a ring of the last window_frames frames and running sums over it
+    struct WindowFrame
+    {
+        float confidence;
+        float cents; // only meaningful when voiced
+        bool voiced;
+    };
+    std::vector<WindowFrame> ring;
+    int ring_next = 0;
+    int ring_size = 0;
+    double sum_confidence = 0.0;
+    int window_voiced = 0;
+    double sum_cents = 0.0;
+    double sum_cents_squared = 0.0;
+
+    // the open note
+    std::vector<float> note_pitches; // for its median, capacity reused between notes
+    float note_onset = 0.0f;
+    float note_last_time = 0.0f;
+    float note_last_cents = 0.0f;
+    double note_mean_cents = 0.0;
+    double note_m2_cents = 0.0;
+    double note_sum_confidence = 0.0;
+
+    void close_note();
+};
+} // namespace crepe
+
+#endif //CREPE_ANALYTICS_HPP
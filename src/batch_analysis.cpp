@@ -0,0 +1,422 @@
+#include "batch_analysis.hpp"
+#include "file_analysis.hpp"
+#include "resampler.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace crepe
+{
+namespace
+{
+// One clip between decoding and delivery
+struct Clip
+{
+    BatchItem item;
+    std::vector<float> owned; // decoded or resampled audio, empty when analysed in place
+    const float *audio = nullptr;
+    size_t length = 0;
+    std::atomic<int> remaining{0}; // frames still waiting for the model
+};
+
+// Frames of a clip waiting in the shared queue
+struct Segment
+{
+    std::shared_ptr<Clip> clip;
+    int first_frame;
+    int num_frames;
+};
+
+// Fills clip.audio/length (and clip.item.path) for input index, throws when it cannot
+using Loader = std::function<void(size_t index, Clip &clip)>;
+
+// Task graph of one analyze_batch call:
+//   load(i)   decode clip i, gate silence, queue its frames, schedule batches
+//   batch()   take up to batch_size queued frames from any clips, run them as one model batch,
+//             deliver the clips this completed
+// Load tasks are opened up to max_open_clips ahead of delivery.
+class BatchRun
+{
+public:
+    BatchRun(const size_t num_clips, Loader loader, const BatchSink &sink,
+             const BatchAnalysisOptions &options, Engine &engine)
+        : num_clips(num_clips), loader(std::move(loader)), sink(sink), options(options),
+          engine(engine), pool(options.num_threads)
+    {
+        batch_size = std::max(options.inference.batch_size, 1);
+        max_open = options.max_open_clips > 0
+                       ? static_cast<size_t>(options.max_open_clips)
+                       : static_cast<size_t>(pool.size()) * 4;
+    }
+
+    BatchAnalysisSummary run()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard lock(mutex);
+            open_clips();
+        }
+        pool.wait();
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        summary.num_clips = num_clips;
+        summary.wall_seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return summary;
+    }
+
+private:
+    size_t num_clips;
+    Loader loader;
+    const BatchSink &sink;
+    const BatchAnalysisOptions &options;
+    Engine &engine;
+    int batch_size;
+    size_t max_open;
+
+    std::mutex mutex; // guards everything below except summary
+    std::deque<Segment> queue;
+    int64_t queued_frames = 0;
+    int scheduled_batches = 0; // batch tasks submitted but not yet started
+    size_t next_clip = 0;
+    size_t open = 0; // loading or waiting for inference
+    size_t loading = 0;
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+
+    std::mutex sink_mutex; // serializes sink calls and guards summary
+    BatchAnalysisSummary summary;
+
+    ThreadPool pool; // last, so the workers are joined before anything they use is destroyed
+
+    // with mutex held
+    void open_clips()
+    {
+        while (open < max_open && next_clip < num_clips)
+        {
+            open++;
+            loading++;
+            pool.submit([this, index = next_clip++] { load(index); });
+        }
+    }
+
+    // With mutex held. One batch task per full batch queued; a partial batch only once no load
+    // is running, as nothing else would arrive to fill it.
+    void schedule()
+    {
+        while (queued_frames >= static_cast<int64_t>(batch_size) * (scheduled_batches + 1) ||
+               (loading == 0 && scheduled_batches == 0 && queued_frames > 0))
+        {
+            scheduled_batches++;
+            pool.submit([this] { run_batch(); });
+        }
+    }
+
+    void fail(std::exception_ptr exception)
+    {
+        std::lock_guard lock(mutex);
+        if (!error)
+        {
+            error = std::move(exception);
+        }
+        failed = true;
+    }
+
+    void load(size_t index);
+
+    void run_batch();
+
+    void deliver(const std::shared_ptr<Clip> &clip);
+};
+
+void BatchRun::load(const size_t index)
+{
+    using namespace constants;
+
+    auto clip = std::make_shared<Clip>();
+    clip->item.index = index;
+    try
+    {
+        if (!failed)
+        {
+            loader(index, *clip);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        clip->item.error = e.what();
+        clip->owned = {};
+        clip->length = 0;
+    }
+
+    const int length = static_cast<int>(clip->length);
+    const int num_frames = length < FRAME_LENGTH ? 0 : (length - FRAME_LENGTH) / FFT_HOP + 1;
+
+    PredictionResults &results = clip->item.results;
+    results.pitches.resize(num_frames);
+    results.confidences.resize(num_frames);
+    results.times.resize(num_frames);
+    results.voiced.resize(num_frames);
+    results.num_frames = num_frames;
+    for (int i = 0; i < num_frames; i++)
+    {
+        results.times(i) = static_cast<float>(i * FFT_HOP) / static_cast<float>(SAMPLE_RATE);
+    }
+    clip->item.duration_seconds = static_cast<double>(clip->length) / SAMPLE_RATE;
+
+    // runs of frames for the shared queue
+    std::vector<Segment> segments;
+    if (options.inference.coarse_hop_frames > 1)
+    {
+        // adaptive schedules need the whole clip, analyse it here; calls from pool workers
+        // run their batches serially, so this stays one thread per worker
+        try
+        {
+            if (!failed)
+            {
+                engine.run_frames(clip->audio, num_frames, results, 0, options.inference);
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    }
+    else if (std::isfinite(options.inference.silence_threshold_db))
+    {
+        // silence gate: only audible runs are queued
+        const float min_rms = std::pow(10.0f, options.inference.silence_threshold_db / 20.0f);
+        std::vector<float> rms(num_frames);
+        frame_rms(clip->audio, num_frames, FFT_HOP, rms.data());
+
+        for (int i = 0; i < num_frames; i++)
+        {
+            if (rms[i] >= min_rms)
+            {
+                if (segments.empty() ||
+                    segments.back().first_frame + segments.back().num_frames != i)
+                {
+                    segments.push_back({clip, i, 0});
+                }
+                segments.back().num_frames++;
+            }
+            else
+            {
+                results.pitches(i) = 0.0f;
+                results.confidences(i) = 0.0f;
+                results.voiced(i) = false;
+            }
+        }
+    }
+    else if (num_frames > 0)
+    {
+        segments.push_back({clip, 0, num_frames});
+    }
+
+    int queued = 0;
+    for (const Segment &segment : segments)
+    {
+        queued += segment.num_frames;
+    }
+    clip->remaining = queued;
+
+    {
+        std::lock_guard lock(mutex);
+        loading--;
+        for (Segment &segment : segments)
+        {
+            queue.push_back(std::move(segment));
+        }
+        queued_frames += queued;
+        schedule();
+    }
+
+    if (queued == 0)
+    {
+        deliver(clip);
+    }
+}
+
+void BatchRun::run_batch()
+{
+    using namespace constants;
+
+    std::vector<Segment> taken;
+    std::vector<FrameSpan> spans;
+    {
+        std::lock_guard lock(mutex);
+        scheduled_batches--;
+
+        int wanted = batch_size;
+        while (wanted > 0 && !queue.empty())
+        {
+            Segment &front = queue.front();
+            const int n = std::min(wanted, front.num_frames);
+            taken.push_back({front.clip, front.first_frame, n});
+            front.first_frame += n;
+            front.num_frames -= n;
+            if (front.num_frames == 0)
+            {
+                queue.pop_front();
+            }
+            wanted -= n;
+        }
+        queued_frames -= batch_size - wanted;
+    }
+
+    if (taken.empty())
+    {
+        return;
+    }
+
+    spans.reserve(taken.size());
+    for (const Segment &segment : taken)
+    {
+        Clip &clip = *segment.clip;
+        spans.push_back({clip.audio + static_cast<size_t>(segment.first_frame) * FFT_HOP,
+                         segment.num_frames, &clip.item.results, segment.first_frame});
+    }
+
+    try
+    {
+        if (!failed)
+        {
+            engine.run_packed(spans.data(), static_cast<int>(spans.size()), options.inference);
+
+            std::lock_guard lock(sink_mutex);
+            summary.num_batches++;
+        }
+    }
+    catch (...)
+    {
+        fail(std::current_exception());
+    }
+
+    // after a failure the frames are still counted off so the run drains
+    for (const Segment &segment : taken)
+    {
+        if (segment.clip->remaining.fetch_sub(segment.num_frames) == segment.num_frames)
+        {
+            deliver(segment.clip);
+        }
+    }
+
+    std::lock_guard lock(mutex);
+    schedule();
+}
+
+void BatchRun::deliver(const std::shared_ptr<Clip> &clip)
+{
+    {
+        std::lock_guard lock(sink_mutex);
+        if (!clip->item.error.empty())
+        {
+            summary.num_failed++;
+        }
+        summary.num_frames += clip->item.results.num_frames;
+        summary.audio_seconds += clip->item.duration_seconds;
+
+        try
+        {
+            if (!failed)
+            {
+                sink(clip->item);
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    }
+
+    // the audio is no longer needed, even if segments of this clip are still referenced
+    clip->owned = {};
+    clip->owned.shrink_to_fit();
+
+    std::lock_guard lock(mutex);
+    open--;
+    open_clips();
+    schedule();
+}
+
+BatchAnalysisSummary run_batch_analysis(const size_t num_clips, Loader loader,
+                                        const BatchSink &sink,
+                                        const BatchAnalysisOptions &options, Engine *engine)
+{
+    if (engine)
+    {
+        return BatchRun(num_clips, std::move(loader), sink, options, *engine).run();
+    }
+
+    EngineOptions engine_options;
+    engine_options.num_sessions = options.num_threads > 0
+                                      ? options.num_threads
+                                      : std::max(
+                                          static_cast<int>(std::thread::hardware_concurrency()),
+                                          1);
+    Engine local_engine(engine_options);
+    return BatchRun(num_clips, std::move(loader), sink, options, local_engine).run();
+}
+
+Loader file_loader(const std::vector<std::string> &paths)
+{
+    return [&paths](const size_t index, Clip &clip) {
+        clip.item.path = paths[index];
+        clip.owned = load_audio(paths[index]);
+        clip.audio = clip.owned.data();
+        clip.length = clip.owned.size();
+    };
+}
+
+Loader buffer_loader(const std::vector<AudioClip> &clips)
+{
+    return [&clips](const size_t index, Clip &clip) {
+        const AudioClip &input = clips[index];
+        if (input.sample_rate == constants::SAMPLE_RATE)
+        {
+            clip.audio = input.audio_data;
+            clip.length = input.length;
+            return;
+        }
+        clip.owned = resample(input.audio_data, input.length, input.sample_rate);
+        clip.audio = clip.owned.data();
+        clip.length = clip.owned.size();
+    };
+}
+} // namespace
+
+BatchAnalysisSummary analyze_batch(const std::vector<std::string> &paths, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options)
+{
+    return run_batch_analysis(paths.size(), file_loader(paths), sink, options, nullptr);
+}
+
+BatchAnalysisSummary analyze_batch(const std::vector<std::string> &paths, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options, Engine &engine)
+{
+    return run_batch_analysis(paths.size(), file_loader(paths), sink, options, &engine);
+}
+
+BatchAnalysisSummary analyze_batch(const std::vector<AudioClip> &clips, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options)
+{
+    return run_batch_analysis(clips.size(), buffer_loader(clips), sink, options, nullptr);
+}
+
+BatchAnalysisSummary analyze_batch(const std::vector<AudioClip> &clips, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options, Engine &engine)
+{
+    return run_batch_analysis(clips.size(), buffer_loader(clips), sink, options, &engine);
+}
+} // namespace crepe
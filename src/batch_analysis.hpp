@@ -0,0 +1,82 @@
+#ifndef CREPE_BATCH_ANALYSIS_HPP
+#define CREPE_BATCH_ANALYSIS_HPP
+
+// Corpus analysis over many files or buffers of very different lengths. Decoding, framing and
+// inference are tasks on one work-stealing pool, and frames from different clips are packed
+// into shared model batches, so short clips fill batches together and long clips spread over
+// every worker instead of holding one.
+
+#include "crepe.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace crepe
+{
+struct BatchAnalysisOptions
+{
+    // batch_size is the size of the shared batches. With coarse_hop_frames above 1 each clip is
+    // analysed on its own by Engine::run_frames (still on the pool) instead of being packed.
+    // Frames are decoded one by one, so PitchDecoder::Viterbi falls back to WeightedAverage;
+    // analyze_file or Engine::run give the smoothed path.
+    InferenceOptions inference;
+
+    // Pool workers, 0 for one per hardware thread. Without an explicit engine, the engine
+    // created for the call gets one session per worker.
+    int num_threads = 0;
+
+    // Clips decoded and waiting for inference at any one time, bounding memory.
+    // 0 means four per worker.
+    int max_open_clips = 0;
+};
+
+// A buffer to analyse in place; it must outlive the call
+struct AudioClip
+{
+    const float *audio_data;
+    size_t length;
+    int sample_rate = constants::SAMPLE_RATE;
+};
+
+struct BatchItem
+{
+    size_t index = 0; // position in the input list
+    std::string path; // empty for buffers
+    PredictionResults results{}; // times from the start of the clip
+    double duration_seconds = 0.0;
+    std::string error; // set when the clip could not be decoded, results are then empty
+};
+
+// Called once per clip as soon as its last frame is analysed, so in completion order rather than
+// input order. Calls are serialized; the item may be moved from.
+using BatchSink = std::function<void(BatchItem &item)>;
+
+struct BatchAnalysisSummary
+{
+    size_t num_clips = 0;
+    size_t num_failed = 0;
+    int64_t num_frames = 0;
+    int64_t num_batches = 0;
+    double audio_seconds = 0.0;
+    double wall_seconds = 0.0;
+};
+
+// Decode failures are reported per item; an inference or sink failure stops the run and is
+// rethrown once the pool is idle.
+BatchAnalysisSummary analyze_batch(const std::vector<std::string> &paths, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options = {});
+
+BatchAnalysisSummary analyze_batch(const std::vector<std::string> &paths, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options, Engine &engine);
+
+BatchAnalysisSummary analyze_batch(const std::vector<AudioClip> &clips, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options = {});
+
+BatchAnalysisSummary analyze_batch(const std::vector<AudioClip> &clips, const BatchSink &sink,
+                                   const BatchAnalysisOptions &options, Engine &engine);
+} // namespace crepe
+
+#endif //CREPE_BATCH_ANALYSIS_HPP
@@ -0,0 +1,303 @@
+#include "batch_scheduler.hpp"
+#include "resampler.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace crepe
+{
+// One submitted clip, shared by its queued segments
+struct BatchScheduler::Request
+{
+    std::vector<float> audio;
+    PredictionResults results{};
+    std::atomic<int> remaining{0}; // frames still waiting for the model
+    std::chrono::steady_clock::time_point submitted;
+
+    std::promise<PredictionResults> promise; // when there is no callback
+    RequestCallback callback;
+
+    std::mutex error_mutex;
+    std::exception_ptr error; // the first failure of any of its batches
+
+    void load(std::vector<float> audio_data, const int sample_rate)
+    {
+        audio = sample_rate == constants::SAMPLE_RATE
+                    ? std::move(audio_data)
+                    : resample(audio_data.data(), audio_data.size(), sample_rate);
+    }
+
+    void fail(std::exception_ptr exception)
+    {
+        std::lock_guard lock(error_mutex);
+        if (!error)
+        {
+            error = std::move(exception);
+        }
+    }
+
+    void complete()
+    {
+        if (stats::enabled())
+        {
+            const std::chrono::duration<double, std::micro> elapsed =
+                std::chrono::steady_clock::now() - submitted;
+            stats::record_latency(stats::Stage::Request, elapsed.count());
+        }
+
+        if (callback)
+        {
+            // a throwing callback must not take the dispatcher down with it
+            try
+            {
+                callback(std::move(results), error);
+            }
+            catch (...)
+            {
+            }
+        }
+        else if (error)
+        {
+            promise.set_exception(error);
+        }
+        else
+        {
+            promise.set_value(std::move(results));
+        }
+        audio = {};
+    }
+};
+
+BatchScheduler::BatchScheduler(Engine &engine, const BatchSchedulerOptions &options)
+    : engine(engine), options(options)
+{
+    batch_size = std::max(options.inference.batch_size, 1);
+    max_delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(std::max(options.max_delay_ms, 0.0)));
+
+    const int num_dispatchers = options.num_dispatchers > 0
+                                    ? options.num_dispatchers
+                                    : std::max(engine.options().num_sessions, 1);
+    dispatchers.reserve(num_dispatchers);
+    for (int i = 0; i < num_dispatchers; i++)
+    {
+        dispatchers.emplace_back([this] { dispatch(); });
+    }
+}
+
+BatchScheduler::BatchScheduler(const BatchSchedulerOptions &options)
+    : BatchScheduler(Engine::default_engine(), options)
+{
+}
+
+BatchScheduler::~BatchScheduler()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &dispatcher : dispatchers)
+    {
+        dispatcher.join();
+    }
+}
+
+std::future<PredictionResults> BatchScheduler::submit(const float *audio_data, const int length,
+                                                      const int sample_rate)
+{
+    return submit(std::vector<float>(audio_data, audio_data + std::max(length, 0)), sample_rate);
+}
+
+std::future<PredictionResults> BatchScheduler::submit(std::vector<float> audio_data,
+                                                      const int sample_rate)
+{
+    auto request = std::make_shared<Request>();
+    std::future<PredictionResults> future = request->promise.get_future();
+    request->load(std::move(audio_data), sample_rate);
+    enqueue(std::move(request));
+    return future;
+}
+
+void BatchScheduler::submit(std::vector<float> audio_data, const int sample_rate,
+                            RequestCallback callback)
+{
+    auto request = std::make_shared<Request>();
+    request->callback = std::move(callback);
+    request->load(std::move(audio_data), sample_rate);
+    enqueue(std::move(request));
+}
+
+int BatchScheduler::pending_frames() const
+{
+    std::lock_guard lock(mutex);
+    return queued_frames;
+}
+
+void BatchScheduler::enqueue(std::shared_ptr<Request> request)
+{
+    using namespace constants;
+
+    request->submitted = std::chrono::steady_clock::now();
+    const int length = static_cast<int>(request->audio.size());
+    const int num_frames = length < FRAME_LENGTH ? 0 : (length - FRAME_LENGTH) / FFT_HOP + 1;
+
+    PredictionResults &results = request->results;
+    results.pitches.resize(num_frames);
+    results.confidences.resize(num_frames);
+    results.times.resize(num_frames);
+    results.voiced.resize(num_frames);
+    results.num_frames = num_frames;
+    for (int i = 0; i < num_frames; i++)
+    {
+        results.times(i) = static_cast<float>(i * FFT_HOP) / static_cast<float>(SAMPLE_RATE);
+    }
+
+    // runs of frames for the shared queue, only the audible ones with the silence gate on
+    std::vector<Segment> segments;
+    if (std::isfinite(options.inference.silence_threshold_db))
+    {
+        const float min_rms = std::pow(10.0f, options.inference.silence_threshold_db / 20.0f);
+        std::vector<float> rms(num_frames);
+        frame_rms(request->audio.data(), num_frames, FFT_HOP, rms.data());
+
+        for (int i = 0; i < num_frames; i++)
+        {
+            if (rms[i] >= min_rms)
+            {
+                if (segments.empty() ||
+                    segments.back().first_frame + segments.back().num_frames != i)
+                {
+                    segments.push_back({request, i, 0});
+                }
+                segments.back().num_frames++;
+            }
+            else
+            {
+                results.pitches(i) = 0.0f;
+                results.confidences(i) = 0.0f;
+                results.voiced(i) = false;
+            }
+        }
+    }
+    else if (num_frames > 0)
+    {
+        segments.push_back({request, 0, num_frames});
+    }
+
+    int queued = 0;
+    for (const Segment &segment : segments)
+    {
+        queued += segment.num_frames;
+    }
+    if (queued == 0)
+    {
+        request->complete();
+        return;
+    }
+    request->remaining = queued;
+
+    {
+        std::lock_guard lock(mutex);
+        for (Segment &segment : segments)
+        {
+            queue.push_back(std::move(segment));
+        }
+        queued_frames += queued;
+    }
+    // a full batch to run, or a new deadline for an idle dispatcher
+    work_available.notify_one();
+}
+
+void BatchScheduler::take_batch(std::vector<Segment> &taken)
+{
+    int wanted = batch_size;
+    while (wanted > 0 && !queue.empty())
+    {
+        Segment &front = queue.front();
+        const int n = std::min(wanted, front.num_frames);
+        taken.push_back({front.request, front.first_frame, n});
+        front.first_frame += n;
+        front.num_frames -= n;
+        if (front.num_frames == 0)
+        {
+            queue.pop_front();
+        }
+        wanted -= n;
+    }
+    queued_frames -= batch_size - wanted;
+}
+
+void BatchScheduler::dispatch()
+{
+    using namespace constants;
+
+    std::vector<Segment> taken;
+    std::vector<FrameSpan> spans;
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex);
+
+            // a full batch, or the oldest request out of time (the queue is in submission order)
+            while (queued_frames < batch_size && !(stopping && queued_frames > 0))
+            {
+                if (queue.empty())
+                {
+                    if (stopping)
+                    {
+                        return;
+                    }
+                    work_available.wait(lock);
+                    continue;
+                }
+                const auto deadline = queue.front().request->submitted + max_delay;
+                if (std::chrono::steady_clock::now() >= deadline)
+                {
+                    break;
+                }
+                work_available.wait_until(lock, deadline);
+            }
+            take_batch(taken);
+
+            // hand what is left to another dispatcher rather than waiting for this batch
+            if (!queue.empty())
+            {
+                work_available.notify_one();
+            }
+        }
+
+        for (const Segment &segment : taken)
+        {
+            spans.push_back({segment.request->audio.data() +
+                             static_cast<size_t>(segment.first_frame) * FFT_HOP,
+                             segment.num_frames, &segment.request->results, segment.first_frame});
+        }
+
+        try
+        {
+            engine.run_packed(spans.data(), static_cast<int>(spans.size()), options.inference);
+        }
+        catch (...)
+        {
+            for (const Segment &segment : taken)
+            {
+                segment.request->fail(std::current_exception());
+            }
+        }
+
+        // failed frames are still counted off, so their request completes with the error
+        for (const Segment &segment : taken)
+        {
+            if (segment.request->remaining.fetch_sub(segment.num_frames) == segment.num_frames)
+            {
+                segment.request->complete();
+            }
+        }
+        taken.clear();
+        spans.clear();
+    }
+}
+} // namespace crepe
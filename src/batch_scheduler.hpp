@@ -0,0 +1,106 @@
+#ifndef CREPE_BATCH_SCHEDULER_HPP
+#define CREPE_BATCH_SCHEDULER_HPP
+
+// Dynamic batching for services where many threads analyse short clips at the same time.
+// Requests are queued and their frames packed into shared model batches by a few dispatcher
+// threads: a batch runs as soon as it is full, or once its oldest request has waited
+// max_delay_ms, so light load keeps its latency and heavy load fills batches.
+
+#include "crepe.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crepe
+{
+struct BatchSchedulerOptions
+{
+    // batch_size is the largest shared batch. The silence gate applies per request, the
+    // adaptive hop does not, and Viterbi decodes as WeightedAverage (see Engine::run_packed).
+    InferenceOptions inference;
+
+    // Longest a request waits for others to fill its batch before a partial one runs. Frames of
+    // a request that already sits in a full batch are never held back.
+    double max_delay_ms = 2.0;
+
+    // Batches run at the same time, each on its own pooled session. 0 means the engine's
+    // num_sessions.
+    int num_dispatchers = 0;
+};
+
+// Gets the results, or the exception the model threw for any of its frames
+using RequestCallback = std::function<void(PredictionResults results, std::exception_ptr error)>;
+
+// All member functions are thread safe. The destructor finishes every queued request.
+class BatchScheduler
+{
+public:
+    explicit BatchScheduler(Engine &engine, const BatchSchedulerOptions &options = {});
+
+    // On the default engine
+    explicit BatchScheduler(const BatchSchedulerOptions &options = {});
+
+    ~BatchScheduler();
+
+    BatchScheduler(const BatchScheduler &) = delete;
+
+    BatchScheduler &operator=(const BatchScheduler &) = delete;
+
+    // The audio is copied (resampled to 16 kHz when needed) before returning. Results are the
+    // same as run_inference on the clip, times from its start.
+    std::future<PredictionResults> submit(const float *audio_data, int length,
+                                          int sample_rate = constants::SAMPLE_RATE);
+
+    std::future<PredictionResults> submit(std::vector<float> audio_data,
+                                          int sample_rate = constants::SAMPLE_RATE);
+
+    // Calls callback on a dispatcher thread (or this one for clips too short for a frame) once
+    // the results are ready. It should return quickly, batches of other requests wait on it.
+    void submit(std::vector<float> audio_data, int sample_rate, RequestCallback callback);
+
+    // Frames queued and not yet taken into a batch
+    int pending_frames() const;
+
+private:
+    struct Request;
+
+    // Frames of a request waiting for a batch
+    struct Segment
+    {
+        std::shared_ptr<Request> request;
+        int first_frame;
+        int num_frames;
+    };
+
+    Engine &engine;
+    BatchSchedulerOptions options;
+    int batch_size;
+    std::chrono::steady_clock::duration max_delay;
+
+    mutable std::mutex mutex; // guards everything below
+    std::condition_variable work_available;
+    std::deque<Segment> queue;
+    int queued_frames = 0;
+    bool stopping = false;
+
+    std::vector<std::thread> dispatchers; // last, joined before anything they use is destroyed
+
+    void enqueue(std::shared_ptr<Request> request);
+
+    void dispatch();
+
+    // Takes up to batch_size frames off the queue, with mutex held
+    void take_batch(std::vector<Segment> &taken);
+};
+} // namespace crepe
+
+#endif //CREPE_BATCH_SCHEDULER_HPP
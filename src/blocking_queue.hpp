@@ -0,0 +1,76 @@
+#ifndef CREPE_BLOCKING_QUEUE_HPP
+#define CREPE_BLOCKING_QUEUE_HPP
+
+// Internal bounded MPMC queue for handing work between pipeline threads
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+
+namespace crepe
+{
+template <typename T>
+class BlockingQueue
+{
+public:
+    explicit BlockingQueue(const size_t capacity = std::numeric_limits<size_t>::max())
+        : capacity(capacity)
+    {
+    }
+
+    // Blocks while full, returns false once the queue is closed
+    bool push(T value)
+    {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed)
+        {
+            return false;
+        }
+        items.push_back(std::move(value));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty, returns nothing once the queue is closed and drained
+    std::optional<T> pop()
+    {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty())
+        {
+            return std::nullopt;
+        }
+        T value = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return value;
+    }
+
+    // Wakes every waiter; pending items can still be popped
+    void close()
+    {
+        {
+            std::lock_guard lock(mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+} // namespace crepe
+
+#endif //CREPE_BLOCKING_QUEUE_HPP
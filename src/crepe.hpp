@@ -2,7 +2,13 @@
 #define CREPE_HPP
 
 #include <Eigen/Dense>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef CREPE_WITH_ORT
 #include <onnxruntime_cxx_api.h>
+#endif
 
 namespace crepe
 {
@@ -21,9 +27,13 @@ constexpr float FREQ_MAX = 7900.0f; // approx max frequency (Hz)
 constexpr float CENTER_OFFSET = 0.5f;
 constexpr float OCTAVE_BASE = 2.0f;
 constexpr float BINS_PER_OCTAVE = 120.0f;
+constexpr int OUTPUT_SIZE = 360; // activation bins per frame
+constexpr int BATCH_SIZE = 64; // default frames per session.Run call
 
 constexpr int ONNX_THREADS = 1;
+#ifdef CREPE_WITH_ORT
 constexpr int ONNX_LOG_LEVEL = ORT_LOGGING_LEVEL_WARNING;
+#endif
 
 constexpr float CONFIDENCE_THRESHOLD = 0.5f;
 constexpr int MIN_FRAMES = 5;
@@ -35,9 +45,265 @@ struct PredictionResults
     Eigen::VectorXf pitches;
     Eigen::VectorXf confidences;
     Eigen::VectorXf times;
+    // false for frames below the voicing threshold and for frames the silence gate skipped
+    // (those also report zero pitch and confidence)
+    Eigen::Array<bool, Eigen::Dynamic, 1> voiced;
     int num_frames;
 };
 
+// How a frame's activations become a pitch. Confidence is always the strongest bin's activation.
+enum class PitchDecoder
+{
+    Argmax, // centre of the strongest bin, in 20 cent steps
+    WeightedAverage, // activation-weighted average of the cents around the strongest bin
+    // WeightedAverage around each frame's bin on the most likely smooth path through all
+    // frames, which removes isolated octave jumps. Needs the whole sequence: Engine::run and
+    // run_frames keep every frame's activations (1.4 kB per frame) and skip the adaptive hop,
+    // CrepeStream and analyze_file decide each frame viterbi_lag_frames late, and run_packed,
+    // run_multichannel and batch analysis decode frame by frame as WeightedAverage.
+    Viterbi
+};
+
+// Per-call inference options
+struct InferenceOptions
+{
+    // Frames packed into one [batch_size, FRAME_LENGTH] input tensor per session.Run.
+    // The last batch holds whatever frames are left over.
+    int batch_size = constants::BATCH_SIZE;
+
+    // Frames whose RMS level is below this many dBFS skip the model entirely and come back
+    // unvoiced with zero confidence. Off (-inf) by default.
+    float silence_threshold_db = -std::numeric_limits<float>::infinity();
+
+    // Confidence at or above which a frame is marked voiced
+    float voicing_threshold = constants::CONFIDENCE_THRESHOLD;
+
+    // Adaptive hop for offline analysis. Above 1, the model first runs on every
+    // coarse_hop_frames-th frame; the FFT_HOP grid in between is only evaluated where the two
+    // neighbouring coarse estimates differ by more than refine_cents_threshold or disagree on
+    // voicing, and is interpolated everywhere else. Results stay on the FFT_HOP grid.
+    int coarse_hop_frames = 1;
+    float refine_cents_threshold = 25.0f;
+
+    PitchDecoder decoder = PitchDecoder::Argmax;
+
+    // Frames a CrepeStream holds back with PitchDecoder::Viterbi before deciding their bin. Longer
+    // lags follow the offline path more closely at the cost of latency (10 ms per frame).
+    int viterbi_lag_frames = 16;
+};
+
+enum class ExecutionMode
+{
+    Sequential, // operators run one after another, parallelism comes from intra_op_threads
+    Parallel // independent graph branches run concurrently on inter_op_threads
+};
+
+// CREPE model sizes, from 1/8 (tiny) to the full width of the convolution stack
+enum class Capacity
+{
+    Tiny,
+    Small,
+    Medium,
+    Large,
+    Full
+};
+
+// Lowercase name as used in model file names ("tiny" ... "full")
+const char *capacity_name(Capacity capacity);
+
+// Numeric format of the model weights and activations
+enum class Precision
+{
+    Float32,
+    Int8 // quantized with scripts/quantize-model.py, always loaded from model_dir
+};
+
+enum class Backend
+{
+    OnnxRuntime, // the .ort model on ONNX Runtime, only in builds with CREPE_WITH_ORT
+    Native // built-in Eigen forward pass over the .onnx weights, no runtime dependency
+};
+
+// Construction-time engine configuration
+struct EngineOptions
+{
+#ifdef CREPE_WITH_ORT
+    Backend backend = Backend::OnnxRuntime;
+#else
+    Backend backend = Backend::Native;
+#endif
+
+    // ORT intra-op threads, or for the native backend the frames of a batch run in parallel
+    int intra_op_threads = constants::ONNX_THREADS;
+    int inter_op_threads = 1;
+    ExecutionMode execution_mode = ExecutionMode::Sequential;
+
+    // Size of the session pool. Concurrent calls and the batches of one call each take a
+    // session of their own, so this is the engine's maximum parallelism. Sessions are created
+    // on first use, so an engine that is never run costs little more than the model mapping.
+    int num_sessions = 1;
+
+    // Optional logical cpu ids for the intra-op worker threads, handed out to the pooled
+    // sessions in order (session s uses ids [s * (intra_op_threads - 1), ...), wrapping)
+    std::vector<int> cpu_affinity;
+
+    // Model variant. The embedded model is the tiny capacity; the others are memory-mapped from
+    // model_dir/model-<capacity_name>.ort (see scripts/convert-capacities.sh)
+    Capacity capacity = Capacity::Tiny;
+
+    // Directory of model-<capacity>.ort files (model-<capacity>-int8.ort for Int8, and
+    // model-<capacity>.onnx for the native backend); when set it is used for Tiny as well
+    std::string model_dir;
+
+    Precision precision = Precision::Float32;
+
+    // An explicit model file to memory-map (.onnx for the native backend), overrides capacity
+    // and model_dir
+    std::string model_path;
+
+    // When set, whole-buffer runs (Engine::run, run_inference on this engine) keep the raw
+    // activations of every frame in this directory, keyed by the audio content and the model,
+    // and later runs over the same audio only decode them. They are stored as fp16, so
+    // confidences may differ by about 1e-3 from an uncached run and near-ties between bins may
+    // pick the neighbouring bin. The silence gate is applied while decoding and the
+    // adaptive hop does not apply. Streams, run_frames and batch analysis are not cached.
+    std::string activation_cache_dir;
+
+    // When set, every session runs ORT's built-in profiler and writes a chrome trace named
+    // <profile_prefix>_session<N>_<timestamp>.json, finalized by Engine::end_profiling
+    std::string profile_prefix;
+};
+
+// Sample order of multichannel buffers, length samples per channel
+enum class ChannelLayout
+{
+    Interleaved, // sample t of channel c at [t * num_channels + c]
+    Planar // channels back to back, sample t of channel c at [c * length + t]
+};
+
+// A run of consecutive FFT_HOP-spaced frames of one buffer, see Engine::run_packed
+struct FrameSpan
+{
+    const float *audio_data; // first sample of the first frame
+    int num_frames;
+    PredictionResults *results;
+    int first_index; // index in results of the first frame
+};
+
+// Escalation rules of Engine::run_cascade, which screens every frame with a cheap engine and
+// only runs the expensive one where the screen is unsure or the pitch moves
+struct CascadeOptions
+{
+    // For both passes. The full pass runs frame by frame (no adaptive hop, Viterbi decodes as
+    // WeightedAverage).
+    InferenceOptions inference;
+
+    // Screen confidences in [ambiguous_low, ambiguous_high) escalate. Frames below are taken as
+    // the screen has them (unvoiced); frames above keep the screen's confidence and voicing.
+    float ambiguous_low = 0.25f;
+    float ambiguous_high = 0.75f;
+
+    // A confident frame also escalates when its screen pitch has moved more than this since the
+    // last escalated frame. Otherwise its pitch is that frame's full pitch, shifted by the
+    // screen's change since then.
+    float pitch_change_cents = 50.0f;
+
+    // ... or when the last escalated frame is more than this many frames back (0 for never)
+    int refresh_frames = 50;
+};
+
+struct CascadeSummary
+{
+    int num_frames = 0;
+    int escalated = 0; // frames the full model ran on, the sum of the reasons below
+    int ambiguous = 0;
+    int pitch_changed = 0;
+    int refreshed = 0; // the first confident frame, or after refresh_frames
+};
+
+// An independent inference engine over the CREPE model. Engines share nothing but the
+// process-wide ORT environment and mappings of the same model file, so several pipelines (and
+// capacities) can run side by side with their own thread budgets. All member functions are
+// thread safe. Throws std::runtime_error when the model file cannot be opened.
+class Engine
+{
+public:
+    explicit Engine(const EngineOptions &options = {});
+
+    ~Engine();
+
+    Engine(const Engine &) = delete;
+
+    Engine &operator=(const Engine &) = delete;
+
+    // The engine behind the free run_inference/run_frames functions
+    static Engine &default_engine();
+
+    PredictionResults run(const float *audio_data, int length, int sample_rate,
+                          const InferenceOptions &options = {});
+
+    PredictionResults run(const std::vector<float> &audio_data, int sample_rate,
+                          const InferenceOptions &options = {});
+
+    // Reuses the vectors in results, allocation free when they already have the right size
+    void run(const float *audio_data, int length, int sample_rate, PredictionResults &results,
+             const InferenceOptions &options = {});
+
+    // See crepe::run_frames
+    void run_frames(const float *audio_data, int num_frames, PredictionResults &results,
+                    int first_index, const InferenceOptions &options = {});
+
+    // run_frames that also copies the raw activations out, row-major [num_frames, OUTPUT_SIZE]
+    // (zero rows for frames the silence gate skipped), for decoders that need more than one
+    // frame. Frames are decoded one by one (Viterbi as WeightedAverage), no adaptive hop.
+    void run_frames(const float *audio_data, int num_frames, PredictionResults &results,
+                    int first_index, float *activations, const InferenceOptions &options = {});
+
+    // Frames from any number of buffers packed into shared batches: spans are framed back to
+    // back into the same input tensor and decoded into their own results (times are left
+    // alone). Runs on the calling thread with one session at a time, so callers bring their own
+    // parallelism. The silence gate and adaptive hop do not apply here.
+    void run_packed(const FrameSpan *spans, int num_spans, const InferenceOptions &options = {});
+
+    // Cascaded evaluation of a whole buffer: screen (e.g. the tiny capacity) runs on every frame,
+    // this engine only on the frames the CascadeOptions escalate. Same results as run.
+    PredictionResults run_cascade(Engine &screen, const float *audio_data, int length,
+                                  int sample_rate, const CascadeOptions &options = {},
+                                  CascadeSummary *summary = nullptr);
+
+    // One independent pitch track per channel, no downmix. The frames of all channels share
+    // batches and are deinterleaved while framing; batches run in parallel over the session
+    // pool. length is the number of samples per channel. The silence gate and adaptive hop do
+    // not apply here.
+    std::vector<PredictionResults> run_multichannel(const float *audio_data, int length,
+                                                    int num_channels, ChannelLayout layout,
+                                                    int sample_rate,
+                                                    const InferenceOptions &options = {});
+
+    // Reuses the vectors in results (one entry per channel)
+    void run_multichannel(const float *audio_data, int length, int num_channels,
+                          ChannelLayout layout, int sample_rate,
+                          std::vector<PredictionResults> &results,
+                          const InferenceOptions &options = {});
+
+    // Raw model: normalized row-major [num_frames, FRAME_LENGTH] frames (see frame_audio) in,
+    // row-major [num_frames, OUTPUT_SIZE] activations out
+    void infer(const float *frames, int num_frames, float *activations,
+               const InferenceOptions &options = {});
+
+    // Flush ORT profiler traces (see EngineOptions::profile_prefix), returns their paths
+    std::vector<std::string> end_profiling();
+
+    const EngineOptions &options() const;
+
+    // The model file in use, empty for the embedded model
+    const std::string &model_path() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
 // Analysis results (derived statistics)
 struct PredictionAnalytics
 {
@@ -45,7 +311,7 @@ struct PredictionAnalytics
     float max_frequency = 0.0f;
     float mean_confidence = 0.0f;
     float time_pitch_correlation = 0.0f;
-    const PredictionResults *source_data = nullptr;
+    const PredictionResults *source_data = nullptr; // null when built incrementally
 };
 
 float calculate_correlation(const Eigen::Ref<const Eigen::VectorXf> &x,
@@ -57,12 +323,121 @@ void analyze_frequency_bins();
 
 void normalize_audio(Eigen::Ref<Eigen::VectorXf> audio_vec);
 
-PredictionResults run_inference(const std::vector<float> &audio_data, int sample_rate);
+// Build the normalized model input for num_frames frames spaced hop samples apart in one pass.
+// frames is row-major [num_frames, FRAME_LENGTH]; each row matches normalize_audio of that
+// frame, with mean and variance taken from sliding window sums instead of per-frame passes.
+// rms, if given, receives each frame's RMS level before normalization.
+void frame_audio(const float *audio_data, int num_frames, int hop, float *frames,
+                 float *rms = nullptr);
+
+// frame_audio over every stride-th sample, e.g. one channel of interleaved audio (hop is in
+// samples of that channel)
+void frame_audio_strided(const float *audio_data, int stride, int num_frames, int hop,
+                         float *frames, float *rms = nullptr);
+
+// Just the per-frame RMS levels of frame_audio, from the same sliding sums
+void frame_rms(const float *audio_data, int num_frames, int hop, float *rms);
+
+// Audio at any sample rate other than SAMPLE_RATE is resampled first
+PredictionResults run_inference(const std::vector<float> &audio_data, int sample_rate,
+                                const InferenceOptions &options = {});
 
-PredictionResults run_inference(const float *audio_data, int length, int sample_rate);
+PredictionResults run_inference(const float *audio_data, int length, int sample_rate,
+                                const InferenceOptions &options = {});
 
+// See Engine::run_multichannel
+std::vector<PredictionResults> run_multichannel(const float *audio_data, int length,
+                                                int num_channels, ChannelLayout layout,
+                                                int sample_rate,
+                                                const InferenceOptions &options = {});
+
+// Run the model over num_frames frames spaced FFT_HOP apart starting at audio_data and write
+// pitch/confidence into results at [first_index, first_index + num_frames). Times are left alone.
+void run_frames(const float *audio_data, int num_frames, PredictionResults &results,
+                int first_index, const InferenceOptions &options = {});
+
+// Whole-track statistics in one pass; OnlineAnalytics (analytics.hpp) keeps them incrementally
 PredictionAnalytics calculate_analytics(const PredictionResults &results);
 
+class Resampler;
+class OnlineViterbi;
+
+// Incremental pitch tracker for live input at the full FFT_HOP frame rate.
+// Samples (mono) go into a mirrored ring buffer so that every run of pending frames is one
+// contiguous window; nothing is shifted, copied out or reallocated after construction.
+// Input at any other rate than SAMPLE_RATE passes through a streaming resampler first; frame times
+// have its delay taken off so they match analyze_file on the same input.
+class CrepeStream
+{
+public:
+    // max_pending_frames bounds memory: when more frames than that are waiting, the oldest are
+    // dropped (see dropped_frames()). Defaults to one inference batch.
+    explicit CrepeStream(const InferenceOptions &options = {}, int max_pending_frames = 0,
+                         int input_sample_rate = constants::SAMPLE_RATE);
+
+    explicit CrepeStream(Engine &engine, const InferenceOptions &options = {},
+                         int max_pending_frames = 0,
+                         int input_sample_rate = constants::SAMPLE_RATE);
+
+    ~CrepeStream();
+
+    CrepeStream(const CrepeStream &) = delete;
+
+    CrepeStream &operator=(const CrepeStream &) = delete;
+
+    void push(const float *samples, size_t count);
+
+    void push(const std::vector<float> &samples) { push(samples.data(), samples.size()); }
+
+    // Analyse pending frames into results and return how many were written (also num_frames).
+    // The result vectors are treated as capacity: size them once and reuse them to stay
+    // allocation free. Empty vectors are sized to max_pending_frames. With
+    // PitchDecoder::Viterbi the frames written are the ones decided so far, which trail the
+    // analysed ones by viterbi_lag_frames.
+    int poll(PredictionResults &results);
+
+    // At the end of the input: writes the frames PitchDecoder::Viterbi still holds back (up to the
+    // results capacity) and returns how many. Nothing to do for the other decoders.
+    int flush(PredictionResults &results);
+
+    int pending_frames() const;
+
+    int64_t frames_emitted() const { return next_frame; }
+
+    int64_t dropped_frames() const { return dropped; }
+
+    void reset();
+
+private:
+    Engine *engine;
+    InferenceOptions options;
+    std::vector<float> ring; // 2 * capacity, every sample written twice
+    size_t capacity;
+    int max_frames; // frames the ring holds, the most that can be pending
+    int64_t samples_pushed = 0;
+    int64_t next_frame = 0; // absolute index of the next frame to emit
+    int64_t dropped = 0;
+    int64_t reported_pending = 0; // last value added to the stats gauge
+
+    std::unique_ptr<Resampler> resampler; // only when input_sample_rate != SAMPLE_RATE
+    std::vector<float> resampled; // grows to the largest push, then reused
+    int64_t time_offset = 0; // resampler delay in samples, taken off every frame time
+
+    // only with PitchDecoder::Viterbi
+    std::unique_ptr<OnlineViterbi> viterbi;
+    std::vector<float> activations; // [max_pending_frames, OUTPUT_SIZE]
+    std::vector<int64_t> held_frames; // frame number of each frame viterbi holds, a ring
+
+    void report_pending();
+
+    void push_resampled(const float *samples, size_t count);
+
+    float frame_time(int64_t frame) const;
+
+    // times and voicing of the count frames viterbi decided last, written to results[0, count)
+    void fill_decided(PredictionResults &results, int count) const;
+};
+
 }
 
 #endif //CREPE_HPP
\ No newline at end of file
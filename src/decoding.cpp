@@ -0,0 +1,272 @@
+#include "decoding.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+
+namespace crepe
+{
+namespace
+{
+using constants::OUTPUT_SIZE;
+
+constexpr int BAND = 11; // transitions reach this many bins either way
+constexpr int AVERAGE_RADIUS = 4; // bins on each side of the centre in the local average
+constexpr float SELF_EMISSION = 0.1f;
+constexpr float UNREACHABLE = -1e30f; // finite, so fast-math builds compare it normally
+
+// Log-domain HMM parameters. The transition from bin i to bin j has weight 12 - |i - j|,
+// normalized over the bins reachable from i (fewer near the edges).
+struct Model
+{
+    float log_weight[BAND + 1]{}; // by distance
+    float log_norm[OUTPUT_SIZE]{}; // by source bin
+    float observed_bonus; // log P(bin observed | in bin) - log P(bin observed | elsewhere)
+
+    Model()
+    {
+        for (int d = 0; d <= BAND; d++)
+        {
+            log_weight[d] = std::log(static_cast<float>(BAND + 1 - d));
+        }
+        for (int i = 0; i < OUTPUT_SIZE; i++)
+        {
+            float sum = 0.0f;
+            for (int j = std::max(i - BAND, 0); j <= std::min(i + BAND, OUTPUT_SIZE - 1); j++)
+            {
+                sum += static_cast<float>(BAND + 1 - std::abs(i - j));
+            }
+            log_norm[i] = std::log(sum);
+        }
+
+        // emission is SELF_EMISSION for the state itself on top of a uniform share; the other
+        // states' shared term is the same for every bin and drops out of the maximum
+        const float uniform = (1.0f - SELF_EMISSION) / static_cast<float>(OUTPUT_SIZE);
+        observed_bonus = std::log((SELF_EMISSION + uniform) / uniform);
+    }
+};
+
+const Model &model()
+{
+    static const Model instance;
+    return instance;
+}
+
+// Adds one frame's observation (its strongest bin) to the scores, then shifts them so the best
+// is 0 and long inputs stay in float range
+void observe(const float *activation, float *scores)
+{
+    if (const int bin = argmax_bin(activation); activation[bin] > 0.0f)
+    {
+        scores[bin] += model().observed_bonus;
+    }
+    const float best = scores[simd::argmax(scores, OUTPUT_SIZE)];
+    for (int j = 0; j < OUTPUT_SIZE; j++)
+    {
+        scores[j] -= best;
+    }
+}
+
+// Best transition into every bin of the next frame: next[j] = max over the band of
+// previous[j + k] + log transition, backpointers[j] = that k
+void transition(const float *previous, float *next, int8_t *backpointers)
+{
+    const Model &hmm = model();
+
+    // source scores padded with unreachable ones, so every offset in the band stays in bounds
+    std::array<float, OUTPUT_SIZE + 2 * BAND> source;
+    std::fill_n(source.begin(), BAND, UNREACHABLE);
+    std::fill_n(source.end() - BAND, BAND, UNREACHABLE);
+    for (int i = 0; i < OUTPUT_SIZE; i++)
+    {
+        source[BAND + i] = previous[i] - hmm.log_norm[i];
+    }
+
+    // one vector pass per offset instead of a dense 360 x 360 product
+    std::array<float, OUTPUT_SIZE> from;
+    std::fill_n(next, OUTPUT_SIZE, UNREACHABLE);
+    from.fill(0.0f);
+    for (int k = -BAND; k <= BAND; k++)
+    {
+        simd::max_update(source.data() + BAND + k, hmm.log_weight[std::abs(k)],
+                         static_cast<float>(k), next, from.data(), OUTPUT_SIZE);
+    }
+    for (int j = 0; j < OUTPUT_SIZE; j++)
+    {
+        backpointers[j] = static_cast<int8_t>(from[j]);
+    }
+}
+
+// Activation-weighted mean bin over the local average window, and the total weight
+float weighted_bin(const float *activation, const int center, float &total)
+{
+    const int first = std::max(center - AVERAGE_RADIUS, 0);
+    const int last = std::min(center + AVERAGE_RADIUS, OUTPUT_SIZE - 1);
+
+    // the cents are linear in the bin, so average the bin index and convert once
+    float weighted = 0.0f;
+    total = 0.0f;
+    for (int i = first; i <= last; i++)
+    {
+        weighted += activation[i] * static_cast<float>(i);
+        total += activation[i];
+    }
+    return total > 0.0f ? weighted / total : static_cast<float>(center);
+}
+} // namespace
+
+int argmax_bin(const float *activation)
+{
+    return static_cast<int>(simd::argmax(activation, OUTPUT_SIZE));
+}
+
+float bin_to_cents(const float bin)
+{
+    using namespace constants;
+    return MODEL_BASE_CENTS + bin * (MODEL_RANGE_CENTS / (MODEL_BINS - 1.0f));
+}
+
+float cents_to_frequency(const float cents)
+{
+    using namespace constants;
+    return BASE_FREQUENCY * std::pow(OCTAVE_BASE, cents / CENTS_CONVERSION);
+}
+
+float local_average_cents(const float *activation, const int center)
+{
+    float total;
+    return bin_to_cents(weighted_bin(activation, center, total));
+}
+
+float local_average_pitch(const float *activation, const int center)
+{
+    float total;
+    const float bin = weighted_bin(activation, center, total);
+    return total > 0.0f ? cents_to_frequency(bin_to_cents(bin)) : 0.0f;
+}
+
+void ViterbiDecoder::decode_path(const float *activations, const int num_frames, int *bins)
+{
+    if (num_frames <= 0)
+    {
+        return;
+    }
+    backpointers.resize(static_cast<size_t>(num_frames) * OUTPUT_SIZE);
+
+    // uniform prior on the first bin
+    std::array<float, OUTPUT_SIZE> scores_a{};
+    std::array<float, OUTPUT_SIZE> scores_b;
+    float *scores = scores_a.data();
+    float *next = scores_b.data();
+    observe(activations, scores);
+    for (int t = 1; t < num_frames; t++)
+    {
+        const size_t row = static_cast<size_t>(t) * OUTPUT_SIZE;
+        transition(scores, next, backpointers.data() + row);
+        observe(activations + row, next);
+        std::swap(scores, next);
+    }
+
+    int bin = static_cast<int>(simd::argmax(scores, OUTPUT_SIZE));
+    bins[num_frames - 1] = bin;
+    for (int t = num_frames - 1; t > 0; t--)
+    {
+        bin += backpointers[static_cast<size_t>(t) * OUTPUT_SIZE + bin];
+        bins[t - 1] = bin;
+    }
+}
+
+void ViterbiDecoder::decode(const float *activations, const int num_frames, float *pitches)
+{
+    path.resize(std::max(num_frames, 0));
+    decode_path(activations, num_frames, path.data());
+    for (int t = 0; t < num_frames; t++)
+    {
+        pitches[t] = local_average_pitch(activations + static_cast<size_t>(t) * OUTPUT_SIZE,
+                                         path[t]);
+    }
+}
+
+OnlineViterbi::OnlineViterbi(const int lag_frames)
+    : lag_frames(std::max(lag_frames, 0)), window(this->lag_frames + 1),
+      scores(OUTPUT_SIZE), next_scores(OUTPUT_SIZE),
+      activations(static_cast<size_t>(window) * OUTPUT_SIZE),
+      backpointers(static_cast<size_t>(window) * OUTPUT_SIZE), path(window)
+{
+}
+
+bool OnlineViterbi::push(const float *activation, float &pitch, float &confidence)
+{
+    const size_t row = static_cast<size_t>(pushed % window) * OUTPUT_SIZE;
+    std::copy_n(activation, OUTPUT_SIZE, activations.data() + row);
+
+    if (pushed == 0)
+    {
+        std::fill(scores.begin(), scores.end(), 0.0f);
+        observe(activation, scores.data());
+    }
+    else
+    {
+        transition(scores.data(), next_scores.data(), backpointers.data() + row);
+        observe(activation, next_scores.data());
+        std::swap(scores, next_scores);
+    }
+    pushed++;
+
+    if (pushed - decided <= lag_frames)
+    {
+        return false;
+    }
+
+    // follow the best current path back to the oldest held frame
+    int bin = static_cast<int>(simd::argmax(scores.data(), OUTPUT_SIZE));
+    for (int64_t frame = pushed - 1; frame > decided; frame--)
+    {
+        bin += backpointers[static_cast<size_t>(frame % window) * OUTPUT_SIZE + bin];
+    }
+    decide(decided, bin, pitch, confidence);
+    decided++;
+    return true;
+}
+
+int OnlineViterbi::flush(float *pitches, float *confidences, const int max_frames)
+{
+    const int held = static_cast<int>(pushed - decided);
+    const int count = std::clamp(max_frames, 0, held);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int bin = static_cast<int>(simd::argmax(scores.data(), OUTPUT_SIZE));
+    path[held - 1] = bin;
+    for (int j = held - 1; j > 0; j--)
+    {
+        bin += backpointers[static_cast<size_t>((decided + j) % window) * OUTPUT_SIZE + bin];
+        path[j - 1] = bin;
+    }
+    for (int j = 0; j < count; j++)
+    {
+        decide(decided + j, path[j], pitches[j], confidences[j]);
+    }
+    decided += count;
+    return count;
+}
+
+void OnlineViterbi::reset()
+{
+    pushed = 0;
+    decided = 0;
+}
+
+void OnlineViterbi::decide(const int64_t frame, const int bin, float &pitch,
+                           float &confidence) const
+{
+    const float *activation = activations.data() + static_cast<size_t>(frame % window) *
+                              OUTPUT_SIZE;
+    pitch = local_average_pitch(activation, bin);
+    confidence = activation[argmax_bin(activation)];
+}
+} // namespace crepe
@@ -0,0 +1,88 @@
+#ifndef CREPE_DECODING_HPP
+#define CREPE_DECODING_HPP
+
+// Pitch decoders over the model's activation matrix, row-major [num_frames, OUTPUT_SIZE].
+// The local weighted average and the Viterbi model follow the reference CREPE implementation:
+// a weighted average of the bin cents over the strongest bin and its 4 neighbours on each side,
+// and an HMM whose transitions fall off linearly to zero at 12 bins, observing each frame's
+// strongest bin. Transitions are only evaluated inside that band, 23 per state instead of 360.
+
+#include "crepe.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace crepe
+{
+// Strongest bin of one frame's activations, the first one on ties
+int argmax_bin(const float *activation);
+
+// Cents above BASE_FREQUENCY at a (fractional) bin
+float bin_to_cents(float bin);
+
+float cents_to_frequency(float cents);
+
+// Activation-weighted average of the cents of bins [center - 4, center + 4], the centre's
+// cents when they are all zero
+float local_average_cents(const float *activation, int center);
+
+// local_average_cents in Hz, 0 when the bins are all zero
+float local_average_pitch(const float *activation, int center);
+
+// Offline banded Viterbi over a whole activation matrix. Keeps one byte of backpointer per bin
+// and frame; scratch is reused across calls.
+class ViterbiDecoder
+{
+public:
+    // Most likely bin of every frame
+    void decode_path(const float *activations, int num_frames, int *bins);
+
+    // Pitch in Hz of every frame, the local average around its bin on the path. Frames whose
+    // activations are all zero (gated) observe nothing and come out as 0.
+    void decode(const float *activations, int num_frames, float *pitches);
+
+private:
+    std::vector<int8_t> backpointers; // [num_frames, OUTPUT_SIZE], offset to the previous bin
+    std::vector<int> path;
+};
+
+// Fixed-lag Viterbi for streams: each frame's bin is decided once lag_frames more frames have
+// been seen, by backtracking from the best current state. Memory and work per frame are
+// constant; with a lag as long as the input it matches ViterbiDecoder.
+class OnlineViterbi
+{
+public:
+    explicit OnlineViterbi(int lag_frames = 16);
+
+    // Adds the next frame's activations. Once more than lag frames are held, the oldest is
+    // decided: returns true with its pitch (Hz, 0 when it observed nothing) and confidence.
+    bool push(const float *activation, float &pitch, float &confidence);
+
+    // Decides up to max_frames of the held frames on the current best path, oldest first, for
+    // the end of the input. Returns how many were written.
+    int flush(float *pitches, float *confidences, int max_frames);
+
+    void reset();
+
+    int lag() const { return lag_frames; }
+
+    int64_t frames_pushed() const { return pushed; }
+
+    int64_t frames_decided() const { return decided; }
+
+private:
+    int lag_frames;
+    int window; // lag_frames + 1 frames are kept
+    int64_t pushed = 0;
+    int64_t decided = 0;
+    std::vector<float> scores; // log score of each bin at the newest frame
+    std::vector<float> next_scores;
+    std::vector<float> activations; // [window, OUTPUT_SIZE] ring
+    std::vector<int8_t> backpointers; // [window, OUTPUT_SIZE] ring
+    std::vector<int> path; // backtracking scratch
+
+    void decide(int64_t frame, int bin, float &pitch, float &confidence) const;
+};
+} // namespace crepe
+
+#endif //CREPE_DECODING_HPP
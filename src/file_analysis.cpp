@@ -0,0 +1,384 @@
+#include "file_analysis.hpp"
+#include "blocking_queue.hpp"
+#include "decoding.hpp"
+#include "resampler.hpp"
+
+#include "miniaudio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace crepe
+{
+namespace
+{
+// RAII over ma_decoder, decoding to float at the file's own sample rate, mono unless
+// channels is 0 (every channel of the file, interleaved)
+class Decoder
+{
+public:
+    explicit Decoder(const std::string &path, const ma_uint32 channels = 1)
+    {
+        const ma_decoder_config config = ma_decoder_config_init(ma_format_f32, channels, 0);
+        if (ma_decoder_init_file(path.c_str(), &config, &decoder) != MA_SUCCESS)
+        {
+            throw std::runtime_error("Failed to initialize decoder for file: " + path);
+        }
+
+        ma_format format;
+        ma_data_source_get_data_format(decoder.pBackend, &format, &source_channels,
+                                       &source_sample_rate, nullptr, 0);
+    }
+
+    ~Decoder()
+    {
+        ma_decoder_uninit(&decoder);
+    }
+
+    Decoder(const Decoder &) = delete;
+
+    Decoder &operator=(const Decoder &) = delete;
+
+    // Reads up to count frames (count * output_channels samples), returns the frames read
+    size_t read(float *samples, const size_t count)
+    {
+        ma_uint64 frames_read = 0;
+        ma_decoder_read_pcm_frames(&decoder, samples, count, &frames_read);
+        return static_cast<size_t>(frames_read);
+    }
+
+    ma_uint32 output_channels() const
+    {
+        return decoder.outputChannels;
+    }
+
+    ma_uint32 source_channels = 0;
+    ma_uint32 source_sample_rate = 0;
+
+private:
+    ma_decoder decoder{};
+};
+
+// Decoded samples at the model's rate, in chunks of about chunk_samples. Resampling happens in
+// the same pass as decoding, with the filter delay trimmed from the front and flushed at the end
+// so the output lines up with the source timeline.
+class SampleSource
+{
+public:
+    SampleSource(Decoder &decoder, const size_t chunk_samples)
+        : decoder(decoder), chunk_samples(chunk_samples)
+    {
+        if (const int rate = static_cast<int>(decoder.source_sample_rate);
+            rate != constants::SAMPLE_RATE)
+        {
+            resampler.emplace(rate);
+            native.resize(std::max<size_t>(
+                chunk_samples * static_cast<size_t>(rate) / constants::SAMPLE_RATE, 1));
+            skip = resampler->delay();
+        }
+    }
+
+    // Largest chunk read() produces
+    size_t max_chunk() const
+    {
+        return resampler ? resampler->max_output(native.size()) : chunk_samples;
+    }
+
+    // Next chunk, empty at the end of the file
+    void read(std::vector<float> &chunk)
+    {
+        if (!resampler)
+        {
+            chunk.resize(chunk_samples);
+            chunk.resize(decoder.read(chunk.data(), chunk_samples));
+            return;
+        }
+
+        while (true)
+        {
+            size_t count = decoder.read(native.data(), native.size());
+            input_total += static_cast<int64_t>(count);
+            if (count == 0)
+            {
+                if (flushed)
+                {
+                    chunk.clear();
+                    return;
+                }
+                // zeros push the last samples out of the filter's delay line
+                flushed = true;
+                count = std::min(native.size(), (resampler->delay() + 2) * resampler->input_rate() /
+                                                constants::SAMPLE_RATE + 2);
+                std::fill_n(native.begin(), count, 0.0f);
+            }
+
+            chunk.resize(resampler->max_output(count));
+            size_t produced = resampler->process(native.data(), count, chunk.data());
+
+            const size_t trimmed = std::min(skip, produced);
+            skip -= trimmed;
+            produced -= trimmed;
+            if (flushed)
+            {
+                // nothing past the end of the source
+                const auto limit = static_cast<int64_t>(std::ceil(
+                    static_cast<double>(input_total) * constants::SAMPLE_RATE /
+                    resampler->input_rate()));
+                produced = static_cast<size_t>(
+                    std::clamp<int64_t>(limit - output_total, 0, static_cast<int64_t>(produced)));
+            }
+
+            chunk.erase(chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(trimmed));
+            chunk.resize(produced);
+            output_total += static_cast<int64_t>(produced);
+
+            if (produced > 0 || flushed)
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    Decoder &decoder;
+    size_t chunk_samples;
+    std::optional<Resampler> resampler;
+    std::vector<float> native;
+    size_t skip = 0; // filter delay still to trim from the output
+    bool flushed = false;
+    int64_t input_total = 0;
+    int64_t output_total = 0;
+};
+} // namespace
+
+FileAnalysisSummary analyze_file(const std::string &path, const ResultSink &sink,
+                                 const FileAnalysisOptions &options, Engine &engine)
+{
+    using namespace constants;
+
+    Decoder decoder(path);
+
+    FileAnalysisSummary summary;
+    summary.source_sample_rate = static_cast<int>(decoder.source_sample_rate);
+    summary.source_channels = static_cast<int>(decoder.source_channels);
+
+    const int chunk_frames = std::max(options.chunk_frames, 1);
+    const size_t chunk_samples = static_cast<size_t>(chunk_frames) * FFT_HOP;
+    const int queue_depth = std::max(options.queue_depth, 1);
+
+    // fixed pool of chunk buffers cycling reader -> filled -> inference -> free -> reader
+    BlockingQueue<std::vector<float>> filled(queue_depth);
+    BlockingQueue<std::vector<float>> free_chunks;
+    for (int i = 0; i < queue_depth + 2; i++)
+    {
+        free_chunks.push({});
+    }
+
+    SampleSource source(decoder, chunk_samples);
+
+    std::exception_ptr reader_error;
+    std::thread reader([&] {
+        try
+        {
+            while (auto chunk = free_chunks.pop())
+            {
+                source.read(*chunk);
+                if (chunk->empty() || !filled.push(std::move(*chunk)))
+                {
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            reader_error = std::current_exception();
+        }
+        filled.close();
+    });
+
+    // the unanalysed tail of the previous chunk (under one frame) followed by the new chunk
+    std::vector<float> window;
+    window.reserve(FRAME_LENGTH + source.max_chunk());
+    int64_t window_start = 0; // absolute sample index of window[0]
+    int64_t next_frame = 0;
+    int64_t total_samples = 0;
+
+    PredictionResults results;
+
+    // Viterbi runs across chunk boundaries like in CrepeStream: frames are decided
+    // viterbi_lag_frames behind the analysis, in order from the first, the rest at the end
+    std::unique_ptr<OnlineViterbi> viterbi;
+    std::vector<float> activations;
+    PredictionResults decided;
+    if (options.inference.decoder == PitchDecoder::Viterbi)
+    {
+        viterbi = std::make_unique<OnlineViterbi>(options.inference.viterbi_lag_frames);
+    }
+    const auto emit_decided = [&](const int count) {
+        const int64_t first = viterbi->frames_decided() - count;
+        for (int i = 0; i < count; i++)
+        {
+            decided.times(i) = static_cast<float>(
+                static_cast<double>((first + i) * FFT_HOP) / SAMPLE_RATE);
+            decided.voiced(i) = decided.confidences(i) >= options.inference.voicing_threshold;
+        }
+        decided.num_frames = count;
+        if (count > 0)
+        {
+            sink(decided);
+        }
+    };
+    const auto prepare_decided = [&](const int count) {
+        decided.pitches.resize(count);
+        decided.confidences.resize(count);
+        decided.times.resize(count);
+        decided.voiced.resize(count);
+    };
+
+    try
+    {
+        while (auto chunk = filled.pop())
+        {
+            window.insert(window.end(), chunk->begin(), chunk->end());
+            total_samples += static_cast<int64_t>(chunk->size());
+            free_chunks.push(std::move(*chunk));
+
+            const auto offset = static_cast<size_t>(next_frame * FFT_HOP - window_start);
+            if (window.size() >= offset + FRAME_LENGTH)
+            {
+                const int count = static_cast<int>((window.size() - offset - FRAME_LENGTH) /
+                                                   FFT_HOP) + 1;
+
+                results.pitches.resize(count);
+                results.confidences.resize(count);
+                results.times.resize(count);
+                results.voiced.resize(count);
+                results.num_frames = count;
+
+                if (viterbi)
+                {
+                    // results are only scratch for the per-frame decode here
+                    activations.resize(static_cast<size_t>(count) * OUTPUT_SIZE);
+                    engine.run_frames(window.data() + offset, count, results, 0,
+                                      activations.data(), options.inference);
+
+                    prepare_decided(count);
+                    int num_decided = 0;
+                    for (int i = 0; i < count; i++)
+                    {
+                        num_decided += viterbi->push(
+                            activations.data() + static_cast<size_t>(i) * OUTPUT_SIZE,
+                            decided.pitches(num_decided), decided.confidences(num_decided));
+                    }
+                    emit_decided(num_decided);
+                }
+                else
+                {
+                    for (int i = 0; i < count; i++)
+                    {
+                        results.times(i) = static_cast<float>(
+                            static_cast<double>((next_frame + i) * FFT_HOP) / SAMPLE_RATE);
+                    }
+                    engine.run_frames(window.data() + offset, count, results, 0,
+                                      options.inference);
+                    sink(results);
+                }
+                next_frame += count;
+            }
+
+            // carry over everything from the next frame's first sample
+            const size_t consumed = std::min(
+                static_cast<size_t>(next_frame * FFT_HOP - window_start), window.size());
+            window.erase(window.begin(), window.begin() + static_cast<std::ptrdiff_t>(consumed));
+            window_start += static_cast<int64_t>(consumed);
+        }
+
+        if (viterbi)
+        {
+            const int held = static_cast<int>(viterbi->frames_pushed() -
+                                              viterbi->frames_decided());
+            prepare_decided(held);
+            emit_decided(viterbi->flush(decided.pitches.data(), decided.confidences.data(), held));
+        }
+    }
+    catch (...)
+    {
+        free_chunks.close();
+        filled.close();
+        reader.join();
+        throw;
+    }
+
+    reader.join();
+    if (reader_error)
+    {
+        std::rethrow_exception(reader_error);
+    }
+
+    summary.num_frames = next_frame;
+    summary.duration_seconds = static_cast<double>(total_samples) / SAMPLE_RATE;
+    return summary;
+}
+
+std::vector<float> load_audio(const std::string &path, int *source_sample_rate)
+{
+    Decoder decoder(path);
+    if (source_sample_rate)
+    {
+        *source_sample_rate = static_cast<int>(decoder.source_sample_rate);
+    }
+
+    // one second per read
+    SampleSource source(decoder, constants::SAMPLE_RATE);
+    std::vector<float> audio;
+    std::vector<float> chunk;
+    for (source.read(chunk); !chunk.empty(); source.read(chunk))
+    {
+        audio.insert(audio.end(), chunk.begin(), chunk.end());
+    }
+    return audio;
+}
+
+std::vector<float> load_audio_channels(const std::string &path, int *num_channels,
+                                       int *sample_rate)
+{
+    Decoder decoder(path, 0);
+    const ma_uint32 channels = decoder.output_channels();
+    *num_channels = static_cast<int>(channels);
+    *sample_rate = static_cast<int>(decoder.source_sample_rate);
+
+    // one second per read
+    const size_t chunk_frames = decoder.source_sample_rate;
+    std::vector<float> audio;
+    size_t frames = 0;
+    while (true)
+    {
+        audio.resize((frames + chunk_frames) * channels);
+        const size_t count = decoder.read(audio.data() + frames * channels, chunk_frames);
+        frames += count;
+        if (count < chunk_frames)
+        {
+            break;
+        }
+    }
+    audio.resize(frames * channels);
+    return audio;
+}
+
+ResultSink csv_sink(std::ostream &out)
+{
+    return [&out](const PredictionResults &chunk) {
+        for (int i = 0; i < chunk.num_frames; i++)
+        {
+            out << chunk.times(i) << ',' << chunk.pitches(i) << ',' << chunk.confidences(i)
+                << ',' << (chunk.voiced(i) ? 1 : 0) << '\n';
+        }
+    };
+}
+} // namespace crepe
@@ -0,0 +1,63 @@
+#ifndef CREPE_FILE_ANALYSIS_HPP
+#define CREPE_FILE_ANALYSIS_HPP
+
+// Out-of-core analysis of audio files of any length. Decoding runs on its own thread a few
+// chunks ahead of inference, and results are handed to a sink chunk by chunk, so memory stays
+// constant however long the file is.
+
+#include "crepe.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace crepe
+{
+struct FileAnalysisOptions
+{
+    InferenceOptions inference;
+
+    // Frames analysed per chunk (1000 frames = 10 seconds)
+    int chunk_frames = 1000;
+
+    // Decoded chunks the reader may run ahead of inference
+    int queue_depth = 4;
+};
+
+// Receives consecutive result chunks; times are absolute from the start of the file.
+// The chunk is only valid during the call. With PitchDecoder::Viterbi the smoothed path runs
+// across chunks, so chunks trail the analysis by viterbi_lag_frames and the last frames arrive
+// in one more chunk at the end of the file.
+using ResultSink = std::function<void(const PredictionResults &chunk)>;
+
+struct FileAnalysisSummary
+{
+    int64_t num_frames = 0;
+    double duration_seconds = 0.0;
+    int source_sample_rate = 0;
+    int source_channels = 0;
+};
+
+// Decode, analyse and stream out any file miniaudio can read. Multichannel input is downmixed
+// to mono and other sample rates go through crepe::Resampler on the reader thread.
+// Throws std::runtime_error when the file cannot be decoded.
+FileAnalysisSummary analyze_file(const std::string &path, const ResultSink &sink,
+                                 const FileAnalysisOptions &options = {},
+                                 Engine &engine = Engine::default_engine());
+
+// Whole file decoded to mono at SAMPLE_RATE, resampled like analyze_file does.
+// Throws std::runtime_error when the file cannot be decoded.
+std::vector<float> load_audio(const std::string &path, int *source_sample_rate = nullptr);
+
+// Whole file decoded at its own sample rate with every channel kept, interleaved, for
+// crepe::run_multichannel. Throws std::runtime_error when the file cannot be decoded.
+std::vector<float> load_audio_channels(const std::string &path, int *num_channels,
+                                       int *sample_rate);
+
+// Sink writing "time,pitch,confidence,voiced" CSV rows
+ResultSink csv_sink(std::ostream &out);
+} // namespace crepe
+
+#endif //CREPE_FILE_ANALYSIS_HPP
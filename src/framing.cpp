@@ -0,0 +1,127 @@
+#include "crepe.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace crepe
+{
+namespace
+{
+// Sliding sums drift by a few ulps per update, recompute them exactly every so often
+constexpr int STATS_REFRESH_FRAMES = 32;
+
+struct WindowSums
+{
+    double sum = 0.0;
+    double sum_sq = 0.0;
+
+    void add(const float *samples, const int count, const size_t stride)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const double x = samples[i * stride];
+            sum += x;
+            sum_sq += x * x;
+        }
+    }
+
+    void remove(const float *samples, const int count, const size_t stride)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const double x = samples[i * stride];
+            sum -= x;
+            sum_sq -= x * x;
+        }
+    }
+};
+} // namespace
+
+void frame_audio(const float *audio_data, const int num_frames, const int hop, float *frames,
+                 float *rms)
+{
+    frame_audio_strided(audio_data, 1, num_frames, hop, frames, rms);
+}
+
+void frame_audio_strided(const float *audio_data, const int stride, const int num_frames,
+                         const int hop, float *frames, float *rms)
+{
+    using namespace constants;
+
+    constexpr double inv_length = 1.0 / FRAME_LENGTH;
+    const bool slide = hop < FRAME_LENGTH;
+    const auto step = static_cast<size_t>(stride);
+
+    WindowSums window;
+    for (int i = 0; i < num_frames; i++)
+    {
+        const float *frame = audio_data + static_cast<size_t>(i) * hop * step;
+
+        if (!slide || i % STATS_REFRESH_FRAMES == 0)
+        {
+            window = {};
+            window.add(frame, FRAME_LENGTH, step);
+        }
+        else
+        {
+            // the previous frame's first hop samples leave, this frame's last hop samples enter
+            window.remove(frame - hop * step, hop, step);
+            window.add(frame + (FRAME_LENGTH - hop) * step, hop, step);
+        }
+
+        // same as normalize_audio: remove dc offset, then scale to unit variance
+        const double mean = window.sum * inv_length;
+        const double variance = std::max(window.sum_sq * inv_length - mean * mean, 0.0);
+        const double std_dev = std::sqrt(variance);
+
+        if (rms)
+        {
+            rms[i] = static_cast<float>(std::sqrt(std::max(window.sum_sq * inv_length, 0.0)));
+        }
+
+        const float scale = std_dev > 1e-10 ? static_cast<float>(1.0 / std_dev) : 1.0f;
+        float *out = frames + static_cast<size_t>(i) * FRAME_LENGTH;
+        if (step == 1)
+        {
+            simd::subtract_scale(frame, out, FRAME_LENGTH, static_cast<float>(mean), scale);
+        }
+        else
+        {
+            // deinterleave while normalizing, the channel is never copied out on its own
+            const auto offset = static_cast<float>(mean);
+            for (int j = 0; j < FRAME_LENGTH; j++)
+            {
+                out[j] = (frame[j * step] - offset) * scale;
+            }
+        }
+    }
+}
+
+void frame_rms(const float *audio_data, const int num_frames, const int hop, float *rms)
+{
+    using namespace constants;
+
+    constexpr double inv_length = 1.0 / FRAME_LENGTH;
+    const bool slide = hop < FRAME_LENGTH;
+
+    WindowSums window;
+    for (int i = 0; i < num_frames; i++)
+    {
+        const float *frame = audio_data + static_cast<size_t>(i) * hop;
+
+        if (!slide || i % STATS_REFRESH_FRAMES == 0)
+        {
+            window = {};
+            window.add(frame, FRAME_LENGTH, 1);
+        }
+        else
+        {
+            window.remove(frame - hop, hop, 1);
+            window.add(frame + FRAME_LENGTH - hop, hop, 1);
+        }
+
+        rms[i] = static_cast<float>(std::sqrt(std::max(window.sum_sq * inv_length, 0.0)));
+    }
+}
+} // namespace crepe
@@ -1,20 +1,33 @@
 #include "crepe.hpp"
+#include "activation_cache.hpp"
+#include "analytics.hpp"
+#include "decoding.hpp"
+#include "mapped_file.hpp"
+#include "model_session.hpp"
+#include "native_model.hpp"
+#include "resampler.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
 
+#ifdef CREPE_WITH_ORT
 extern const unsigned char model_ort_start[];
 extern const size_t model_ort_size;
+#endif
+// the same tiny model as ONNX, for the native backend
+extern const unsigned char model_onnx_start[];
+extern const size_t model_onnx_size;
 
 namespace crepe
 {
-// precomputed constants
-namespace constants_precomputed
-{
-constexpr float PITCH_CONVERSION_FACTOR =
-    constants::MODEL_RANGE_CENTS / (constants::MODEL_BINS - 1.0f);
-constexpr float OCTAVE_FACTOR = 1.0f / constants::CENTS_CONVERSION;
-}
-
 float calculate_correlation(const Eigen::Ref<const Eigen::VectorXf> &x,
                             const Eigen::Ref<const Eigen::VectorXf> &y)
 {
@@ -39,17 +52,8 @@ float calculate_correlation(const Eigen::Ref<const Eigen::VectorXf> &x,
 
 float get_pitch_from_crepe(const float *output_data, const size_t output_size)
 {
-    using namespace constants;
-    using namespace constants_precomputed;
-
-    const Eigen::Map<const Eigen::VectorXf> output(output_data,
-                                                   static_cast<Eigen::Index>(output_size));
-    Eigen::Index max_index;
-    output.maxCoeff(&max_index);
-
-    const float cents = MODEL_BASE_CENTS + (
-                            static_cast<float>(max_index) * PITCH_CONVERSION_FACTOR);
-    return BASE_FREQUENCY * std::pow(OCTAVE_BASE, cents * OCTAVE_FACTOR);
+    const size_t max_index = simd::argmax(output_data, output_size);
+    return cents_to_frequency(bin_to_cents(static_cast<float>(max_index)));
 }
 
 void analyze_frequency_bins()
@@ -95,36 +99,69 @@ void normalize_audio(Eigen::Ref<Eigen::VectorXf> audio_vec)
     }
 }
 
-class CrepeModel
+const char *capacity_name(const Capacity capacity)
+{
+    switch (capacity)
+    {
+    case Capacity::Tiny:
+        return "tiny";
+    case Capacity::Small:
+        return "small";
+    case Capacity::Medium:
+        return "medium";
+    case Capacity::Large:
+        return "large";
+    case Capacity::Full:
+        return "full";
+    }
+    return "full";
+}
+
+#ifdef CREPE_WITH_ORT
+// One ORT session over the engine's model bytes, owned by an Engine's session pool.
+// Input and output tensors are bound to buffers owned by the session and reused for every
+// batch, so after warm-up a batch allocates nothing on our side of session.Run.
+class CrepeModel final : public ModelSession
 {
 private:
-    Ort::Env env;
+    // Tensors over the shared buffers for one batch size
+    struct BoundTensors
+    {
+        Ort::Value input{nullptr};
+        Ort::Value output{nullptr};
+    };
+
     Ort::Session session;
     Ort::AllocatorWithDefaultOptions allocator;
     std::string input_name;
     std::string output_name;
+    const char *input_names[1] = {};
+    const char *output_names[1] = {};
     Ort::MemoryInfo memory_info;
-    std::vector<int64_t> input_dims;
+    Ort::RunOptions run_options;
 
-    CrepeModel() : env(ORT_LOGGING_LEVEL_WARNING, "CREPE"),
-                   session(nullptr),
-                   memory_info(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)),
-                   input_dims({1, constants::FRAME_LENGTH})
-    {
-        Ort::SessionOptions session_options;
-        session_options.SetIntraOpNumThreads(constants::ONNX_THREADS);
-        session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
+    std::vector<float> input_buffer; // [capacity, FRAME_LENGTH]
+    std::vector<float> output_buffer; // [capacity, OUTPUT_SIZE]
+    std::vector<BoundTensors> tensors; // indexed by batch size, created on first use
 
-        session = Ort::Session(env, model_ort_start, model_ort_size, session_options);
+public:
+    // model_data must outlive the session, ORT reads the model bytes in place
+    CrepeModel(const Ort::Env &env, const unsigned char *model_data, const size_t model_size,
+               const Ort::SessionOptions &session_options)
+        : session(nullptr),
+          memory_info(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    {
+        session = Ort::Session(env, model_data, model_size, session_options);
 
         const auto input_name_ptr = session.GetInputNameAllocated(0, allocator);
         const auto output_name_ptr = session.GetOutputNameAllocated(0, allocator);
 
         input_name = input_name_ptr.get();
         output_name = output_name_ptr.get();
+        input_names[0] = input_name.c_str();
+        output_names[0] = output_name.c_str();
     }
 
-public:
     CrepeModel(const CrepeModel &) = delete;
 
     CrepeModel &operator=(const CrepeModel &) = delete;
@@ -133,106 +170,1156 @@ public:
 
     CrepeModel &operator=(CrepeModel &&) = delete;
 
-    static CrepeModel &getInstance()
+    std::string endProfiling() override
     {
-        static CrepeModel instance; // automatically destroyed
-        return instance;
+        return session.EndProfilingAllocated(allocator).get();
     }
 
-    PredictionResults runInference(const float *audio_data, int length, int sample_rate);
+    float *inputFrames(int count) override;
+
+    const float *runBatch(int count) override;
 };
 
-//CrepeModel* CrepeModel::instance = nullptr;
+float *CrepeModel::inputFrames(const int count)
+{
+    using namespace constants;
+
+    if (const auto needed = static_cast<size_t>(count) * FRAME_LENGTH;
+        input_buffer.size() < needed)
+    {
+        // bigger batch than any before, the old tensors point at the old buffers
+        input_buffer.resize(needed);
+        output_buffer.resize(static_cast<size_t>(count) * OUTPUT_SIZE);
+        tensors.clear();
+    }
+    if (static_cast<int>(tensors.size()) <= count)
+    {
+        tensors.resize(count + 1);
+    }
+
+    if (BoundTensors &bound = tensors[count]; !bound.input)
+    {
+        const std::array<int64_t, 2> input_dims = {count, FRAME_LENGTH};
+        const std::array<int64_t, 2> output_dims = {count, OUTPUT_SIZE};
+        bound.input = Ort::Value::CreateTensor<float>(
+            memory_info, input_buffer.data(), static_cast<size_t>(count) * FRAME_LENGTH,
+            input_dims.data(), input_dims.size());
+        bound.output = Ort::Value::CreateTensor<float>(
+            memory_info, output_buffer.data(), static_cast<size_t>(count) * OUTPUT_SIZE,
+            output_dims.data(), output_dims.size());
+    }
+
+    return input_buffer.data();
+}
+
+const float *CrepeModel::runBatch(const int count)
+{
+    BoundTensors &bound = tensors[count];
+
+    //  inference - outputs land in output_buffer
+    session.Run(run_options, input_names, &bound.input, 1, output_names, &bound.output, 1);
+
+    return output_buffer.data();
+}
+#endif
+
+namespace
+{
+// Whether the batches of one call get their own team of up to num_sessions threads. A call made
+// from a ThreadPool worker is already one of that many concurrent callers (batch analysis), so
+// its batches stay on the worker instead of multiplying the threads.
+bool parallel_batches(const int num_batches, const int num_sessions)
+{
+    return num_batches > 1 && num_sessions > 1 && !ThreadPool::on_worker();
+}
+
+// Decodes batch slots [first_slot, first_slot + count) of a selection of frames, where slot k is
+// frame selected[k] (frame k when selected is null), into results at first_index + frame
+void decode_batch(const float *activations, const int *selected, const int first_slot,
+                  const int count, PredictionResults &results, const int first_index,
+                  const InferenceOptions &options)
+{
+    using namespace constants;
+
+    for (int r = 0; r < count; r++)
+    {
+        const int slot = first_slot + r;
+        const int i = first_index + (selected ? selected[slot] : slot);
+        const float *activation = activations + static_cast<size_t>(r) * OUTPUT_SIZE;
+        const int bin = argmax_bin(activation);
+
+        // each frame index is written by exactly one batch, no lock needed. Viterbi needs
+        // the whole sequence, its caller replaces these pitches afterwards.
+        results.pitches(i) = options.decoder == PitchDecoder::Argmax
+                                 ? cents_to_frequency(bin_to_cents(static_cast<float>(bin)))
+                                 : local_average_pitch(activation, bin);
+        results.confidences(i) = activation[bin];
+        results.voiced(i) = results.confidences(i) >= options.voicing_threshold;
+    }
+}
+
+// Silence gate: frames below options.silence_threshold_db get no pitch and zero confidence.
+// The indices of the other frames go to audible when given.
+void gate_silent_frames(const float *audio_data, const int num_frames, PredictionResults &results,
+                        const int first_index, const InferenceOptions &options,
+                        std::vector<int> *audible)
+{
+    using namespace constants;
+
+    const float min_rms = std::pow(10.0f, options.silence_threshold_db / 20.0f);
 
-PredictionResults CrepeModel::runInference(const float *audio_data, int length, int sample_rate)
+    std::vector<float> rms(num_frames);
+    frame_rms(audio_data, num_frames, FFT_HOP, rms.data());
+
+    if (audible)
+    {
+        audible->reserve(num_frames);
+    }
+    for (int i = 0; i < num_frames; i++)
+    {
+        if (rms[i] >= min_rms)
+        {
+            if (audible)
+            {
+                audible->push_back(i);
+            }
+        }
+        else
+        {
+            results.pitches(first_index + i) = 0.0f;
+            results.confidences(first_index + i) = 0.0f;
+            results.voiced(first_index + i) = false;
+        }
+    }
+}
+
+// Frames selection slots [first_slot, first_slot + count) into frames, one frame_audio call per
+// run of consecutive frame numbers so the sliding statistics still apply within a run
+void frame_selection(const float *audio_data, const int *selected, const int first_slot,
+                     const int count, float *frames)
+{
+    using namespace constants;
+
+    int r = 0;
+    while (r < count)
+    {
+        const int frame = selected ? selected[first_slot + r] : first_slot + r;
+        int run = 1;
+        while (r + run < count && (!selected || selected[first_slot + r + run] == frame + run))
+        {
+            run++;
+        }
+
+        frame_audio(audio_data + static_cast<size_t>(frame) * FFT_HOP, run, FFT_HOP,
+                    frames + static_cast<size_t>(r) * FRAME_LENGTH);
+        r += run;
+    }
+}
+
+#ifdef CREPE_WITH_ORT
+// ORT keeps a single environment per process, share it between engines
+const Ort::Env &ort_env()
+{
+    static Ort::Env env(static_cast<OrtLoggingLevel>(constants::ONNX_LOG_LEVEL), "CREPE");
+    return env;
+}
+
+// borrow_model_bytes: the model buffer outlives every session, so ORT may use it in place
+Ort::SessionOptions make_session_options(const EngineOptions &options, const int session_index,
+                                         const bool borrow_model_bytes)
+{
+    Ort::SessionOptions session_options;
+    session_options.SetIntraOpNumThreads(options.intra_op_threads);
+    session_options.SetInterOpNumThreads(options.inter_op_threads);
+    session_options.SetExecutionMode(options.execution_mode == ExecutionMode::Parallel
+                                         ? ORT_PARALLEL
+                                         : ORT_SEQUENTIAL);
+    session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
+
+    if (borrow_model_bytes)
+    {
+        session_options.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+    }
+
+    if (!options.profile_prefix.empty())
+    {
+        // ORT appends a timestamp and .json to the prefix
+        const std::string prefix = options.profile_prefix + "_session" +
+                                   std::to_string(session_index);
+        session_options.EnableProfiling(prefix.c_str());
+    }
+
+    // ORT pins the intra-op pool's worker threads (intra_op_threads - 1 of them, the caller is
+    // the remaining one). Each session in the pool takes the next slice of the cpu list.
+    if (const int workers = options.intra_op_threads - 1;
+        workers > 0 && !options.cpu_affinity.empty())
+    {
+        std::string affinities;
+        for (int t = 0; t < workers; t++)
+        {
+            const size_t cpu = (static_cast<size_t>(session_index) * workers + t) %
+                               options.cpu_affinity.size();
+            if (t > 0)
+            {
+                affinities += ';';
+            }
+            affinities += std::to_string(options.cpu_affinity[cpu] + 1); // ORT ids are 1-based
+        }
+        session_options.AddConfigEntry("session.intra_op_thread_affinities",
+                                       affinities.c_str());
+    }
+
+    return session_options;
+}
+#endif
+
+// The model file an engine should map (.ort for ORT, .onnx for the native backend), empty for
+// the embedded model
+std::string resolve_model_path(const EngineOptions &options)
+{
+    const bool native = options.backend == Backend::Native;
+    const bool int8 = options.precision == Precision::Int8;
+#ifndef CREPE_WITH_ORT
+    if (!native)
+    {
+        throw std::invalid_argument("Built without ONNX Runtime, use Backend::Native");
+    }
+#endif
+    if (native && int8)
+    {
+        throw std::invalid_argument("The native backend only runs float models");
+    }
+
+    if (!options.model_path.empty())
+    {
+        return options.model_path;
+    }
+    if (!options.model_dir.empty())
+    {
+        return options.model_dir + "/model-" + capacity_name(options.capacity) +
+               (int8 ? "-int8" : "") + (native ? ".onnx" : ".ort");
+    }
+    if (options.capacity != Capacity::Tiny || int8)
+    {
+        throw std::invalid_argument(std::string("Only the tiny float model is embedded, set "
+                                                "model_dir to load ") +
+                                    capacity_name(options.capacity) + (int8 ? " int8" : ""));
+    }
+    return {};
+}
+} // namespace
+
+struct Engine::Impl
+{
+    EngineOptions options;
+    std::string model_path;
+    std::shared_ptr<const MappedFile> model_file; // null for the embedded model
+    const unsigned char *model_data = nullptr;
+    size_t model_size = 0;
+    std::shared_ptr<const NativeWeights> native_weights; // native backend only
+    std::unique_ptr<ActivationCache> activation_cache; // when options.activation_cache_dir is set
+
+    std::vector<std::unique_ptr<ModelSession>> sessions; // created so far
+    std::vector<ModelSession *> idle;
+    int reserved = 0; // sessions created or being created
+    std::mutex mutex;
+    std::condition_variable session_available;
+
+    explicit Impl(const EngineOptions &engine_options)
+        : options(engine_options), model_path(resolve_model_path(engine_options))
+    {
+        options.num_sessions = std::max(options.num_sessions, 1);
+        options.intra_op_threads = std::max(options.intra_op_threads, 1);
+        options.inter_op_threads = std::max(options.inter_op_threads, 1);
+
+        const bool native = options.backend == Backend::Native;
+        if (!model_path.empty())
+        {
+            // mapped up front so a bad path fails here, sessions are created on first use
+            model_file = MappedFile::open_shared(model_path);
+            model_data = model_file->data();
+            model_size = model_file->size();
+        }
+        else if (native)
+        {
+            model_data = model_onnx_start;
+            model_size = model_onnx_size;
+        }
+#ifdef CREPE_WITH_ORT
+        else
+        {
+            model_data = model_ort_start;
+            model_size = model_ort_size;
+        }
+#endif
+
+        if (native)
+        {
+            // the weights are unpacked once and shared by every session
+            native_weights = NativeWeights::from_onnx(model_data, model_size);
+        }
+
+        if (!options.activation_cache_dir.empty())
+        {
+            activation_cache = std::make_unique<ActivationCache>(
+                options.activation_cache_dir, model_data, model_size, native ? "native" : "ort");
+        }
+    }
+
+    std::unique_ptr<ModelSession> create_session(const int index) const
+    {
+        if (options.backend == Backend::Native)
+        {
+            return std::make_unique<NativeModel>(native_weights, options.intra_op_threads);
+        }
+#ifdef CREPE_WITH_ORT
+        const bool mapped = model_file != nullptr;
+        return std::make_unique<CrepeModel>(ort_env(), model_data, model_size,
+                                            make_session_options(options, index, mapped));
+#else
+        static_cast<void>(index);
+        throw std::logic_error("No ONNX Runtime in this build");
+#endif
+    }
+
+    // Run the model over a selection of the frames in audio_data (see decode_batch). The
+    // activations of frame f also go to row f of frame_activations when given.
+    void run_selected(const float *audio_data, const int *selected, int num_selected,
+                      PredictionResults &results, int first_index,
+                      const InferenceOptions &options, float *frame_activations = nullptr);
+
+    // Every frame of a whole buffer through the activation cache: decoded from the cached
+    // entry when there is one, otherwise run and stored
+    void run_cached(const float *audio_data, int length, int num_frames,
+                    PredictionResults &results, const InferenceOptions &options);
+
+    // Coarse-to-fine schedule over all frames, or only the audible ones when gated
+    void run_adaptive(const float *audio_data, int num_frames, const std::vector<int> *audible,
+                      PredictionResults &results, int first_index,
+                      const InferenceOptions &options);
+
+    // Exclusive use of one pooled session for the lifetime of the lease. Takes an idle session,
+    // creates one while the pool is below num_sessions, and waits otherwise.
+    class SessionLease
+    {
+    public:
+        explicit SessionLease(Impl &impl) : impl(impl)
+        {
+            std::unique_lock lock(impl.mutex);
+            impl.session_available.wait(lock, [&] {
+                return !impl.idle.empty() || impl.reserved < impl.options.num_sessions;
+            });
+            if (!impl.idle.empty())
+            {
+                model = impl.idle.back();
+                impl.idle.pop_back();
+                return;
+            }
+
+            // session creation takes a while, other callers can use the pool meanwhile
+            const int index = impl.reserved++;
+            lock.unlock();
+            std::unique_ptr<ModelSession> created;
+            try
+            {
+                created = impl.create_session(index);
+            }
+            catch (...)
+            {
+                lock.lock();
+                impl.reserved--;
+                lock.unlock();
+                impl.session_available.notify_one();
+                throw;
+            }
+            model = created.get();
+            lock.lock();
+            impl.sessions.push_back(std::move(created));
+        }
+
+        ~SessionLease()
+        {
+            {
+                std::lock_guard lock(impl.mutex);
+                impl.idle.push_back(model);
+            }
+            impl.session_available.notify_one();
+        }
+
+        SessionLease(const SessionLease &) = delete;
+
+        SessionLease &operator=(const SessionLease &) = delete;
+
+        ModelSession *operator->() const { return model; }
+
+    private:
+        Impl &impl;
+        ModelSession *model;
+    };
+};
+
+void Engine::Impl::run_selected(const float *audio_data, const int *selected,
+                                const int num_selected, PredictionResults &results,
+                                const int first_index, const InferenceOptions &options,
+                                float *frame_activations)
+{
+    using namespace constants;
+
+    const int batch_size = std::clamp(options.batch_size, 1, std::max(num_selected, 1));
+    const int num_batches = (num_selected + batch_size - 1) / batch_size;
+
+    // process each batch in parallel, one pooled session per worker
+#pragma omp parallel for num_threads(this->options.num_sessions) \
+    if(parallel_batches(num_batches, this->options.num_sessions))
+    for (int b = 0; b < num_batches; b++)
+    {
+        const int first_slot = b * batch_size;
+        const int count = std::min(batch_size, num_selected - first_slot); // ragged last batch
+
+        const SessionLease model(*this);
+
+        // frame straight into the session's bound input tensor
+        {
+            const stats::ScopedTimer timer(stats::Stage::Preprocess);
+            frame_selection(audio_data, selected, first_slot, count, model->inputFrames(count));
+        }
+
+        const float *activations;
+        {
+            const stats::ScopedTimer timer(stats::Stage::ModelRun);
+            activations = model->runBatch(count);
+        }
+        stats::record_batch(count);
+
+        const stats::ScopedTimer timer(stats::Stage::Decode);
+        decode_batch(activations, selected, first_slot, count, results, first_index, options);
+        for (int r = 0; frame_activations && r < count; r++)
+        {
+            const int frame = selected ? selected[first_slot + r] : first_slot + r;
+            std::copy_n(activations + static_cast<size_t>(r) * OUTPUT_SIZE, OUTPUT_SIZE,
+                        frame_activations + static_cast<size_t>(frame) * OUTPUT_SIZE);
+        }
+    }
+}
+
+void Engine::Impl::run_cached(const float *audio_data, const int length, const int num_frames,
+                              PredictionResults &results, const InferenceOptions &options)
+{
+    using namespace constants;
+
+    const std::string path = activation_cache->entry_path(audio_data, length);
+    const int batch_size = std::clamp(options.batch_size, 1, std::max(num_frames, 1));
+    const int num_batches = (num_frames + batch_size - 1) / batch_size;
+
+    // Viterbi decodes the whole sequence at the end
+    const bool viterbi = options.decoder == PitchDecoder::Viterbi;
+    std::vector<float> sequence(viterbi ? static_cast<size_t>(num_frames) * OUTPUT_SIZE : 0);
+
+    if (const auto entry = ActivationCache::Entry::open(path, num_frames))
+    {
+        // straight to decoding
+        const stats::ScopedTimer timer(stats::Stage::Decode);
+        if (viterbi)
+        {
+            entry->read(0, num_frames, sequence.data());
+            decode_batch(sequence.data(), nullptr, 0, num_frames, results, 0, options);
+        }
+        else
+        {
+            std::vector<float> activations(static_cast<size_t>(batch_size) * OUTPUT_SIZE);
+            for (int first = 0; first < num_frames; first += batch_size)
+            {
+                const int count = std::min(batch_size, num_frames - first);
+                entry->read(first, count, activations.data());
+                decode_batch(activations.data(), nullptr, first, count, results, 0, options);
+            }
+        }
+    }
+    else
+    {
+        ActivationCache::Writer writer(path, num_frames);
+
+        // run_selected over every frame, each batch's activations also go to the entry
+#pragma omp parallel for num_threads(this->options.num_sessions) \
+    if(parallel_batches(num_batches, this->options.num_sessions))
+        for (int b = 0; b < num_batches; b++)
+        {
+            const int first = b * batch_size;
+            const int count = std::min(batch_size, num_frames - first); // ragged last batch
+
+            const SessionLease model(*this);
+
+            {
+                const stats::ScopedTimer timer(stats::Stage::Preprocess);
+                frame_audio(audio_data + static_cast<size_t>(first) * FFT_HOP, count, FFT_HOP,
+                            model->inputFrames(count));
+            }
+
+            const float *activations;
+            {
+                const stats::ScopedTimer timer(stats::Stage::ModelRun);
+                activations = model->runBatch(count);
+            }
+            stats::record_batch(count);
+
+            writer.write(first, count, activations);
+            if (viterbi)
+            {
+                std::copy_n(activations, static_cast<size_t>(count) * OUTPUT_SIZE,
+                            sequence.data() + static_cast<size_t>(first) * OUTPUT_SIZE);
+            }
+
+            const stats::ScopedTimer timer(stats::Stage::Decode);
+            decode_batch(activations, nullptr, first, count, results, 0, options);
+        }
+
+        writer.commit();
+    }
+
+    // the gate only changes decoding here, the entry always holds every frame
+    std::vector<int> audible;
+    const bool gated = std::isfinite(options.silence_threshold_db);
+    if (gated)
+    {
+        gate_silent_frames(audio_data, num_frames, results, 0, options,
+                           viterbi ? &audible : nullptr);
+    }
+
+    if (viterbi)
+    {
+        const stats::ScopedTimer timer(stats::Stage::Decode);
+        if (gated)
+        {
+            // gated frames observe nothing, as they do without the cache
+            std::vector<char> keep(num_frames, 0);
+            for (const int i : audible)
+            {
+                keep[i] = 1;
+            }
+            for (int i = 0; i < num_frames; i++)
+            {
+                if (!keep[i])
+                {
+                    std::fill_n(sequence.data() + static_cast<size_t>(i) * OUTPUT_SIZE,
+                                OUTPUT_SIZE, 0.0f);
+                }
+            }
+        }
+        ViterbiDecoder().decode(sequence.data(), num_frames, results.pitches.data());
+    }
+}
+
+void Engine::Impl::run_adaptive(const float *audio_data, const int num_frames,
+                                const std::vector<int> *audible, PredictionResults &results,
+                                const int first_index, const InferenceOptions &options)
+{
+    using namespace constants;
+
+    if (num_frames == 0)
+    {
+        return;
+    }
+
+    const int hop = options.coarse_hop_frames;
+
+    // frames the model may see
+    std::vector<char> allowed(num_frames, audible ? 0 : 1);
+    if (audible)
+    {
+        for (const int i : *audible)
+        {
+            allowed[i] = 1;
+        }
+    }
+
+    // coarse pass: every hop-th frame plus the last one, so the grid cells cover every frame
+    std::vector<int> coarse;
+    for (int i = 0; i < num_frames; i += hop)
+    {
+        if (allowed[i])
+        {
+            coarse.push_back(i);
+        }
+    }
+    if ((num_frames - 1) % hop != 0 && allowed[num_frames - 1])
+    {
+        coarse.push_back(num_frames - 1);
+    }
+    run_selected(audio_data, coarse.data(), static_cast<int>(coarse.size()), results, first_index,
+                 options);
+
+    const auto cents = [&](const int frame) {
+        return CENTS_CONVERSION * std::log2(results.pitches(first_index + frame) / BASE_FREQUENCY);
+    };
+
+    // fine pass only inside cells whose ends disagree, or that are partly gated
+    std::vector<int> refine;
+    std::vector<int> steady; // first frame of each cell filled by interpolation
+    for (int a = 0; a < num_frames - 1; a += hop)
+    {
+        const int b = std::min(a + hop, num_frames - 1);
+
+        bool interpolate = allowed[a] && allowed[b];
+        for (int i = a + 1; interpolate && i < b; i++)
+        {
+            interpolate = allowed[i];
+        }
+        if (interpolate)
+        {
+            interpolate = results.voiced(first_index + a) == results.voiced(first_index + b) &&
+                          std::abs(cents(a) - cents(b)) <= options.refine_cents_threshold;
+        }
+
+        if (interpolate)
+        {
+            steady.push_back(a);
+            continue;
+        }
+        for (int i = a + 1; i < b; i++)
+        {
+            if (allowed[i])
+            {
+                refine.push_back(i);
+            }
+        }
+    }
+    run_selected(audio_data, refine.data(), static_cast<int>(refine.size()), results, first_index,
+                 options);
+
+    // steady cells: pitch linear in cents, confidence linear
+    for (const int a : steady)
+    {
+        const int b = std::min(a + hop, num_frames - 1);
+        const float cents_a = cents(a);
+        const float cents_b = cents(b);
+        const float confidence_a = results.confidences(first_index + a);
+        const float confidence_b = results.confidences(first_index + b);
+
+        for (int i = a + 1; i < b; i++)
+        {
+            const float t = static_cast<float>(i - a) / static_cast<float>(b - a);
+            const float frame_cents = cents_a + t * (cents_b - cents_a);
+            results.pitches(first_index + i) =
+                BASE_FREQUENCY * std::pow(OCTAVE_BASE, frame_cents / CENTS_CONVERSION);
+            results.confidences(first_index + i) = confidence_a + t * (confidence_b - confidence_a);
+            results.voiced(first_index + i) = results.voiced(first_index + a);
+        }
+    }
+}
+
+Engine::Engine(const EngineOptions &options) : impl(std::make_unique<Impl>(options))
+{
+}
+
+Engine::~Engine() = default;
+
+Engine &Engine::default_engine()
+{
+    static Engine instance; // automatically destroyed
+    return instance;
+}
+
+std::vector<std::string> Engine::end_profiling()
+{
+    std::vector<std::string> trace_files;
+    if (impl->options.profile_prefix.empty())
+    {
+        return trace_files;
+    }
+
+    // wait until every session created so far is idle, so no batch is still running
+    std::unique_lock lock(impl->mutex);
+    impl->session_available.wait(lock, [&] {
+        return impl->reserved == static_cast<int>(impl->sessions.size()) &&
+               impl->idle.size() == impl->sessions.size();
+    });
+    for (const auto &session : impl->sessions)
+    {
+        trace_files.push_back(session->endProfiling());
+    }
+    return trace_files;
+}
+
+const EngineOptions &Engine::options() const
+{
+    return impl->options;
+}
+
+const std::string &Engine::model_path() const
+{
+    return impl->model_path;
+}
+
+void Engine::run_frames(const float *audio_data, const int num_frames, PredictionResults &results,
+                        const int first_index, const InferenceOptions &options)
+{
+    using namespace constants;
+
+    if (options.decoder == PitchDecoder::Viterbi)
+    {
+        // the path needs every frame's activations at once
+        std::vector<float> activations(static_cast<size_t>(num_frames) * OUTPUT_SIZE);
+        run_frames(audio_data, num_frames, results, first_index, activations.data(), options);
+
+        const stats::ScopedTimer timer(stats::Stage::Decode);
+        ViterbiDecoder().decode(activations.data(), num_frames,
+                                results.pitches.data() + first_index);
+        return;
+    }
+
+    const bool gated = std::isfinite(options.silence_threshold_db);
+    std::vector<int> audible;
+
+    if (gated)
+    {
+        // silence gate: frames below the threshold never reach the model
+        gate_silent_frames(audio_data, num_frames, results, first_index, options, &audible);
+    }
+
+    if (options.coarse_hop_frames > 1)
+    {
+        impl->run_adaptive(audio_data, num_frames, gated ? &audible : nullptr, results,
+                           first_index, options);
+    }
+    else if (gated)
+    {
+        impl->run_selected(audio_data, audible.data(), static_cast<int>(audible.size()),
+                           results, first_index, options);
+    }
+    else
+    {
+        impl->run_selected(audio_data, nullptr, num_frames, results, first_index, options);
+    }
+}
+
+void Engine::run_frames(const float *audio_data, const int num_frames, PredictionResults &results,
+                        const int first_index, float *activations,
+                        const InferenceOptions &options)
+{
+    using namespace constants;
+
+    if (!std::isfinite(options.silence_threshold_db))
+    {
+        impl->run_selected(audio_data, nullptr, num_frames, results, first_index, options,
+                           activations);
+        return;
+    }
+
+    // gated frames keep zero rows
+    std::vector<int> audible;
+    gate_silent_frames(audio_data, num_frames, results, first_index, options, &audible);
+    std::fill_n(activations, static_cast<size_t>(num_frames) * OUTPUT_SIZE, 0.0f);
+    impl->run_selected(audio_data, audible.data(), static_cast<int>(audible.size()), results,
+                       first_index, options, activations);
+}
+
+void Engine::run_packed(const FrameSpan *spans, const int num_spans,
+                        const InferenceOptions &options)
+{
+    using namespace constants;
+
+    int remaining = 0;
+    for (int s = 0; s < num_spans; s++)
+    {
+        remaining += spans[s].num_frames;
+    }
+    const int batch_size = std::clamp(options.batch_size, 1, std::max(remaining, 1));
+
+    // position of the next frame to analyse
+    int span = 0;
+    int offset = 0;
+
+    // calls piece(span, offset, row, count) for each span piece in the next count frames,
+    // advancing the position
+    const auto for_each_piece = [&](const int count, const auto &piece) {
+        for (int row = 0; row < count;)
+        {
+            const FrameSpan &current = spans[span];
+            if (const int n = std::min(current.num_frames - offset, count - row); n > 0)
+            {
+                piece(current, offset, row, n);
+                row += n;
+                offset += n;
+            }
+            if (offset == current.num_frames)
+            {
+                span++;
+                offset = 0;
+            }
+        }
+    };
+
+    while (remaining > 0)
+    {
+        const int count = std::min(batch_size, remaining);
+        const int batch_span = span;
+        const int batch_offset = offset;
+
+        const Impl::SessionLease model(*impl);
+
+        {
+            const stats::ScopedTimer timer(stats::Stage::Preprocess);
+            float *frames = model->inputFrames(count);
+            for_each_piece(count, [&](const FrameSpan &piece, const int first, const int row,
+                                      const int n) {
+                frame_audio(piece.audio_data + static_cast<size_t>(first) * FFT_HOP, n, FFT_HOP,
+                            frames + static_cast<size_t>(row) * FRAME_LENGTH);
+            });
+        }
+
+        const float *activations;
+        {
+            const stats::ScopedTimer timer(stats::Stage::ModelRun);
+            activations = model->runBatch(count);
+        }
+        stats::record_batch(count);
+
+        // walk the same pieces again for decoding
+        span = batch_span;
+        offset = batch_offset;
+        const stats::ScopedTimer timer(stats::Stage::Decode);
+        for_each_piece(count, [&](const FrameSpan &piece, const int first, const int row,
+                                  const int n) {
+            decode_batch(activations + static_cast<size_t>(row) * OUTPUT_SIZE, nullptr, first, n,
+                         *piece.results, piece.first_index, options);
+        });
+
+        remaining -= count;
+    }
+}
+
+PredictionResults Engine::run_cascade(Engine &screen, const float *audio_data, const int length,
+                                     const int sample_rate, const CascadeOptions &options,
+                                     CascadeSummary *summary)
 {
     using namespace constants;
 
     if (sample_rate != SAMPLE_RATE)
     {
-        std::cout << "Warning: CREPE expects " << SAMPLE_RATE << "Hz audio, got "
-            << sample_rate << "Hz" << std::endl;
+        // resampled once for both passes
+        const std::vector<float> resampled = resample(audio_data, static_cast<size_t>(length),
+                                                      sample_rate);
+        return run_cascade(screen, resampled.data(), static_cast<int>(resampled.size()),
+                           SAMPLE_RATE, options, summary);
     }
 
-    Eigen::Map<const Eigen::VectorXf> audio_eigen(audio_data, length);
+    PredictionResults results = screen.run(audio_data, length, SAMPLE_RATE, options.inference);
+    const int num_frames = results.num_frames;
+    const std::vector<float> screen_pitches(results.pitches.data(),
+                                            results.pitches.data() + num_frames);
+    const auto cents = [](const float pitch) {
+        return CENTS_CONVERSION * std::log2(pitch / BASE_FREQUENCY);
+    };
+
+    // decided on the screen alone, so the full model sees every escalated frame in one pass
+    CascadeSummary counts;
+    counts.num_frames = num_frames;
+    std::vector<int> escalated;
+    std::vector<int> anchor(num_frames, -1); // for the frames kept, the last escalated one
+    int last = -1;
+    for (int i = 0; i < num_frames; i++)
+    {
+        const float confidence = results.confidences(i);
+        if (confidence < options.ambiguous_low)
+        {
+            continue;
+        }
 
-    const int num_frames = (length - FRAME_LENGTH) / FFT_HOP + 1;
+        bool escalate = true;
+        if (confidence < options.ambiguous_high)
+        {
+            counts.ambiguous++;
+        }
+        else if (last < 0 || (options.refresh_frames > 0 && i - last > options.refresh_frames))
+        {
+            counts.refreshed++;
+        }
+        else if (std::abs(cents(screen_pitches[i]) - cents(screen_pitches[last])) >
+                 options.pitch_change_cents)
+        {
+            counts.pitch_changed++;
+        }
+        else
+        {
+            escalate = false;
+            anchor[i] = last;
+        }
 
-    PredictionResults results;
-    results.pitches.resize(num_frames);
-    results.confidences.resize(num_frames);
-    results.times.resize(num_frames);
-    results.num_frames = num_frames;
+        if (escalate)
+        {
+            escalated.push_back(i);
+            last = i;
+        }
+    }
+    counts.escalated = static_cast<int>(escalated.size());
 
-    Eigen::VectorXf frame(FRAME_LENGTH);
+    impl->run_selected(audio_data, escalated.data(), counts.escalated, results, 0,
+                       options.inference);
 
-    // process each frame in parallel
-#pragma omp parallel for if(num_frames > 16) private(frame)
+    // kept frames follow the screen's pitch relative to their anchor's full estimate
     for (int i = 0; i < num_frames; i++)
     {
-        const size_t start_idx = i * FFT_HOP;
+        if (const int a = anchor[i]; a >= 0)
+        {
+            results.pitches(i) = results.pitches(a) * (screen_pitches[i] / screen_pitches[a]);
+        }
+    }
 
-        frame = audio_eigen.segment(static_cast<Eigen::Index>(start_idx), FRAME_LENGTH);
-        normalize_audio(frame); // Normalize
+    if (summary)
+    {
+        *summary = counts;
+    }
+    return results;
+}
 
-        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-            memory_info, frame.data(), FRAME_LENGTH,
-            input_dims.data(), input_dims.size());
+void Engine::run_multichannel(const float *audio_data, const int length, const int num_channels,
+                              const ChannelLayout layout, const int sample_rate,
+                              std::vector<PredictionResults> &results,
+                              const InferenceOptions &options)
+{
+    using namespace constants;
+
+    const bool interleaved = layout == ChannelLayout::Interleaved;
+
+    if (sample_rate != SAMPLE_RATE)
+    {
+        // the resampler needs each channel contiguous, so resample into a planar buffer
+        std::vector<float> channel(interleaved ? length : 0);
+        std::vector<float> planar;
+        size_t resampled_length = 0;
+        for (int c = 0; c < num_channels; c++)
+        {
+            const float *source = audio_data + static_cast<size_t>(c) * length;
+            if (interleaved)
+            {
+                for (int t = 0; t < length; t++)
+                {
+                    channel[t] = audio_data[static_cast<size_t>(t) * num_channels + c];
+                }
+                source = channel.data();
+            }
+
+            const std::vector<float> resampled = resample(source, static_cast<size_t>(length),
+                                                          sample_rate);
+            if (c == 0)
+            {
+                resampled_length = resampled.size();
+                planar.resize(resampled_length * num_channels);
+            }
+            std::copy_n(resampled.data(), resampled_length,
+                        planar.data() + static_cast<size_t>(c) * resampled_length);
+        }
+        run_multichannel(planar.data(), static_cast<int>(resampled_length), num_channels,
+                         ChannelLayout::Planar, SAMPLE_RATE, results, options);
+        return;
+    }
+
+    const int num_frames = length < FRAME_LENGTH ? 0 : (length - FRAME_LENGTH) / FFT_HOP + 1;
+
+    // no-ops when results already has the right size
+    results.resize(num_channels);
+    for (PredictionResults &channel : results)
+    {
+        channel.pitches.resize(num_frames);
+        channel.confidences.resize(num_frames);
+        channel.times.resize(num_frames);
+        channel.voiced.resize(num_frames);
+        channel.num_frames = num_frames;
+        for (int i = 0; i < num_frames; i++)
+        {
+            channel.times(i) = static_cast<float>(i * FFT_HOP) / static_cast<float>(SAMPLE_RATE);
+        }
+    }
 
-        //  inference -  use array of pointers for input/output names
-        const char *input_names[] = {input_name.c_str()};
-        const char *output_names[] = {output_name.c_str()};
-        std::vector<Ort::Value> output_tensors = session.Run(
-            Ort::RunOptions{}, input_names, &input_tensor, 1, output_names, 1);
+    // channel c starts at audio_data + c * channel_offset, its samples are stride apart
+    const size_t channel_offset = interleaved ? 1 : static_cast<size_t>(length);
+    const int stride = interleaved ? num_channels : 1;
 
-        // results
-        const auto *output_data = output_tensors[0].GetTensorMutableData<float>();
-        const size_t output_size = output_tensors[0].GetTensorTypeAndShapeInfo().GetElementCount();
+    // frames are numbered channel by channel, a batch may cover the end of one channel and the
+    // start of the next
+    const int total = num_frames * num_channels;
+    const int batch_size = std::clamp(options.batch_size, 1, std::max(total, 1));
+    const int num_batches = (total + batch_size - 1) / batch_size;
 
-        // pitch
-        const float pitch = get_pitch_from_crepe(output_data, output_size);
+    // calls piece(channel, first frame, row, count) for each channel's run in a batch
+    const auto for_each_piece = [num_frames](const int first, const int count,
+                                             const auto &piece) {
+        for (int row = 0; row < count;)
+        {
+            const int channel = (first + row) / num_frames;
+            const int frame = (first + row) % num_frames;
+            const int n = std::min(num_frames - frame, count - row);
+            piece(channel, frame, row, n);
+            row += n;
+        }
+    };
+
+#pragma omp parallel for num_threads(impl->options.num_sessions) \
+    if(parallel_batches(num_batches, impl->options.num_sessions))
+    for (int b = 0; b < num_batches; b++)
+    {
+        const int first = b * batch_size;
+        const int count = std::min(batch_size, total - first); // ragged last batch
 
-        // Map the output to Eigen
-        Eigen::Map<const Eigen::VectorXf> output_eigen(output_data,
-                                                       static_cast<Eigen::Index>(output_size));
-        int max_index;
-        const float confidence = output_eigen.maxCoeff(&max_index);
+        const Impl::SessionLease model(*impl);
 
-        // Store results
-#pragma omp critical // prevent race
         {
-            results.pitches(i) = pitch;
-            results.confidences(i) = confidence;
-            results.times(i) = static_cast<float>(start_idx) / static_cast<float>(sample_rate);
+            const stats::ScopedTimer timer(stats::Stage::Preprocess);
+            float *frames = model->inputFrames(count);
+            for_each_piece(first, count, [&](const int channel, const int frame, const int row,
+                                             const int n) {
+                const float *start = audio_data + channel * channel_offset +
+                                     static_cast<size_t>(frame) * FFT_HOP * stride;
+                frame_audio_strided(start, stride, n, FFT_HOP,
+                                    frames + static_cast<size_t>(row) * FRAME_LENGTH);
+            });
         }
+
+        const float *activations;
+        {
+            const stats::ScopedTimer timer(stats::Stage::ModelRun);
+            activations = model->runBatch(count);
+        }
+        stats::record_batch(count);
+
+        // channels only share a results vector with themselves, frames are written once
+        const stats::ScopedTimer timer(stats::Stage::Decode);
+        for_each_piece(first, count, [&](const int channel, const int frame, const int row,
+                                         const int n) {
+            decode_batch(activations + static_cast<size_t>(row) * OUTPUT_SIZE, nullptr, frame, n,
+                         results[channel], 0, options);
+        });
     }
+}
 
+std::vector<PredictionResults> Engine::run_multichannel(const float *audio_data, const int length,
+                                                        const int num_channels,
+                                                        const ChannelLayout layout,
+                                                        const int sample_rate,
+                                                        const InferenceOptions &options)
+{
+    std::vector<PredictionResults> results;
+    run_multichannel(audio_data, length, num_channels, layout, sample_rate, results, options);
     return results;
 }
 
-PredictionResults run_inference(const std::vector<float> &audio_data, const int sample_rate)
+void Engine::infer(const float *frames, const int num_frames, float *activations,
+                   const InferenceOptions &options)
 {
-    return run_inference(audio_data.data(), static_cast<int>(audio_data.size()), sample_rate);
+    using namespace constants;
+
+    const int batch_size = std::clamp(options.batch_size, 1, std::max(num_frames, 1));
+    const int num_batches = (num_frames + batch_size - 1) / batch_size;
+
+#pragma omp parallel for num_threads(impl->options.num_sessions) \
+    if(parallel_batches(num_batches, impl->options.num_sessions))
+    for (int b = 0; b < num_batches; b++)
+    {
+        const int first_frame = b * batch_size;
+        const int count = std::min(batch_size, num_frames - first_frame); // ragged last batch
+
+        const Impl::SessionLease model(*impl);
+
+        std::copy_n(frames + static_cast<size_t>(first_frame) * FRAME_LENGTH,
+                    static_cast<size_t>(count) * FRAME_LENGTH, model->inputFrames(count));
+
+        const float *output;
+        {
+            const stats::ScopedTimer timer(stats::Stage::ModelRun);
+            output = model->runBatch(count);
+        }
+        stats::record_batch(count);
+
+        std::copy_n(output, static_cast<size_t>(count) * OUTPUT_SIZE,
+                    activations + static_cast<size_t>(first_frame) * OUTPUT_SIZE);
+    }
 }
 
-PredictionResults run_inference(const float *audio_data, const int length, const int sample_rate)
+void Engine::run(const float *audio_data, const int length, const int sample_rate,
+                 PredictionResults &results, const InferenceOptions &options)
 {
-    return CrepeModel::getInstance().runInference(audio_data, length, sample_rate);
+    using namespace constants;
+
+    if (sample_rate != SAMPLE_RATE)
+    {
+        // the model only understands SAMPLE_RATE audio
+        const std::vector<float> resampled = resample(audio_data, static_cast<size_t>(length),
+                                                      sample_rate);
+        run(resampled.data(), static_cast<int>(resampled.size()), SAMPLE_RATE, results, options);
+        return;
+    }
+
+    const int num_frames = length < FRAME_LENGTH ? 0 : (length - FRAME_LENGTH) / FFT_HOP + 1;
+
+    // no-ops when results already has the right size
+    results.pitches.resize(num_frames);
+    results.confidences.resize(num_frames);
+    results.times.resize(num_frames);
+    results.voiced.resize(num_frames);
+    results.num_frames = num_frames;
+
+    for (int i = 0; i < num_frames; i++)
+    {
+        results.times(i) = static_cast<float>(i * FFT_HOP) / static_cast<float>(SAMPLE_RATE);
+    }
+
+    if (impl->activation_cache)
+    {
+        impl->run_cached(audio_data, length, num_frames, results, options);
+        return;
+    }
+    run_frames(audio_data, num_frames, results, 0, options);
 }
 
-PredictionAnalytics calculate_analytics(const PredictionResults &results)
+PredictionResults Engine::run(const float *audio_data, const int length, const int sample_rate,
+                              const InferenceOptions &options)
 {
-    PredictionAnalytics analytics;
-    analytics.source_data = &results;
+    PredictionResults results;
+    run(audio_data, length, sample_rate, results, options);
+    return results;
+}
 
-    //basic statistics
-    analytics.mean_confidence = results.confidences.mean();
-    analytics.min_frequency = results.pitches.minCoeff();
-    analytics.max_frequency = results.pitches.maxCoeff();
+PredictionResults Engine::run(const std::vector<float> &audio_data, const int sample_rate,
+                              const InferenceOptions &options)
+{
+    return run(audio_data.data(), static_cast<int>(audio_data.size()), sample_rate, options);
+}
 
-    // Ccorrelation between time and pitch
-    analytics.time_pitch_correlation = calculate_correlation(results.times, results.pitches);
+PredictionResults run_inference(const std::vector<float> &audio_data, const int sample_rate,
+                                const InferenceOptions &options)
+{
+    return Engine::default_engine().run(audio_data, sample_rate, options);
+}
 
+PredictionResults run_inference(const float *audio_data, const int length, const int sample_rate,
+                                const InferenceOptions &options)
+{
+    return Engine::default_engine().run(audio_data, length, sample_rate, options);
+}
+
+std::vector<PredictionResults> run_multichannel(const float *audio_data, const int length,
+                                                const int num_channels, const ChannelLayout layout,
+                                                const int sample_rate,
+                                                const InferenceOptions &options)
+{
+    return Engine::default_engine().run_multichannel(audio_data, length, num_channels, layout,
+                                                     sample_rate, options);
+}
+
+void run_frames(const float *audio_data, const int num_frames, PredictionResults &results,
+                const int first_index, const InferenceOptions &options)
+{
+    Engine::default_engine().run_frames(audio_data, num_frames, results, first_index, options);
+}
+
+PredictionAnalytics calculate_analytics(const PredictionResults &results)
+{
+    // one pass over the track, the same statistics live and out-of-core analysis keep
+    OnlineAnalytics online;
+    online.push(results);
+
+    PredictionAnalytics analytics = online.summary();
+    analytics.source_data = &results;
     return analytics;
 }
 } // namespace crepe
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "mapped_file.hpp"
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CREPE_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace crepe
+{
+MappedFile::MappedFile(const std::string &path) : file_path(path)
+{
+#ifdef CREPE_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat file: " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+
+    if (length > 0)
+    {
+        void *mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        bytes = static_cast<const unsigned char *>(mapping);
+    }
+    ::close(fd); // the mapping keeps its own reference
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    bytes = fallback.data();
+    length = fallback.size();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef CREPE_HAVE_MMAP
+    if (bytes)
+    {
+        ::munmap(const_cast<unsigned char *>(bytes), length);
+    }
+#endif
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open_shared(const std::string &path)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const MappedFile>> cache;
+
+    std::lock_guard lock(mutex);
+    auto &entry = cache[path];
+    auto file = entry.lock();
+    if (!file)
+    {
+        file = std::make_shared<const MappedFile>(path);
+        entry = file;
+    }
+    return file;
+}
+} // namespace crepe
@@ -0,0 +1,43 @@
+#ifndef CREPE_MAPPED_FILE_HPP
+#define CREPE_MAPPED_FILE_HPP
+
+// Internal read-only view of a whole file. Memory-mapped where the platform has mmap, so pages
+// are only read in when touched and are shared between processes; read into memory elsewhere.
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crepe
+{
+class MappedFile
+{
+public:
+    // Throws std::runtime_error when the file cannot be opened or mapped
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // One mapping per path, shared while anyone holds it
+    static std::shared_ptr<const MappedFile> open_shared(const std::string &path);
+
+    const unsigned char *data() const { return bytes; }
+
+    size_t size() const { return length; }
+
+    const std::string &path() const { return file_path; }
+
+private:
+    std::string file_path;
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+    std::vector<unsigned char> fallback; // contents when not mapped
+};
+} // namespace crepe
+
+#endif //CREPE_MAPPED_FILE_HPP
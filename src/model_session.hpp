@@ -0,0 +1,28 @@
+#ifndef CREPE_MODEL_SESSION_HPP
+#define CREPE_MODEL_SESSION_HPP
+
+// Internal interface of one pooled inference session, implemented by each backend. A session
+// owns its input and output buffers and is only ever used by one thread at a time.
+
+#include <string>
+
+namespace crepe
+{
+class ModelSession
+{
+public:
+    virtual ~ModelSession() = default;
+
+    // Row-major [count, FRAME_LENGTH] input for the next batch, fill it then call runBatch
+    virtual float *inputFrames(int count) = 0;
+
+    // Runs the batch staged with inputFrames, returns the [count, OUTPUT_SIZE] activations.
+    // They stay valid until the next batch on this session.
+    virtual const float *runBatch(int count) = 0;
+
+    // Stops the backend's profiler and returns the trace file it wrote, if it has one
+    virtual std::string endProfiling() { return {}; }
+};
+} // namespace crepe
+
+#endif //CREPE_MODEL_SESSION_HPP
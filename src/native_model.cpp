@@ -0,0 +1,529 @@
+// GEMMs here run inside the caller's threading (session pool, per-frame OpenMP), never Eigen's own
+#define EIGEN_DONT_PARALLELIZE
+
+#include "native_model.hpp"
+#include "crepe.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace crepe
+{
+namespace
+{
+// Minimal protobuf wire-format reader, just enough of onnx.proto for the weights and graph
+class ProtoReader
+{
+public:
+    ProtoReader(const unsigned char *data, const size_t size) : pos(data), end(data + size)
+    {
+    }
+
+    explicit ProtoReader(const std::string_view bytes)
+        : ProtoReader(reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size())
+    {
+    }
+
+    // Advances to the next field, false at the end of the message
+    bool next()
+    {
+        if (pos >= end)
+        {
+            return false;
+        }
+        const uint64_t key = varint();
+        field = static_cast<int>(key >> 3);
+        wire_type = static_cast<int>(key & 7);
+        switch (wire_type)
+        {
+        case 0:
+            value = varint();
+            break;
+        case 1:
+            bytes = take(8);
+            break;
+        case 2:
+            bytes = take(static_cast<size_t>(varint()));
+            break;
+        case 5:
+            bytes = take(4);
+            break;
+        default:
+            throw std::runtime_error("Unsupported protobuf wire type in model");
+        }
+        return true;
+    }
+
+    int field = 0;
+    int wire_type = 0;
+    uint64_t value = 0; // varint fields
+    std::string_view bytes; // everything else
+
+    // Repeated int64 field, packed or not
+    void append_ints(std::vector<int64_t> &ints) const
+    {
+        if (wire_type == 0)
+        {
+            ints.push_back(static_cast<int64_t>(value));
+            return;
+        }
+        ProtoReader packed(bytes);
+        while (packed.pos < packed.end)
+        {
+            ints.push_back(static_cast<int64_t>(packed.varint()));
+        }
+    }
+
+private:
+    const unsigned char *pos;
+    const unsigned char *end;
+
+    uint64_t varint()
+    {
+        uint64_t result = 0;
+        for (int shift = 0; pos < end && shift < 64; shift += 7)
+        {
+            const unsigned char byte = *pos++;
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return result;
+            }
+        }
+        throw std::runtime_error("Truncated varint in model");
+    }
+
+    std::string_view take(const size_t count)
+    {
+        if (static_cast<size_t>(end - pos) < count)
+        {
+            throw std::runtime_error("Truncated field in model");
+        }
+        const std::string_view view(reinterpret_cast<const char *>(pos), count);
+        pos += count;
+        return view;
+    }
+};
+
+struct Tensor
+{
+    std::vector<int64_t> dims;
+    std::vector<float> values;
+};
+
+struct Node
+{
+    std::string op;
+    std::vector<std::string> inputs;
+    std::map<std::string, std::vector<int64_t>> attributes; // int and ints attributes
+};
+
+constexpr int ONNX_FLOAT = 1;
+
+Tensor parse_tensor(const std::string_view message, std::string &name)
+{
+    Tensor tensor;
+    int data_type = 0;
+    std::string_view raw;
+    ProtoReader reader(message);
+    while (reader.next())
+    {
+        switch (reader.field)
+        {
+        case 1: // dims
+            reader.append_ints(tensor.dims);
+            break;
+        case 2: // data_type
+            data_type = static_cast<int>(reader.value);
+            break;
+        case 4: // float_data, packed
+            for (size_t i = 0; i + 4 <= reader.bytes.size(); i += 4)
+            {
+                float v;
+                std::memcpy(&v, reader.bytes.data() + i, 4);
+                tensor.values.push_back(v);
+            }
+            break;
+        case 8: // name
+            name = reader.bytes;
+            break;
+        case 9: // raw_data, little endian
+            raw = reader.bytes;
+            break;
+        default:
+            break;
+        }
+    }
+    if (data_type != ONNX_FLOAT)
+    {
+        tensor.values.clear(); // shapes and indices, not weights
+        return tensor;
+    }
+    if (!raw.empty())
+    {
+        tensor.values.resize(raw.size() / 4);
+        std::memcpy(tensor.values.data(), raw.data(), tensor.values.size() * 4);
+    }
+    return tensor;
+}
+
+Node parse_node(const std::string_view message)
+{
+    Node node;
+    ProtoReader reader(message);
+    while (reader.next())
+    {
+        if (reader.field == 1) // input
+        {
+            node.inputs.emplace_back(reader.bytes);
+        }
+        else if (reader.field == 4) // op_type
+        {
+            node.op = reader.bytes;
+        }
+        else if (reader.field == 5) // attribute
+        {
+            std::string name;
+            std::vector<int64_t> ints;
+            ProtoReader attribute(reader.bytes);
+            while (attribute.next())
+            {
+                if (attribute.field == 1)
+                {
+                    name = attribute.bytes;
+                }
+                else if (attribute.field == 3 || attribute.field == 8) // i, ints
+                {
+                    attribute.append_ints(ints);
+                }
+            }
+            node.attributes[name] = std::move(ints);
+        }
+    }
+    return node;
+}
+
+[[noreturn]] void unsupported(const std::string &what)
+{
+    throw std::runtime_error("Unsupported CREPE model graph: " + what);
+}
+
+int64_t attribute(const Node &node, const std::string &name, const size_t index,
+                  const int64_t fallback)
+{
+    const auto found = node.attributes.find(name);
+    return found != node.attributes.end() && found->second.size() > index
+               ? found->second[index]
+               : fallback;
+}
+} // namespace
+
+std::shared_ptr<const NativeWeights> NativeWeights::from_onnx(const unsigned char *data,
+                                                              const size_t size)
+{
+    using namespace constants;
+
+    std::string_view graph;
+    ProtoReader model(data, size);
+    while (model.next())
+    {
+        if (model.field == 7) // ModelProto.graph
+        {
+            graph = model.bytes;
+        }
+    }
+    if (graph.empty())
+    {
+        unsupported("no graph");
+    }
+
+    std::map<std::string, Tensor> initializers;
+    std::vector<Node> nodes;
+    ProtoReader reader(graph);
+    while (reader.next())
+    {
+        if (reader.field == 1) // GraphProto.node, in topological order
+        {
+            nodes.push_back(parse_node(reader.bytes));
+        }
+        else if (reader.field == 5) // GraphProto.initializer
+        {
+            std::string name;
+            Tensor tensor = parse_tensor(reader.bytes, name);
+            initializers[name] = std::move(tensor);
+        }
+    }
+
+    // the float initializer among a node's inputs, if any
+    const auto constant_input = [&](const Node &node) -> const Tensor * {
+        for (const std::string &input : node.inputs)
+        {
+            if (const auto found = initializers.find(input);
+                found != initializers.end() && !found->second.values.empty())
+            {
+                return &found->second;
+            }
+        }
+        return nullptr;
+    };
+
+    auto weights = std::make_shared<NativeWeights>();
+    int length = FRAME_LENGTH;
+    int channels = 1;
+    bool dense = false;
+    bool have_scale = false;
+    bool have_offset = false;
+
+    // Conv -> Relu -> Mul -> Add -> MaxPool per block, then MatMul -> Add -> Sigmoid
+    for (const Node &node : nodes)
+    {
+        if (node.op == "Conv")
+        {
+            if (node.inputs.size() < 2 || !initializers.count(node.inputs[1]))
+            {
+                unsupported("conv without constant weights");
+            }
+            const Tensor &kernel = initializers.at(node.inputs[1]);
+            if (kernel.dims.size() != 4 || kernel.dims[1] != channels || kernel.dims[3] != 1)
+            {
+                unsupported("conv weights of an unexpected shape");
+            }
+
+            ConvBlock block{};
+            block.in_channels = channels;
+            block.out_channels = static_cast<int>(kernel.dims[0]);
+            block.kernel = static_cast<int>(kernel.dims[2]);
+            block.stride = static_cast<int>(attribute(node, "strides", 0, 1));
+            block.pad_begin = static_cast<int>(attribute(node, "pads", 0, 0));
+            block.pad_end = static_cast<int>(attribute(node, "pads", 2, 0));
+            block.input_length = length;
+            block.conv_length = (length + block.pad_begin + block.pad_end - block.kernel) /
+                                block.stride + 1;
+
+            // ONNX [out, in, k, 1] to [k * in, out]
+            block.weights.resize(static_cast<Eigen::Index>(block.kernel) * channels,
+                                 block.out_channels);
+            for (int o = 0; o < block.out_channels; o++)
+            {
+                for (int c = 0; c < channels; c++)
+                {
+                    for (int k = 0; k < block.kernel; k++)
+                    {
+                        block.weights(static_cast<Eigen::Index>(k) * channels + c, o) =
+                            kernel.values[(static_cast<size_t>(o) * channels + c) *
+                                          block.kernel + k];
+                    }
+                }
+            }
+
+            block.bias = Eigen::VectorXf::Zero(block.out_channels);
+            if (node.inputs.size() > 2 && initializers.count(node.inputs[2]))
+            {
+                const Tensor &bias = initializers.at(node.inputs[2]);
+                block.bias = Eigen::Map<const Eigen::VectorXf>(bias.values.data(),
+                                                               block.out_channels);
+            }
+            block.scale = Eigen::VectorXf::Ones(block.out_channels);
+            block.offset = Eigen::VectorXf::Zero(block.out_channels);
+
+            weights->blocks.push_back(std::move(block));
+            have_scale = have_offset = false;
+        }
+        else if (node.op == "Mul" && !weights->blocks.empty() && !dense)
+        {
+            const Tensor *scale = constant_input(node);
+            ConvBlock &block = weights->blocks.back();
+            if (!scale || have_scale || scale->values.size() != static_cast<size_t>(
+                    block.out_channels))
+            {
+                unsupported("unexpected Mul");
+            }
+            block.scale = Eigen::Map<const Eigen::VectorXf>(scale->values.data(),
+                                                            block.out_channels);
+            have_scale = true;
+        }
+        else if (node.op == "Add" && !weights->blocks.empty() && !dense)
+        {
+            const Tensor *offset = constant_input(node);
+            ConvBlock &block = weights->blocks.back();
+            if (!offset || have_offset || offset->values.size() != static_cast<size_t>(
+                    block.out_channels))
+            {
+                unsupported("unexpected Add");
+            }
+            block.offset = Eigen::Map<const Eigen::VectorXf>(offset->values.data(),
+                                                             block.out_channels);
+            have_offset = true;
+        }
+        else if (node.op == "MaxPool")
+        {
+            if (weights->blocks.empty() || attribute(node, "kernel_shape", 0, 0) != 2 ||
+                attribute(node, "strides", 0, 0) != 2)
+            {
+                unsupported("pooling other than 2 with stride 2");
+            }
+            const ConvBlock &block = weights->blocks.back();
+            length = block.output_length();
+            channels = block.out_channels;
+        }
+        else if (node.op == "MatMul")
+        {
+            const Tensor *matrix = constant_input(node);
+            if (!matrix || matrix->dims.size() != 2 || matrix->dims[0] != length * channels ||
+                matrix->dims[1] != OUTPUT_SIZE)
+            {
+                unsupported("dense layer of an unexpected shape");
+            }
+            // [in, out] row-major as stored
+            weights->dense_weights = Eigen::Map<const NativeWeights::RowMatrix>(
+                matrix->values.data(), matrix->dims[0], matrix->dims[1]);
+            weights->dense_bias = Eigen::RowVectorXf::Zero(OUTPUT_SIZE);
+            dense = true;
+        }
+        else if (node.op == "Add" && dense)
+        {
+            const Tensor *bias = constant_input(node);
+            if (!bias || bias->values.size() != static_cast<size_t>(OUTPUT_SIZE))
+            {
+                unsupported("unexpected dense bias");
+            }
+            weights->dense_bias = Eigen::Map<const Eigen::RowVectorXf>(bias->values.data(),
+                                                                       OUTPUT_SIZE);
+        }
+        else if (node.op != "Relu" && node.op != "Reshape" && node.op != "Transpose" &&
+                 node.op != "Sigmoid")
+        {
+            unsupported("operator " + node.op);
+        }
+    }
+
+    if (weights->blocks.empty() || !dense)
+    {
+        unsupported("missing conv blocks or classifier");
+    }
+    return weights;
+}
+
+NativeModel::NativeModel(std::shared_ptr<const NativeWeights> model_weights, const int threads)
+    : weights(std::move(model_weights)), threads(std::max(threads, 1))
+{
+    const NativeWeights::ConvBlock &last = weights->blocks.back();
+    flattened = last.output_length() * last.out_channels;
+
+    // the largest block input (with padding) and conv output any block needs
+    size_t padded = 0;
+    size_t conv = 0;
+    for (const NativeWeights::ConvBlock &block : weights->blocks)
+    {
+        padded = std::max(padded, static_cast<size_t>(block.pad_begin + block.input_length +
+                                                      block.pad_end) *
+                                  block.in_channels);
+        conv = std::max(conv, static_cast<size_t>(block.conv_length) * block.out_channels);
+    }
+    scratch.resize(static_cast<size_t>(this->threads));
+    for (Scratch &buffers : scratch)
+    {
+        buffers.padded[0].resize(padded);
+        buffers.padded[1].resize(padded);
+        buffers.conv.resize(conv);
+    }
+}
+
+float *NativeModel::inputFrames(const int count)
+{
+    using namespace constants;
+
+    if (const auto needed = static_cast<size_t>(count) * FRAME_LENGTH;
+        input_buffer.size() < needed)
+    {
+        input_buffer.resize(needed);
+        features.resize(static_cast<size_t>(count) * flattened);
+        output_buffer.resize(static_cast<size_t>(count) * OUTPUT_SIZE);
+    }
+    return input_buffer.data();
+}
+
+void NativeModel::forward_frame(const float *frame, float *frame_features,
+                                Scratch &buffers) const
+{
+    using namespace constants;
+    using Patches = Eigen::Map<const NativeWeights::RowMatrix, 0, Eigen::OuterStride<>>;
+
+    const size_t num_blocks = weights->blocks.size();
+    for (size_t b = 0; b < num_blocks; b++)
+    {
+        const NativeWeights::ConvBlock &block = weights->blocks[b];
+        float *input = buffers.padded[b % 2].data();
+        const size_t channels = static_cast<size_t>(block.in_channels);
+
+        // zero padding either side of the block input; the interior was written by the previous
+        // block's epilogue, or is the frame itself for the first block
+        std::fill_n(input, static_cast<size_t>(block.pad_begin) * channels, 0.0f);
+        std::fill_n(input + static_cast<size_t>(block.pad_begin + block.input_length) * channels,
+                    static_cast<size_t>(block.pad_end) * channels, 0.0f);
+        if (b == 0)
+        {
+            std::copy_n(frame, static_cast<size_t>(block.input_length) * channels,
+                        input + static_cast<size_t>(block.pad_begin) * channels);
+        }
+
+        // im2col without the copy: channels-last windows of kernel * channels values start
+        // stride * channels apart, so overlapping rows of one strided map are the patch matrix
+        const Patches patches(input, block.conv_length,
+                              static_cast<Eigen::Index>(block.kernel) * block.in_channels,
+                              Eigen::OuterStride<>(block.stride * block.in_channels));
+        Eigen::Map<NativeWeights::RowMatrix> conv(buffers.conv.data(), block.conv_length,
+                                                  block.out_channels);
+        conv.noalias() = patches * block.weights;
+
+        // the next block's input interior, or the flattened features after the last block
+        float *output = b + 1 < num_blocks
+                            ? buffers.padded[(b + 1) % 2].data() +
+                              static_cast<size_t>(weights->blocks[b + 1].pad_begin) *
+                              block.out_channels
+                            : frame_features;
+        simd::bias_relu_affine_pool2(buffers.conv.data(), output,
+                                     static_cast<size_t>(block.conv_length),
+                                     static_cast<size_t>(block.out_channels), block.bias.data(),
+                                     block.scale.data(), block.offset.data());
+    }
+}
+
+const float *NativeModel::runBatch(const int count)
+{
+    using namespace constants;
+
+    // frames are independent up to the dense layer
+#pragma omp parallel for num_threads(threads) if(threads > 1 && count > 1)
+    for (int f = 0; f < count; f++)
+    {
+#ifdef _OPENMP
+        Scratch &buffers = scratch[static_cast<size_t>(omp_get_thread_num())];
+#else
+        Scratch &buffers = scratch[0];
+#endif
+        forward_frame(input_buffer.data() + static_cast<size_t>(f) * FRAME_LENGTH,
+                      features.data() + static_cast<size_t>(f) * flattened, buffers);
+    }
+
+    // one GEMM for the classifier over the whole batch
+    const Eigen::Map<const NativeWeights::RowMatrix> batch_features(features.data(), count,
+                                                                    flattened);
+    Eigen::Map<NativeWeights::RowMatrix> output(output_buffer.data(), count, OUTPUT_SIZE);
+    output.noalias() = batch_features * weights->dense_weights;
+    output.rowwise() += weights->dense_bias;
+    output = (1.0f + (-output.array()).exp()).inverse().matrix();
+
+    return output_buffer.data();
+}
+} // namespace crepe
@@ -0,0 +1,81 @@
+#ifndef CREPE_NATIVE_MODEL_HPP
+#define CREPE_NATIVE_MODEL_HPP
+
+// Internal dependency-free backend: the CREPE forward pass (conv1d + relu + batchnorm + maxpool
+// blocks, then a dense sigmoid layer) in Eigen and the simd kernels, with weights read from the
+// ONNX export of any capacity.
+
+#include "model_session.hpp"
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace crepe
+{
+struct NativeWeights
+{
+    using RowMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    struct ConvBlock
+    {
+        int in_channels;
+        int out_channels;
+        int kernel;
+        int stride;
+        int pad_begin;
+        int pad_end;
+        int input_length; // time steps in
+        int conv_length; // time steps out of the conv, before pooling
+        // [kernel * in_channels, out_channels], row k * in_channels + c is tap k of channel c,
+        // matching a channels-last window of the input
+        Eigen::MatrixXf weights;
+        Eigen::VectorXf bias;
+        Eigen::VectorXf scale; // batchnorm, folded to an affine
+        Eigen::VectorXf offset;
+
+        int output_length() const { return conv_length / 2; }
+    };
+
+    std::vector<ConvBlock> blocks;
+    Eigen::MatrixXf dense_weights; // [flattened last block, OUTPUT_SIZE]
+    Eigen::RowVectorXf dense_bias;
+
+    // Parses an ONNX ModelProto as exported by tf2onnx from the CREPE Keras model.
+    // Throws std::runtime_error for anything that is not that graph.
+    static std::shared_ptr<const NativeWeights> from_onnx(const unsigned char *data,
+                                                          size_t size);
+};
+
+class NativeModel final : public ModelSession
+{
+public:
+    // threads: frames of one batch processed in parallel (OpenMP), 1 to stay on the caller
+    NativeModel(std::shared_ptr<const NativeWeights> weights, int threads);
+
+    float *inputFrames(int count) override;
+
+    const float *runBatch(int count) override;
+
+private:
+    // Per-thread activations of one frame
+    struct Scratch
+    {
+        std::vector<float> padded[2]; // ping-pong block inputs, channels-last with zero padding
+        std::vector<float> conv; // [conv_length, out_channels]
+    };
+
+    std::shared_ptr<const NativeWeights> weights;
+    int threads;
+    int flattened; // features into the dense layer
+    std::vector<float> input_buffer; // [capacity, FRAME_LENGTH]
+    std::vector<float> features; // [capacity, flattened]
+    std::vector<float> output_buffer; // [capacity, OUTPUT_SIZE]
+    std::vector<Scratch> scratch;
+
+    void forward_frame(const float *frame, float *frame_features, Scratch &buffers) const;
+};
+} // namespace crepe
+
+#endif //CREPE_NATIVE_MODEL_HPP
@@ -0,0 +1,221 @@
+#include "resampler.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace crepe
+{
+namespace
+{
+constexpr double STOPBAND_ATTENUATION_DB = 80.0;
+constexpr double PASSBAND_EDGE = 0.9; // fraction of the lower Nyquist frequency kept flat
+// enough for inputs up to about 650 kHz resampled to 16 kHz
+constexpr int MAX_TAPS_PER_PHASE = 4096;
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+double bessel_i0(const double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++)
+    {
+        const double half = x / (2.0 * k);
+        term *= half * half;
+        sum += term;
+    }
+    return sum;
+}
+} // namespace
+
+struct Resampler::FilterBank
+{
+    int up; // L
+    int down; // M
+    int taps; // per phase
+    size_t delay; // in output samples
+    std::vector<float> coefficients; // [up, taps], each phase reversed for a forward dot
+
+    FilterBank(const int up, const int down, const int input_rate, const int output_rate)
+        : up(up), down(down)
+    {
+        constexpr double pi = 3.14159265358979323846;
+
+        // transition band from PASSBAND_EDGE to the lower Nyquist, sized with Kaiser's formula
+        const double nyquist = 0.5 * std::min(input_rate, output_rate);
+        const double transition = (1.0 - PASSBAND_EDGE) * nyquist / input_rate;
+        const int needed = static_cast<int>(
+            std::ceil((STOPBAND_ATTENUATION_DB - 7.95) / (14.36 * transition)));
+        if (needed > MAX_TAPS_PER_PHASE)
+        {
+            // a shorter filter would silently let aliases through
+            throw std::invalid_argument("Resampling " + std::to_string(input_rate) + " -> " +
+                                        std::to_string(output_rate) + " needs " +
+                                        std::to_string(needed) + " taps per phase, more than " +
+                                        std::to_string(MAX_TAPS_PER_PHASE));
+        }
+        taps = std::max((needed + 7) / 8 * 8, 8);
+
+        const double beta = 0.1102 * (STOPBAND_ATTENUATION_DB - 8.7);
+        const size_t length = static_cast<size_t>(up) * taps;
+        // centre on a whole number of output samples so the delay can be compensated exactly
+        delay = (length - 1) / 2 / static_cast<size_t>(down);
+        const double centre = static_cast<double>(delay * static_cast<size_t>(down));
+        // cutoff mid-transition, in cycles per sample of the L-times upsampled stream
+        const double cutoff = 0.5 * (1.0 + PASSBAND_EDGE) * nyquist /
+                              (static_cast<double>(input_rate) * up);
+
+        std::vector<double> prototype(length);
+        for (size_t k = 0; k < length; k++)
+        {
+            const double t = static_cast<double>(k) - centre;
+            const double sinc = t == 0.0
+                                    ? 2.0 * cutoff
+                                    : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+            const double r = centre > 0.0 ? t / centre : 0.0;
+            const double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) /
+                                  bessel_i0(beta);
+            prototype[k] = sinc * window * up; // gain of L undoes the zero stuffing
+        }
+
+        coefficients.resize(length);
+        for (int p = 0; p < up; p++)
+        {
+            for (int j = 0; j < taps; j++)
+            {
+                coefficients[static_cast<size_t>(p) * taps + (taps - 1 - j)] =
+                    static_cast<float>(prototype[static_cast<size_t>(p) + static_cast<size_t>(j) * up]);
+            }
+        }
+    }
+
+    // Banks are shared by every resampler with the same ratio while any of them is alive
+    static std::shared_ptr<const FilterBank> get(const int input_rate, const int output_rate)
+    {
+        const int divisor = std::gcd(input_rate, output_rate);
+        const int up = output_rate / divisor;
+        const int down = input_rate / divisor;
+
+        static std::mutex mutex;
+        static std::map<std::pair<int, int>, std::weak_ptr<const FilterBank>> cache;
+
+        std::lock_guard lock(mutex);
+        auto &entry = cache[{input_rate, output_rate}];
+        auto bank = entry.lock();
+        if (!bank)
+        {
+            bank = std::make_shared<const FilterBank>(up, down, input_rate, output_rate);
+            entry = bank;
+        }
+        return bank;
+    }
+};
+
+Resampler::Resampler(const int input_rate, const int output_rate)
+    : in_rate(input_rate), out_rate(output_rate)
+{
+    if (input_rate <= 0 || output_rate <= 0)
+    {
+        throw std::invalid_argument("Invalid resampling rates " + std::to_string(input_rate) +
+                                    " -> " + std::to_string(output_rate));
+    }
+
+    bank = FilterBank::get(input_rate, output_rate);
+    reset();
+}
+
+Resampler::~Resampler() = default;
+
+Resampler::Resampler(Resampler &&) noexcept = default;
+
+Resampler &Resampler::operator=(Resampler &&) noexcept = default;
+
+void Resampler::reset()
+{
+    const size_t history = static_cast<size_t>(bank->taps) - 1;
+    scratch.assign(2 * history, 0.0f);
+    next_input = history;
+    phase = 0;
+}
+
+size_t Resampler::max_output(const size_t count) const
+{
+    return count * static_cast<size_t>(bank->up) / static_cast<size_t>(bank->down) + 2;
+}
+
+size_t Resampler::delay() const
+{
+    return bank->delay;
+}
+
+size_t Resampler::process(const float *input, const size_t count, float *output)
+{
+    const size_t taps = bank->taps;
+    const size_t history = taps - 1;
+
+    // windows that still reach into the history are read from scratch, which holds the history
+    // followed by the first samples of this input; every later window reads input in place
+    const size_t head = std::min(count, history);
+    std::copy_n(input, head, scratch.begin() + static_cast<std::ptrdiff_t>(history));
+
+    const size_t end = history + count;
+    const float *coefficients = bank->coefficients.data();
+    size_t produced = 0;
+
+    while (next_input < end)
+    {
+        const size_t start = next_input - history;
+        const float *window = start < history ? scratch.data() + start : input + (start - history);
+
+        output[produced++] = simd::dot(coefficients + static_cast<size_t>(phase) * taps, window,
+                                       taps);
+
+        phase += bank->down;
+        next_input += static_cast<size_t>(phase / bank->up);
+        phase %= bank->up;
+    }
+
+    // the newest history samples become the next call's history
+    if (count >= history)
+    {
+        std::copy_n(input + (count - history), history, scratch.begin());
+    }
+    else
+    {
+        std::copy(scratch.begin() + static_cast<std::ptrdiff_t>(count),
+                  scratch.begin() + static_cast<std::ptrdiff_t>(count + history), scratch.begin());
+    }
+    next_input -= count;
+
+    return produced;
+}
+
+std::vector<float> resample(const float *audio_data, const size_t length, const int input_rate,
+                            const int output_rate)
+{
+    Resampler resampler(input_rate, output_rate);
+
+    const size_t expected = static_cast<size_t>(
+        std::ceil(static_cast<double>(length) * output_rate / input_rate));
+    const size_t delay = resampler.delay();
+
+    // zeros after the signal flush the filter's delay line
+    const size_t flush = (delay + 2) * static_cast<size_t>(input_rate) /
+                         static_cast<size_t>(output_rate) + 2;
+    const std::vector<float> zeros(flush, 0.0f);
+
+    std::vector<float> output(resampler.max_output(length) + resampler.max_output(flush));
+    size_t produced = resampler.process(audio_data, length, output.data());
+    produced += resampler.process(zeros.data(), zeros.size(), output.data() + produced);
+
+    const size_t first = std::min(delay, produced);
+    output.erase(output.begin(), output.begin() + static_cast<std::ptrdiff_t>(first));
+    output.resize(std::min(expected, produced - first));
+    return output;
+}
+} // namespace crepe
@@ -0,0 +1,61 @@
+#ifndef CREPE_RESAMPLER_HPP
+#define CREPE_RESAMPLER_HPP
+
+// Streaming polyphase resampler for feeding non-16 kHz audio to the model.
+// The rate ratio is reduced to L/M and a Kaiser-windowed sinc is split into L phases of
+// taps_per_phase coefficients each. Filter banks are built once per ratio and shared by every
+// resampler using it; each output sample is one SIMD dot product.
+
+#include "crepe.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace crepe
+{
+class Resampler
+{
+public:
+    explicit Resampler(int input_rate, int output_rate = constants::SAMPLE_RATE);
+
+    ~Resampler();
+
+    Resampler(Resampler &&) noexcept;
+
+    Resampler &operator=(Resampler &&) noexcept;
+
+    // Resample the next count input samples into output, which must hold max_output(count)
+    // samples. Filter state carries over between calls. Returns the samples written.
+    size_t process(const float *input, size_t count, float *output);
+
+    // Upper bound on what process() writes for count input samples
+    size_t max_output(size_t count) const;
+
+    // Filter group delay in output samples
+    size_t delay() const;
+
+    void reset();
+
+    int input_rate() const { return in_rate; }
+
+    int output_rate() const { return out_rate; }
+
+private:
+    struct FilterBank;
+
+    int in_rate;
+    int out_rate;
+    std::shared_ptr<const FilterBank> bank;
+    std::vector<float> scratch; // history (taps - 1) followed by the head of the next input
+    size_t next_input = 0; // newest sample of the next output's window, history-relative
+    int phase = 0;
+};
+
+// Whole-buffer resampling with the filter delay compensated, so output sample n lines up with
+// time n / output_rate of the input
+std::vector<float> resample(const float *audio_data, size_t length, int input_rate,
+                            int output_rate = constants::SAMPLE_RATE);
+} // namespace crepe
+
+#endif //CREPE_RESAMPLER_HPP
@@ -0,0 +1,19 @@
+#include "simd.hpp"
+
+namespace crepe::simd
+{
+const char *kernel_path()
+{
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    return "avx2+fma+f16c";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__ARM_NEON)
+    return "neon";
+#elif defined(__wasm_simd128__)
+    return "simd128";
+#else
+    return "scalar";
+#endif
+}
+} // namespace crepe::simd
@@ -0,0 +1,436 @@
+#ifndef CREPE_SIMD_HPP
+#define CREPE_SIMD_HPP
+
+// Internal hand-vectorized kernels. Each has an AVX2, NEON and wasm simd128 path picked at
+// compile time from the target flags, with a scalar fallback for everything else.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+namespace crepe::simd
+{
+// The kernel path crepe_core itself was compiled with ("avx2+fma+f16c", "neon", "simd128" or
+// "scalar"), which can differ from what a caller's own flags would pick from this header
+const char *kernel_path();
+
+// out[i] = (in[i] - offset) * scale
+inline void subtract_scale(const float *in, float *out, const size_t count, const float offset,
+                           const float scale)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 offset_v = _mm256_set1_ps(offset);
+    const __m256 scale_v = _mm256_set1_ps(scale);
+    for (const size_t end = count - count % 8; i < end; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(in + i);
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(x, offset_v), scale_v));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t offset_v = vdupq_n_f32(offset);
+    const float32x4_t scale_v = vdupq_n_f32(scale);
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(in + i);
+        vst1q_f32(out + i, vmulq_f32(vsubq_f32(x, offset_v), scale_v));
+    }
+#elif defined(__wasm_simd128__)
+    const v128_t offset_v = wasm_f32x4_splat(offset);
+    const v128_t scale_v = wasm_f32x4_splat(scale);
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        const v128_t x = wasm_v128_load(in + i);
+        wasm_v128_store(out + i, wasm_f32x4_mul(wasm_f32x4_sub(x, offset_v), scale_v));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = (in[i] - offset) * scale;
+    }
+}
+
+// sum of a[i] * b[i]
+inline float dot(const float *a, const float *b, const size_t count)
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX2__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (const size_t end = count - count % 16; i < end; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_movehdup_ps(half));
+    sum = _mm_cvtss_f32(half);
+#elif defined(__ARM_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) +
+          vgetq_lane_f32(acc, 3);
+#elif defined(__wasm_simd128__)
+    v128_t acc = wasm_f32x4_splat(0.0f);
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        acc = wasm_f32x4_add(acc, wasm_f32x4_mul(wasm_v128_load(a + i), wasm_v128_load(b + i)));
+    }
+    sum = wasm_f32x4_extract_lane(acc, 0) + wasm_f32x4_extract_lane(acc, 1) +
+          wasm_f32x4_extract_lane(acc, 2) + wasm_f32x4_extract_lane(acc, 3);
+#endif
+    for (; i < count; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+// Conv block epilogue for channels-last [rows, channels] conv output: bias, relu, batchnorm
+// affine, then max pooling over pairs of rows.
+// out[r][c] = max(f(in[2r][c]), f(in[2r+1][c])), f(x) = max(x + bias[c], 0) * scale[c] + offset[c]
+inline void bias_relu_affine_pool2(const float *in, float *out, const size_t rows,
+                                   const size_t channels, const float *bias, const float *scale,
+                                   const float *offset)
+{
+    for (size_t r = 0; r + 1 < rows; r += 2)
+    {
+        const float *a = in + r * channels;
+        const float *b = a + channels;
+        float *o = out + r / 2 * channels;
+
+        size_t c = 0;
+#if defined(__AVX2__)
+        const __m256 zero = _mm256_setzero_ps();
+        for (const size_t end = channels - channels % 8; c < end; c += 8)
+        {
+            const __m256 bias_v = _mm256_loadu_ps(bias + c);
+            const __m256 scale_v = _mm256_loadu_ps(scale + c);
+            const __m256 offset_v = _mm256_loadu_ps(offset + c);
+            const __m256 x = _mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(a + c), bias_v), zero);
+            const __m256 y = _mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(b + c), bias_v), zero);
+            _mm256_storeu_ps(o + c, _mm256_max_ps(_mm256_fmadd_ps(x, scale_v, offset_v),
+                                                  _mm256_fmadd_ps(y, scale_v, offset_v)));
+        }
+#elif defined(__ARM_NEON)
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        for (const size_t end = channels - channels % 4; c < end; c += 4)
+        {
+            const float32x4_t bias_v = vld1q_f32(bias + c);
+            const float32x4_t scale_v = vld1q_f32(scale + c);
+            const float32x4_t offset_v = vld1q_f32(offset + c);
+            const float32x4_t x = vmaxq_f32(vaddq_f32(vld1q_f32(a + c), bias_v), zero);
+            const float32x4_t y = vmaxq_f32(vaddq_f32(vld1q_f32(b + c), bias_v), zero);
+            vst1q_f32(o + c, vmaxq_f32(vmlaq_f32(offset_v, x, scale_v),
+                                       vmlaq_f32(offset_v, y, scale_v)));
+        }
+#elif defined(__wasm_simd128__)
+        const v128_t zero = wasm_f32x4_splat(0.0f);
+        for (const size_t end = channels - channels % 4; c < end; c += 4)
+        {
+            const v128_t bias_v = wasm_v128_load(bias + c);
+            const v128_t scale_v = wasm_v128_load(scale + c);
+            const v128_t offset_v = wasm_v128_load(offset + c);
+            const v128_t x = wasm_f32x4_max(wasm_f32x4_add(wasm_v128_load(a + c), bias_v), zero);
+            const v128_t y = wasm_f32x4_max(wasm_f32x4_add(wasm_v128_load(b + c), bias_v), zero);
+            wasm_v128_store(o + c,
+                            wasm_f32x4_max(wasm_f32x4_add(wasm_f32x4_mul(x, scale_v), offset_v),
+                                           wasm_f32x4_add(wasm_f32x4_mul(y, scale_v), offset_v)));
+        }
+#endif
+        for (; c < channels; c++)
+        {
+            const float x = std::max(a[c] + bias[c], 0.0f) * scale[c] + offset[c];
+            const float y = std::max(b[c] + bias[c], 0.0f) * scale[c] + offset[c];
+            o[c] = std::max(x, y);
+        }
+    }
+}
+
+// Index of the largest of count > 0 values, the first one on ties
+inline size_t argmax(const float *values, const size_t count)
+{
+    size_t i = 0;
+    size_t best = 0;
+    float best_value = values[0];
+#if defined(__AVX2__)
+    if (count >= 8)
+    {
+        // per-lane maximum and where it was, reduced at the end
+        __m256 max_v = _mm256_loadu_ps(values);
+        __m256i index_v = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i best_v = index_v;
+        const __m256i step = _mm256_set1_epi32(8);
+        i = 8;
+        for (const size_t end = count - count % 8; i < end; i += 8)
+        {
+            index_v = _mm256_add_epi32(index_v, step);
+            const __m256 x = _mm256_loadu_ps(values + i);
+            const __m256 greater = _mm256_cmp_ps(x, max_v, _CMP_GT_OQ);
+            max_v = _mm256_blendv_ps(max_v, x, greater);
+            best_v = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_v),
+                                                          _mm256_castsi256_ps(index_v), greater));
+        }
+        alignas(32) float lane_max[8];
+        alignas(32) int32_t lane_index[8];
+        _mm256_store_ps(lane_max, max_v);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lane_index), best_v);
+        best_value = lane_max[0];
+        best = static_cast<size_t>(lane_index[0]);
+        for (int l = 1; l < 8; l++)
+        {
+            const auto index = static_cast<size_t>(lane_index[l]);
+            if (lane_max[l] > best_value || (lane_max[l] == best_value && index < best))
+            {
+                best_value = lane_max[l];
+                best = index;
+            }
+        }
+    }
+#elif defined(__ARM_NEON)
+    if (count >= 4)
+    {
+        float32x4_t max_v = vld1q_f32(values);
+        const int32_t first[4] = {0, 1, 2, 3};
+        int32x4_t index_v = vld1q_s32(first);
+        int32x4_t best_v = index_v;
+        const int32x4_t step = vdupq_n_s32(4);
+        i = 4;
+        for (const size_t end = count - count % 4; i < end; i += 4)
+        {
+            index_v = vaddq_s32(index_v, step);
+            const float32x4_t x = vld1q_f32(values + i);
+            const uint32x4_t greater = vcgtq_f32(x, max_v);
+            max_v = vbslq_f32(greater, x, max_v);
+            best_v = vbslq_s32(greater, index_v, best_v);
+        }
+        float lane_max[4];
+        int32_t lane_index[4];
+        vst1q_f32(lane_max, max_v);
+        vst1q_s32(lane_index, best_v);
+        best_value = lane_max[0];
+        best = static_cast<size_t>(lane_index[0]);
+        for (int l = 1; l < 4; l++)
+        {
+            const auto index = static_cast<size_t>(lane_index[l]);
+            if (lane_max[l] > best_value || (lane_max[l] == best_value && index < best))
+            {
+                best_value = lane_max[l];
+                best = index;
+            }
+        }
+    }
+#elif defined(__wasm_simd128__)
+    if (count >= 4)
+    {
+        v128_t max_v = wasm_v128_load(values);
+        v128_t index_v = wasm_i32x4_make(0, 1, 2, 3);
+        v128_t best_v = index_v;
+        const v128_t step = wasm_i32x4_splat(4);
+        i = 4;
+        for (const size_t end = count - count % 4; i < end; i += 4)
+        {
+            index_v = wasm_i32x4_add(index_v, step);
+            const v128_t x = wasm_v128_load(values + i);
+            const v128_t greater = wasm_f32x4_gt(x, max_v);
+            max_v = wasm_v128_bitselect(x, max_v, greater);
+            best_v = wasm_v128_bitselect(index_v, best_v, greater);
+        }
+        float lane_max[4];
+        int32_t lane_index[4];
+        wasm_v128_store(lane_max, max_v);
+        wasm_v128_store(lane_index, best_v);
+        best_value = lane_max[0];
+        best = static_cast<size_t>(lane_index[0]);
+        for (int l = 1; l < 4; l++)
+        {
+            const auto index = static_cast<size_t>(lane_index[l]);
+            if (lane_max[l] > best_value || (lane_max[l] == best_value && index < best))
+            {
+                best_value = lane_max[l];
+                best = index;
+            }
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if (values[i] > best_value)
+        {
+            best_value = values[i];
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Running maximum with its argument: where in[i] + offset > best[i], best[i] = in[i] + offset
+// and best_index[i] = index
+inline void max_update(const float *in, const float offset, const float index, float *best,
+                       float *best_index, const size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 offset_v = _mm256_set1_ps(offset);
+    const __m256 index_v = _mm256_set1_ps(index);
+    for (const size_t end = count - count % 8; i < end; i += 8)
+    {
+        const __m256 x = _mm256_add_ps(_mm256_loadu_ps(in + i), offset_v);
+        const __m256 b = _mm256_loadu_ps(best + i);
+        const __m256 greater = _mm256_cmp_ps(x, b, _CMP_GT_OQ);
+        _mm256_storeu_ps(best + i, _mm256_blendv_ps(b, x, greater));
+        _mm256_storeu_ps(best_index + i,
+                         _mm256_blendv_ps(_mm256_loadu_ps(best_index + i), index_v, greater));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t offset_v = vdupq_n_f32(offset);
+    const float32x4_t index_v = vdupq_n_f32(index);
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        const float32x4_t x = vaddq_f32(vld1q_f32(in + i), offset_v);
+        const float32x4_t b = vld1q_f32(best + i);
+        const uint32x4_t greater = vcgtq_f32(x, b);
+        vst1q_f32(best + i, vbslq_f32(greater, x, b));
+        vst1q_f32(best_index + i, vbslq_f32(greater, index_v, vld1q_f32(best_index + i)));
+    }
+#elif defined(__wasm_simd128__)
+    const v128_t offset_v = wasm_f32x4_splat(offset);
+    const v128_t index_v = wasm_f32x4_splat(index);
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        const v128_t x = wasm_f32x4_add(wasm_v128_load(in + i), offset_v);
+        const v128_t b = wasm_v128_load(best + i);
+        const v128_t greater = wasm_f32x4_gt(x, b);
+        wasm_v128_store(best + i, wasm_v128_bitselect(x, b, greater));
+        wasm_v128_store(best_index + i,
+                        wasm_v128_bitselect(index_v, wasm_v128_load(best_index + i), greater));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if (const float x = in[i] + offset; x > best[i])
+        {
+            best[i] = x;
+            best_index[i] = index;
+        }
+    }
+}
+
+// IEEE half precision, round to nearest even, subnormals kept
+inline uint16_t float_to_half(const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x47800000u) // 65536 and up, infinities and nans
+    {
+        return static_cast<uint16_t>(sign | (magnitude > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    }
+    if (magnitude < 0x38800000u) // below the smallest normal half, 2^-14
+    {
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        const auto subnormal = static_cast<uint32_t>(std::nearbyint(absolute * 16777216.0f));
+        return static_cast<uint16_t>(sign | subnormal);
+    }
+
+    // rebias the exponent, then round the 13 dropped mantissa bits (a carry may reach infinity)
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    const uint32_t rest = magnitude & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+    {
+        half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float half_to_float(const uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1fu;
+    const uint32_t mantissa = half & 0x3ffu;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        const float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Bulk conversions, F16C with AVX2 and the aarch64 conversions; wasm simd128 has none, so
+// that build uses the scalar code
+inline void floats_to_halves(const float *in, uint16_t *out, const size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    for (const size_t end = count - count % 8; i < end; i += 8)
+    {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), h);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = float_to_half(in[i]);
+    }
+}
+
+inline void halves_to_floats(const uint16_t *in, float *out, const size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    for (const size_t end = count - count % 8; i < end; i += 8)
+    {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (const size_t end = count - count % 4; i < end; i += 4)
+    {
+        vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = half_to_float(in[i]);
+    }
+}
+} // namespace crepe::simd
+
+#endif //CREPE_SIMD_HPP
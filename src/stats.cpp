@@ -0,0 +1,271 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace crepe::stats
+{
+void Histogram::add(const double value)
+{
+    const int bucket = value <= 1.0
+                           ? 0
+                           : std::min(static_cast<int>(std::log2(value) * BUCKETS_PER_OCTAVE),
+                                      HISTOGRAM_BUCKETS - 1);
+    buckets[bucket]++;
+    min = count ? std::min(min, value) : value;
+    max = count ? std::max(max, value) : value;
+    count++;
+    sum += value;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    if (other.count == 0)
+    {
+        return;
+    }
+
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+    {
+        buckets[b] += other.buckets[b];
+    }
+    min = count ? std::min(min, other.min) : other.min;
+    max = count ? std::max(max, other.max) : other.max;
+    count += other.count;
+    sum += other.sum;
+}
+
+double Histogram::percentile(const double p) const
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+
+    const auto rank = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(count)));
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+    {
+        seen += buckets[b];
+        if (seen >= std::max<uint64_t>(rank, 1))
+        {
+            // the overflow bucket has no upper bound
+            if (b == HISTOGRAM_BUCKETS - 1)
+            {
+                return max;
+            }
+            const double upper = std::exp2(static_cast<double>(b + 1) / BUCKETS_PER_OCTAVE);
+            return std::clamp(upper, min, max);
+        }
+    }
+    return max;
+}
+
+namespace
+{
+// Per-thread accumulator. The owning thread is the only writer, the mutex is only ever
+// contended while a snapshot is being taken.
+struct ThreadStats
+{
+    std::mutex mutex;
+    uint64_t frames = 0;
+    uint64_t run_calls = 0;
+    Histogram batch_sizes;
+    Histogram latencies[4];
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<ThreadStats *> threads;
+    Snapshot retired; // totals of threads that have exited
+
+    std::atomic<int64_t> stream_pending{0};
+    std::atomic<int64_t> stream_peak{0};
+    std::atomic<uint64_t> stream_dropped{0};
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+void fold(Snapshot &into, ThreadStats &from)
+{
+    into.frames += from.frames;
+    into.run_calls += from.run_calls;
+    into.batch_sizes.merge(from.batch_sizes);
+    into.preprocess_us.merge(from.latencies[static_cast<int>(Stage::Preprocess)]);
+    into.model_us.merge(from.latencies[static_cast<int>(Stage::ModelRun)]);
+    into.decode_us.merge(from.latencies[static_cast<int>(Stage::Decode)]);
+    into.request_us.merge(from.latencies[static_cast<int>(Stage::Request)]);
+}
+
+// Registers on first use from a thread, folds itself into the retired totals on thread exit
+class ThreadHandle
+{
+public:
+    ThreadHandle() : stats(std::make_unique<ThreadStats>())
+    {
+        Registry &reg = registry();
+        std::lock_guard lock(reg.mutex);
+        reg.threads.push_back(stats.get());
+    }
+
+    ~ThreadHandle()
+    {
+        Registry &reg = registry();
+        std::lock_guard lock(reg.mutex);
+        std::lock_guard stats_lock(stats->mutex);
+        fold(reg.retired, *stats);
+        std::erase(reg.threads, stats.get());
+    }
+
+    ThreadStats &get() { return *stats; }
+
+private:
+    std::unique_ptr<ThreadStats> stats;
+};
+
+ThreadStats &local()
+{
+    thread_local ThreadHandle handle;
+    return handle.get();
+}
+
+void write_histogram(std::ostringstream &out, const char *name, const Histogram &histogram)
+{
+    out << "\"" << name << "\": {\"count\": " << histogram.count
+        << ", \"mean\": " << histogram.mean()
+        << ", \"min\": " << histogram.min
+        << ", \"p50\": " << histogram.percentile(50)
+        << ", \"p90\": " << histogram.percentile(90)
+        << ", \"p99\": " << histogram.percentile(99)
+        << ", \"max\": " << histogram.max << "}";
+}
+} // namespace
+
+void enable(const bool on)
+{
+    enabled_flag().store(on, std::memory_order_relaxed);
+}
+
+void record_batch(const int frames)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    ThreadStats &stats = local();
+    std::lock_guard lock(stats.mutex);
+    stats.frames += static_cast<uint64_t>(frames);
+    stats.run_calls++;
+    stats.batch_sizes.add(frames);
+}
+
+void record_latency(const Stage stage, const double microseconds)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    ThreadStats &stats = local();
+    std::lock_guard lock(stats.mutex);
+    stats.latencies[static_cast<int>(stage)].add(microseconds);
+}
+
+void record_stream_pending(const int64_t delta)
+{
+    if (delta == 0)
+    {
+        return;
+    }
+
+    Registry &reg = registry();
+    const int64_t pending = reg.stream_pending.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t peak = reg.stream_peak.load(std::memory_order_relaxed);
+    while (pending > peak &&
+           !reg.stream_peak.compare_exchange_weak(peak, pending, std::memory_order_relaxed))
+    {
+    }
+}
+
+void record_stream_dropped(const int64_t frames)
+{
+    if (!enabled() || frames == 0)
+    {
+        return;
+    }
+
+    registry().stream_dropped.fetch_add(static_cast<uint64_t>(frames), std::memory_order_relaxed);
+}
+
+Snapshot snapshot()
+{
+    Registry &reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    Snapshot result = reg.retired;
+    for (ThreadStats *stats : reg.threads)
+    {
+        std::lock_guard stats_lock(stats->mutex);
+        fold(result, *stats);
+    }
+
+    result.stream_pending_frames = reg.stream_pending.load(std::memory_order_relaxed);
+    result.stream_pending_peak = reg.stream_peak.load(std::memory_order_relaxed);
+    result.stream_dropped_frames = reg.stream_dropped.load(std::memory_order_relaxed);
+    return result;
+}
+
+void reset()
+{
+    Registry &reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    reg.retired = {};
+    for (ThreadStats *stats : reg.threads)
+    {
+        std::lock_guard stats_lock(stats->mutex);
+        stats->frames = 0;
+        stats->run_calls = 0;
+        stats->batch_sizes = {};
+        for (Histogram &histogram : stats->latencies)
+        {
+            histogram = {};
+        }
+    }
+
+    // the pending gauge tracks live streams, only its peak restarts
+    reg.stream_peak.store(reg.stream_pending.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+    reg.stream_dropped.store(0, std::memory_order_relaxed);
+}
+
+std::string to_json(const Snapshot &snapshot)
+{
+    std::ostringstream out;
+    out << "{\"frames\": " << snapshot.frames
+        << ", \"run_calls\": " << snapshot.run_calls << ", ";
+    write_histogram(out, "batch_size", snapshot.batch_sizes);
+    out << ", \"latency_us\": {";
+    write_histogram(out, "preprocess", snapshot.preprocess_us);
+    out << ", ";
+    write_histogram(out, "model_run", snapshot.model_us);
+    out << ", ";
+    write_histogram(out, "decode", snapshot.decode_us);
+    out << ", ";
+    write_histogram(out, "scheduled_request", snapshot.request_us);
+    out << "}, \"stream\": {\"pending_frames\": " << snapshot.stream_pending_frames
+        << ", \"pending_peak\": " << snapshot.stream_pending_peak
+        << ", \"dropped_frames\": " << snapshot.stream_dropped_frames << "}}";
+    return out.str();
+}
+} // namespace crepe::stats
@@ -0,0 +1,126 @@
+#ifndef CREPE_STATS_HPP
+#define CREPE_STATS_HPP
+
+// Opt-in runtime instrumentation for the inference engine.
+// Recording is thread local and only aggregated when a snapshot is taken, so it is cheap enough
+// to leave on in production. Everything is a no-op until enable(true).
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace crepe::stats
+{
+constexpr int HISTOGRAM_BUCKETS = 100;
+constexpr int BUCKETS_PER_OCTAVE = 4;
+
+// Log-scale histogram: bucket b holds values up to 2^((b + 1) / BUCKETS_PER_OCTAVE), so the
+// buckets below the last reach 2^24.75 (about 28 s in microseconds). The last bucket holds
+// everything above that, and its percentiles are reported as max.
+struct Histogram
+{
+    std::array<uint64_t, HISTOGRAM_BUCKETS> buckets{};
+    uint64_t count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+
+    void add(double value);
+
+    void merge(const Histogram &other);
+
+    double mean() const { return count ? sum / static_cast<double>(count) : 0.0; }
+
+    // Upper bound of the bucket holding the p-th percentile, clamped to [min, max]
+    double percentile(double p) const;
+};
+
+enum class Stage
+{
+    Preprocess, // framing and normalization
+    ModelRun, // session.Run
+    Decode, // activations to pitch/confidence
+    Request // BatchScheduler, submit to results
+};
+
+struct Snapshot
+{
+    uint64_t frames = 0;
+    uint64_t run_calls = 0;
+    Histogram batch_sizes;
+    Histogram preprocess_us;
+    Histogram model_us;
+    Histogram decode_us;
+    Histogram request_us;
+
+    // streaming gauges, summed over all live CrepeStreams
+    int64_t stream_pending_frames = 0;
+    int64_t stream_pending_peak = 0;
+    uint64_t stream_dropped_frames = 0;
+};
+
+void enable(bool on);
+
+inline std::atomic<bool> &enabled_flag()
+{
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+inline bool enabled()
+{
+    return enabled_flag().load(std::memory_order_relaxed);
+}
+
+Snapshot snapshot();
+
+void reset();
+
+std::string to_json(const Snapshot &snapshot);
+
+// recording, called by the engine
+void record_batch(int frames);
+
+void record_latency(Stage stage, double microseconds);
+
+// not gated on enabled(), streams only report while enabled but always retract on destruction
+void record_stream_pending(int64_t delta);
+
+void record_stream_dropped(int64_t frames);
+
+// Times its scope into a stage histogram when stats are enabled
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const Stage stage) : stage(stage), active(enabled())
+    {
+        if (active)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if (active)
+        {
+            const std::chrono::duration<double, std::micro> elapsed =
+                std::chrono::steady_clock::now() - start;
+            record_latency(stage, elapsed.count());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Stage stage;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+} // namespace crepe::stats
+
+#endif //CREPE_STATS_HPP
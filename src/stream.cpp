@@ -0,0 +1,250 @@
+#include "crepe.hpp"
+#include "decoding.hpp"
+#include "resampler.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+
+namespace crepe
+{
+namespace
+{
+// Sizes empty result vectors to capacity frames (as many as can ever be pending), otherwise
+// keeps them as they are. Returns how many of count fit.
+int prepare_results(PredictionResults &results, const int count, const int capacity)
+{
+    if (results.pitches.size() == 0)
+    {
+        results.pitches.resize(capacity);
+        results.confidences.resize(capacity);
+        results.times.resize(capacity);
+    }
+    if (results.voiced.size() != results.pitches.size())
+    {
+        results.voiced.resize(results.pitches.size());
+    }
+    return std::min(count, static_cast<int>(results.pitches.size()));
+}
+} // namespace
+
+CrepeStream::CrepeStream(const InferenceOptions &options, const int max_pending_frames,
+                         const int input_sample_rate)
+    : CrepeStream(Engine::default_engine(), options, max_pending_frames, input_sample_rate)
+{
+}
+
+CrepeStream::CrepeStream(Engine &engine, const InferenceOptions &options,
+                         const int max_pending_frames, const int input_sample_rate)
+    : engine(&engine), options(options)
+{
+    if (input_sample_rate != constants::SAMPLE_RATE)
+    {
+        resampler = std::make_unique<Resampler>(input_sample_rate);
+        time_offset = static_cast<int64_t>(resampler->delay());
+    }
+
+    using namespace constants;
+
+    max_frames = max_pending_frames > 0 ? max_pending_frames : std::max(options.batch_size, 1);
+    capacity = FRAME_LENGTH + static_cast<size_t>(max_frames - 1) * FFT_HOP;
+    ring.assign(2 * capacity, 0.0f);
+
+    if (options.decoder == PitchDecoder::Viterbi)
+    {
+        viterbi = std::make_unique<OnlineViterbi>(options.viterbi_lag_frames);
+        activations.resize(static_cast<size_t>(max_frames) * OUTPUT_SIZE);
+        // the held frames plus the ones pushed by the poll that decides them
+        held_frames.resize(viterbi->lag() + 1 + max_frames);
+    }
+}
+
+CrepeStream::~CrepeStream()
+{
+    stats::record_stream_pending(-reported_pending);
+}
+
+void CrepeStream::report_pending()
+{
+    if (stats::enabled())
+    {
+        const int64_t pending = pending_frames();
+        stats::record_stream_pending(pending - reported_pending);
+        reported_pending = pending;
+    }
+}
+
+void CrepeStream::push(const float *samples, const size_t count)
+{
+    if (!resampler)
+    {
+        push_resampled(samples, count);
+        return;
+    }
+
+    if (const size_t needed = resampler->max_output(count); resampled.size() < needed)
+    {
+        resampled.resize(needed);
+    }
+    const size_t produced = resampler->process(samples, count, resampled.data());
+    push_resampled(resampled.data(), produced);
+}
+
+void CrepeStream::push_resampled(const float *samples, size_t count)
+{
+    using namespace constants;
+
+    // only the newest capacity samples can ever be analysed
+    if (count > capacity)
+    {
+        samples += count - capacity;
+        samples_pushed += static_cast<int64_t>(count - capacity);
+        count = capacity;
+    }
+
+    size_t pos = static_cast<size_t>(samples_pushed % static_cast<int64_t>(capacity));
+    while (count > 0)
+    {
+        // mirror into both halves so any window of up to capacity samples is contiguous
+        const size_t run = std::min(count, capacity - pos);
+        std::copy_n(samples, run, ring.data() + pos);
+        std::copy_n(samples, run, ring.data() + pos + capacity);
+
+        samples += run;
+        count -= run;
+        samples_pushed += static_cast<int64_t>(run);
+        pos = 0;
+    }
+
+    // overrun, the oldest pending frames are no longer in the ring
+    const int64_t oldest_sample = samples_pushed - static_cast<int64_t>(capacity);
+    if (const int64_t first_kept = (oldest_sample + FFT_HOP - 1) / FFT_HOP;
+        oldest_sample > 0 && first_kept > next_frame)
+    {
+        dropped += first_kept - next_frame;
+        stats::record_stream_dropped(first_kept - next_frame);
+        next_frame = first_kept;
+    }
+
+    report_pending();
+}
+
+int CrepeStream::pending_frames() const
+{
+    using namespace constants;
+
+    if (samples_pushed < FRAME_LENGTH)
+    {
+        return 0;
+    }
+    const int64_t available = (samples_pushed - FRAME_LENGTH) / FFT_HOP + 1;
+    return static_cast<int>(std::max<int64_t>(available - next_frame, 0));
+}
+
+int CrepeStream::poll(PredictionResults &results)
+{
+    using namespace constants;
+
+    const int count = prepare_results(results, pending_frames(), max_frames);
+    results.num_frames = count;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const int64_t first_sample = next_frame * FFT_HOP;
+    const size_t offset = static_cast<size_t>(first_sample % static_cast<int64_t>(capacity));
+    if (viterbi)
+    {
+        // results only serve as scratch for the per-frame decode here, the frames viterbi
+        // decides are written over them (never ahead of the frame being pushed)
+        engine->run_frames(ring.data() + offset, count, results, 0, activations.data(),
+                           options);
+
+        int decided = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const auto slot = static_cast<size_t>(viterbi->frames_pushed()) % held_frames.size();
+            held_frames[slot] = next_frame + i;
+            float pitch;
+            float confidence;
+            if (viterbi->push(activations.data() + static_cast<size_t>(i) * OUTPUT_SIZE, pitch,
+                              confidence))
+            {
+                results.pitches(decided) = pitch;
+                results.confidences(decided) = confidence;
+                decided++;
+            }
+        }
+        fill_decided(results, decided);
+
+        next_frame += count;
+        report_pending();
+        return decided;
+    }
+    engine->run_frames(ring.data() + offset, count, results, 0, options);
+
+    for (int i = 0; i < count; i++)
+    {
+        results.times(i) = frame_time(next_frame + i);
+    }
+
+    next_frame += count;
+    report_pending();
+    return count;
+}
+
+int CrepeStream::flush(PredictionResults &results)
+{
+    if (!viterbi)
+    {
+        results.num_frames = 0;
+        return 0;
+    }
+
+    const int held = static_cast<int>(viterbi->frames_pushed() - viterbi->frames_decided());
+    const int count = prepare_results(results, held, max_frames);
+    const int decided = viterbi->flush(results.pitches.data(), results.confidences.data(), count);
+    fill_decided(results, decided);
+    return decided;
+}
+
+float CrepeStream::frame_time(const int64_t frame) const
+{
+    using namespace constants;
+
+    // the resampled stream lags the input by the filter delay, the first frames come out
+    // slightly negative
+    return static_cast<float>(frame * FFT_HOP - time_offset) / static_cast<float>(SAMPLE_RATE);
+}
+
+void CrepeStream::fill_decided(PredictionResults &results, const int count) const
+{
+    // the count frames viterbi just decided, their pitches and confidences are in place
+    const int64_t first = viterbi->frames_decided() - count;
+    for (int i = 0; i < count; i++)
+    {
+        const int64_t frame = held_frames[static_cast<size_t>(first + i) % held_frames.size()];
+        results.times(i) = frame_time(frame);
+        results.voiced(i) = results.confidences(i) >= options.voicing_threshold;
+    }
+    results.num_frames = count;
+}
+
+void CrepeStream::reset()
+{
+    std::fill(ring.begin(), ring.end(), 0.0f);
+    samples_pushed = 0;
+    next_frame = 0;
+    dropped = 0;
+    if (resampler)
+    {
+        resampler->reset();
+    }
+    if (viterbi)
+    {
+        viterbi->reset();
+    }
+    report_pending();
+}
+} // namespace crepe
@@ -0,0 +1,143 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace crepe
+{
+namespace
+{
+// the pool and deque the current thread works on, if it is a pool worker
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_worker = 0;
+} // namespace
+
+ThreadPool::ThreadPool(int num_threads)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        threads.emplace_back([this, i] { worker_loop(static_cast<size_t>(i)); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    const size_t index = current_pool == this
+                             ? current_worker
+                             : next_worker.fetch_add(1, std::memory_order_relaxed) %
+                               workers.size();
+    // counted before it becomes visible, so a worker popping it never sees the counts underflow
+    {
+        std::lock_guard lock(mutex);
+        queued++;
+        unfinished++;
+    }
+    {
+        std::lock_guard lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    work_available.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock lock(mutex);
+    all_done.wait(lock, [&] { return unfinished == 0; });
+}
+
+bool ThreadPool::on_worker()
+{
+    return current_pool != nullptr;
+}
+
+bool ThreadPool::try_pop(const size_t index, Task &task)
+{
+    // own work first, newest first
+    {
+        Worker &own = *workers[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // then steal the oldest task of the next busy worker
+    for (size_t k = 1; k < workers.size(); k++)
+    {
+        Worker &victim = *workers[(index + k) % workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(const size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+
+    Task task;
+    while (true)
+    {
+        if (try_pop(index, task))
+        {
+            {
+                std::lock_guard lock(mutex);
+                queued--;
+            }
+            task();
+            task = nullptr;
+
+            bool done;
+            {
+                std::lock_guard lock(mutex);
+                done = --unfinished == 0;
+            }
+            if (done)
+            {
+                all_done.notify_all();
+            }
+            continue;
+        }
+
+        // a task counted in queued may already be claimed by another worker, so this can wake
+        // without finding work; that only costs another pass over the deques
+        std::unique_lock lock(mutex);
+        work_available.wait(lock, [&] { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+        {
+            return;
+        }
+    }
+}
+} // namespace crepe
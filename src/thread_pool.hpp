@@ -0,0 +1,71 @@
+#ifndef CREPE_THREAD_POOL_HPP
+#define CREPE_THREAD_POOL_HPP
+
+// Internal work-stealing thread pool. Every worker owns a deque: tasks submitted from a worker go
+// to the back of its own deque and are popped LIFO (cache-warm follow-up work first), idle
+// workers steal from the front of the others. Tasks submitted from outside are spread round
+// robin.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crepe
+{
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // num_threads <= 0 means one worker per hardware thread
+    explicit ThreadPool(int num_threads = 0);
+
+    // Finishes every submitted task, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Tasks must not throw
+    void submit(Task task);
+
+    // Blocks until every task submitted so far, and everything they submit, has finished
+    void wait();
+
+    int size() const { return static_cast<int>(threads.size()); }
+
+    // True on a worker thread of any pool
+    static bool on_worker();
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_worker{0}; // round robin for outside submissions
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    size_t queued = 0; // tasks sitting in a deque
+    size_t unfinished = 0; // queued plus running
+    bool stopping = false;
+
+    void worker_loop(size_t index);
+
+    bool try_pop(size_t index, Task &task);
+};
+} // namespace crepe
+
+#endif //CREPE_THREAD_POOL_HPP
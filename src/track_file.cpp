@@ -0,0 +1,281 @@
+#include "track_file.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace crepe
+{
+namespace
+{
+constexpr char MAGIC[8] = {'C', 'R', 'E', 'P', 'E', 'T', 'R', 'K'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_BYTES = 64;
+
+// Quarter cents above BASE_FREQUENCY, 0 for frames without a pitch. 16 bits reach 16383 cents
+// (about 129 kHz), far above the model's range.
+constexpr float CENTS_SCALE = 4.0f;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t hop;
+    uint32_t chunk_frames;
+    int64_t num_frames;
+    double start_time;
+    uint32_t cents_scale;
+    uint32_t reserved[5];
+};
+static_assert(sizeof(FileHeader) == HEADER_BYTES);
+
+// Bytes of a chunk of count frames, including the padding
+size_t chunk_bytes(const int count)
+{
+    const size_t bytes = static_cast<size_t>(count) * 3 + (static_cast<size_t>(count) + 7) / 8;
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+uint16_t quantize_pitch(const float pitch)
+{
+    if (!(pitch > 0.0f))
+    {
+        return 0;
+    }
+    const float cents = constants::CENTS_CONVERSION * std::log2(pitch / constants::BASE_FREQUENCY);
+    return static_cast<uint16_t>(std::clamp(std::lround(cents * CENTS_SCALE), 1L, 65535L));
+}
+
+float dequantize_pitch(const uint16_t value)
+{
+    if (value == 0)
+    {
+        return 0.0f;
+    }
+    return constants::BASE_FREQUENCY *
+           std::exp2(static_cast<float>(value) / (CENTS_SCALE * constants::CENTS_CONVERSION));
+}
+} // namespace
+
+TrackWriter::TrackWriter(const std::string &path, const TrackHeader &header)
+    : header(header)
+{
+    // before the file is opened, a bad header must not truncate an existing track
+    if (header.chunk_frames <= 0 || header.hop <= 0 || header.sample_rate <= 0)
+    {
+        throw std::invalid_argument("Track chunk_frames, hop and sample_rate must be positive");
+    }
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to create track file: " + path);
+    }
+
+    this->header.num_frames = 0;
+    cents.resize(header.chunk_frames);
+    confidences.resize(header.chunk_frames);
+    voiced.resize((header.chunk_frames + 7) / 8);
+    write_header();
+}
+
+TrackWriter::~TrackWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+        // nothing to report to from a destructor, close() explicitly to see the error
+    }
+}
+
+void TrackWriter::append(const PredictionResults &results)
+{
+    const auto frames = static_cast<Eigen::Index>(std::max(results.num_frames, 0));
+    if (results.pitches.size() < frames || results.confidences.size() < frames ||
+        results.voiced.size() < frames)
+    {
+        throw std::invalid_argument("Track results hold fewer frames than num_frames");
+    }
+
+    for (int i = 0; i < results.num_frames; i++)
+    {
+        if (buffered == 0)
+        {
+            std::fill(voiced.begin(), voiced.end(), 0);
+        }
+
+        cents[buffered] = quantize_pitch(results.pitches(i));
+        confidences[buffered] = static_cast<uint8_t>(
+            std::lround(std::clamp(results.confidences(i), 0.0f, 1.0f) * 255.0f));
+        if (results.voiced(i))
+        {
+            voiced[buffered / 8] |= static_cast<uint8_t>(1u << (buffered % 8));
+        }
+
+        header.num_frames++;
+        if (++buffered == header.chunk_frames)
+        {
+            write_chunk();
+        }
+    }
+}
+
+void TrackWriter::write_chunk()
+{
+    const size_t bytes = static_cast<size_t>(buffered) * 3 + (buffered + 7) / 8;
+    constexpr char padding[8] = {};
+
+    out.write(reinterpret_cast<const char *>(cents.data()),
+              static_cast<std::streamsize>(buffered * sizeof(uint16_t)));
+    out.write(reinterpret_cast<const char *>(confidences.data()), buffered);
+    out.write(reinterpret_cast<const char *>(voiced.data()), (buffered + 7) / 8);
+    out.write(padding, static_cast<std::streamsize>(chunk_bytes(buffered) - bytes));
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write track file");
+    }
+    buffered = 0;
+}
+
+void TrackWriter::write_header()
+{
+    FileHeader file_header{};
+    std::memcpy(file_header.magic, MAGIC, sizeof(MAGIC));
+    file_header.version = VERSION;
+    file_header.sample_rate = static_cast<uint32_t>(header.sample_rate);
+    file_header.hop = static_cast<uint32_t>(header.hop);
+    file_header.chunk_frames = static_cast<uint32_t>(header.chunk_frames);
+    file_header.num_frames = header.num_frames;
+    file_header.start_time = header.start_time;
+    file_header.cents_scale = static_cast<uint32_t>(CENTS_SCALE);
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write track file header");
+    }
+}
+
+void TrackWriter::close()
+{
+    if (!out.is_open())
+    {
+        return;
+    }
+    if (buffered > 0)
+    {
+        write_chunk();
+    }
+    write_header();
+    out.close();
+}
+
+TrackReader::TrackReader(const std::string &path)
+    : file(std::make_shared<MappedFile>(path)) // not open_shared, the file may have been rewritten
+{
+    FileHeader file_header{};
+    if (file->size() < HEADER_BYTES)
+    {
+        throw std::runtime_error("Not a track file: " + path);
+    }
+    std::memcpy(&file_header, file->data(), sizeof(file_header));
+    if (std::memcmp(file_header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        file_header.version != VERSION ||
+        file_header.cents_scale != static_cast<uint32_t>(CENTS_SCALE) ||
+        file_header.chunk_frames == 0 || file_header.hop == 0 || file_header.sample_rate == 0 ||
+        file_header.num_frames < 0)
+    {
+        throw std::runtime_error("Not a track file: " + path);
+    }
+
+    track_header.sample_rate = static_cast<int>(file_header.sample_rate);
+    track_header.hop = static_cast<int>(file_header.hop);
+    track_header.chunk_frames = static_cast<int>(file_header.chunk_frames);
+    track_header.num_frames = file_header.num_frames;
+    track_header.start_time = file_header.start_time;
+
+    const int64_t full_chunks = track_header.num_frames / track_header.chunk_frames;
+    const int last_chunk = static_cast<int>(track_header.num_frames % track_header.chunk_frames);
+    const size_t expected = HEADER_BYTES +
+                            static_cast<size_t>(full_chunks) *
+                            chunk_bytes(track_header.chunk_frames) +
+                            (last_chunk > 0 ? chunk_bytes(last_chunk) : 0);
+    if (file->size() < expected)
+    {
+        throw std::runtime_error("Truncated track file: " + path);
+    }
+}
+
+TrackReader::~TrackReader() = default;
+
+int TrackReader::read_frames(const int64_t first, const int count,
+                             PredictionResults &results) const
+{
+    const int64_t begin = std::clamp<int64_t>(first, 0, track_header.num_frames);
+    const int64_t end = std::clamp<int64_t>(first + std::max(count, 0), begin,
+                                            track_header.num_frames);
+    const int num_frames = static_cast<int>(end - begin);
+
+    // no-ops when results already has the right size
+    results.pitches.resize(num_frames);
+    results.confidences.resize(num_frames);
+    results.times.resize(num_frames);
+    results.voiced.resize(num_frames);
+    results.num_frames = num_frames;
+
+    const int chunk_frames = track_header.chunk_frames;
+    const size_t full_chunk_bytes = chunk_bytes(chunk_frames);
+    for (int i = 0; i < num_frames;)
+    {
+        // the rest of the range that lies in this chunk
+        const int64_t frame = begin + i;
+        const int64_t chunk = frame / chunk_frames;
+        const int offset = static_cast<int>(frame % chunk_frames);
+        const int in_chunk = static_cast<int>(std::min<int64_t>(
+            chunk_frames, track_header.num_frames - chunk * chunk_frames));
+        const int n = std::min(in_chunk - offset, num_frames - i);
+
+        const unsigned char *base = file->data() + HEADER_BYTES +
+                                    static_cast<size_t>(chunk) * full_chunk_bytes;
+        const unsigned char *cents = base;
+        const unsigned char *confidences = base + static_cast<size_t>(in_chunk) * 2;
+        const unsigned char *voiced = base + static_cast<size_t>(in_chunk) * 3;
+
+        for (int j = 0; j < n; j++)
+        {
+            const int k = offset + j;
+            uint16_t value;
+            std::memcpy(&value, cents + static_cast<size_t>(k) * 2, sizeof(value));
+            results.pitches(i + j) = dequantize_pitch(value);
+            results.confidences(i + j) = static_cast<float>(confidences[k]) / 255.0f;
+            results.voiced(i + j) = (voiced[k / 8] >> (k % 8)) & 1;
+            results.times(i + j) = static_cast<float>(track_header.frame_time(frame + j));
+        }
+        i += n;
+    }
+    return num_frames;
+}
+
+int TrackReader::read_range(const double start_seconds, const double end_seconds,
+                            PredictionResults &results) const
+{
+    // first frame at or after each bound
+    const double frames_per_second = static_cast<double>(track_header.sample_rate) /
+                                     track_header.hop;
+    const auto frame_at = [&](const double seconds) {
+        const double frame = std::ceil((seconds - track_header.start_time) * frames_per_second -
+                                       1e-9);
+        return static_cast<int64_t>(std::clamp(frame, 0.0,
+                                               static_cast<double>(track_header.num_frames)));
+    };
+    const int64_t first = frame_at(start_seconds);
+    const int64_t last = std::max(frame_at(end_seconds), first);
+    return read_frames(first, static_cast<int>(last - first), results);
+}
+} // namespace crepe
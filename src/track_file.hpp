@@ -0,0 +1,99 @@
+#ifndef CREPE_TRACK_FILE_HPP
+#define CREPE_TRACK_FILE_HPP
+
+// Compact on-disk pitch tracks for archive-scale output. Frame times are implicit (start time
+// plus frame index times hop), pitch is stored as quantized cents in 16 bits, confidence in 8
+// bits and voicing as a bit per frame: about 3.1 bytes per frame instead of 12 in memory.
+//
+// Layout (little-endian): a 64 byte header, then columnar chunks of chunk_frames frames, each
+// [uint16 cents * n][uint8 confidence * n][voiced bits, ceil(n / 8) bytes], padded to 8 bytes.
+// Every chunk but the last is full, so a frame's chunk is found by arithmetic alone and a
+// time-range query only touches the pages it reads.
+
+#include "crepe.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crepe
+{
+class MappedFile;
+
+struct TrackHeader
+{
+    int sample_rate = constants::SAMPLE_RATE;
+    int hop = constants::FFT_HOP;
+    int chunk_frames = 4096;
+    int64_t num_frames = 0;
+    double start_time = 0.0; // seconds, time of frame 0
+
+    double frame_time(const int64_t frame) const
+    {
+        return start_time + static_cast<double>(frame) * hop / sample_rate;
+    }
+};
+
+// Appends results chunk by chunk; nothing but the current chunk is held in memory. The frame
+// count in the header is written by close() (or the destructor), a file that was never closed
+// reads as empty. Throws std::runtime_error on I/O errors.
+class TrackWriter
+{
+public:
+    explicit TrackWriter(const std::string &path, const TrackHeader &header = {});
+
+    ~TrackWriter();
+
+    TrackWriter(const TrackWriter &) = delete;
+
+    TrackWriter &operator=(const TrackWriter &) = delete;
+
+    // Frames [0, results.num_frames) follow the ones already written, their times are ignored
+    void append(const PredictionResults &results);
+
+    void close();
+
+    int64_t num_frames() const { return header.num_frames; }
+
+private:
+    std::ofstream out;
+    TrackHeader header;
+    std::vector<uint16_t> cents;
+    std::vector<uint8_t> confidences;
+    std::vector<uint8_t> voiced;
+    int buffered = 0;
+
+    void write_chunk();
+
+    void write_header();
+};
+
+// Random access to a track file through a read-only mapping.
+// Throws std::runtime_error when the file is missing, not a track file or truncated.
+class TrackReader
+{
+public:
+    explicit TrackReader(const std::string &path);
+
+    ~TrackReader();
+
+    const TrackHeader &header() const { return track_header; }
+
+    int64_t num_frames() const { return track_header.num_frames; }
+
+    // Frames [first, first + count) decoded into results (times filled in), clamped to the
+    // track. Reuses the vectors in results, returns the number of frames read.
+    int read_frames(int64_t first, int count, PredictionResults &results) const;
+
+    // The frames whose time lies in [start_seconds, end_seconds)
+    int read_range(double start_seconds, double end_seconds, PredictionResults &results) const;
+
+private:
+    std::shared_ptr<const MappedFile> file;
+    TrackHeader track_header;
+};
+} // namespace crepe
+
+#endif //CREPE_TRACK_FILE_HPP
@@ -9,9 +9,10 @@ const noteName = document.getElementById('noteName');
 const confidenceBar = document.getElementById('confidenceBar');
 const pitchCanvas = document.getElementById('pitchCanvas');
 const ctx = pitchCanvas.getContext('2d');
-let lastAnalysisTime = 0;
-const ANALYSIS_INTERVAL = 250; 
+const statusMessage = document.getElementById('status');
 let currentTestFrequency = 440;
+let oscillator;
+let captureNode;
 
 
 let crepeWorker;
@@ -47,9 +48,8 @@ function setupTestControls() {
         currentTestFrequency = parseInt(freqSlider.value, 10);
         freqDisplay.textContent = `${currentTestFrequency} Hz`;
         
-        if (isProcessing) {
-            lastAnalysisTime = 0;
-            processAudio();
+        if (oscillator) {
+            oscillator.frequency.value = currentTestFrequency;
         }
     });
     
@@ -77,7 +77,41 @@ function frequencyToNoteName(frequency) {
     return NOTE_NAMES[noteNum % 12] + (Math.floor(noteNum / 12) - 1);
 }
 
-function initWorker() {
+// simd128 validation probe: (func (result v128) i32.const 0 i32x4.splat)
+const SIMD_PROBE = new Uint8Array([0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1,
+                                   0, 10, 8, 1, 6, 0, 65, 0, 253, 17, 11]);
+
+// The fastest build variant this browser runs: pthreads need cross-origin isolation, without it
+// the audio reaches the worker over a MessagePort instead of a shared ring
+function selectWasmVariant() {
+    const simd = WebAssembly.validate(SIMD_PROBE);
+    const threads = window.crossOriginIsolated && typeof SharedArrayBuffer !== 'undefined';
+    if (simd && threads) return 'crepe_wasm_simd_threads.js';
+    if (simd) return 'crepe_wasm_simd.js';
+    return 'crepe_wasm.js';
+}
+
+// The wasm outputs are build artifacts, not checked in: say so instead of failing on a 404
+function showBuildMessage(wasmUrl) {
+    startButton.disabled = true;
+    startButton.textContent = "WASM not built";
+    statusMessage.textContent = `${wasmUrl} is missing from web/. Build the wasm first ` +
+        `(see "wasm" in the README) and copy the .js/.wasm outputs into web/.`;
+}
+
+async function initWorker() {
+    const wasmUrl = selectWasmVariant();
+    try {
+        const response = await fetch(wasmUrl, { method: 'HEAD' });
+        if (!response.ok) {
+            showBuildMessage(wasmUrl);
+            return;
+        }
+    } catch (error) {
+        showBuildMessage(wasmUrl);
+        return;
+    }
+
     if (window.Worker) {
         crepeWorker = new Worker('thread.js');
         
@@ -92,12 +126,17 @@ function initWorker() {
                     startButton.textContent = "Start Test Tone";
                     break;
                     
+                case 'STREAM_READY':
+                    connectCapture(data.ring, data.port);
+                    break;
+
                 case 'ANALYSIS_COMPLETE':
                     handleAnalysisResults(data);
                     break;
                     
                 case 'ERROR':
                     console.error("Worker error:", data.message);
+                    statusMessage.textContent = data.message;
                     break;
             }
         };
@@ -108,7 +147,7 @@ function initWorker() {
         
         crepeWorker.postMessage({
             command: 'INIT',
-            wasmUrl: 'crepe_wasm.js'
+            wasmUrl
         });
     } else {
         console.error("Web Workers not supported in this browser");
@@ -117,16 +156,12 @@ function initWorker() {
 }
 
 function handleAnalysisResults(data) {
-    const { results, testFrequency, processingTime } = data;
+    const { pitch, confidence, frames, droppedFrames, processingTime } = data;
     
-    if (results && results.length > 0) {
-        const { pitch, confidence } = results[results.length - 1];
-        
-        console.log(`Detected pitch: ${pitch.toFixed(1)} Hz (confidence: ${confidence.toFixed(2)}, in ${processingTime.toFixed(0)}ms)`);
-        
+    if (frames > 0) {
         const perfIndicator = document.getElementById('perfIndicator');
         if (perfIndicator) {
-            perfIndicator.textContent = `Processing time: ${processingTime.toFixed(0)}ms`;
+            perfIndicator.textContent = `Processing time: ${processingTime.toFixed(1)}ms for ${frames} frames, ${droppedFrames} dropped`;
         }
         
         confidenceBar.style.width = `${confidence * 100}%`;
@@ -151,65 +186,65 @@ function handleAnalysisResults(data) {
         
         drawPitchHistory();
     }
-    
-    if (isProcessing) {
-        lastAnalysisTime = Date.now();
-        setTimeout(processAudio, ANALYSIS_INTERVAL);
-    }
 }
 
 startButton.addEventListener('click', async () => {
     if (isProcessing) {
         isProcessing = false;
         startButton.textContent = "Start Test Tone";
+        stopCapture();
         return;
     }
 
     try {
         if (!audioContext) {
             audioContext = new AudioContext();
+            await audioContext.audioWorklet.addModule('crepe-worklet.js');
         }
+        await audioContext.resume();
         
         isProcessing = true;
         startButton.textContent = "Stop Test Tone";
-        processAudio();
+        // the worker answers with the ring the worklet should write into
+        crepeWorker.postMessage({
+            command: 'START',
+            sampleRate: audioContext.sampleRate,
+            threads: Math.min(navigator.hardwareConcurrency || 1, 4)
+        });
     } catch (error) {
         console.error("Error:", error);
         alert("Error: " + error.message);
     }
 });
 
-function generateTestTone(frequency, duration, sampleRate) {
-    const numSamples = Math.floor(duration * sampleRate);
-    const buffer = new Float32Array(numSamples);
-    for (let i = 0; i < numSamples; i++) {
-        buffer[i] = Math.sin(2 * Math.PI * frequency * i / sampleRate) * 0.5;
+// ring is the shared ring's descriptor, or null with the port the worklet posts blocks to
+function connectCapture(ring, port) {
+    if (!isProcessing) {
+        return;
     }
-    return buffer;
-}
 
-function processAudio() {
-    if (!isProcessing || !workerReady) {
-        return;
+    oscillator = new OscillatorNode(audioContext, { frequency: currentTestFrequency });
+    const gain = new GainNode(audioContext, { gain: 0.5 });
+    captureNode = new AudioWorkletNode(audioContext, 'crepe-capture', {
+        processorOptions: { ring }
+    });
+    if (port) {
+        captureNode.port.postMessage({ port }, [port]);
     }
+    oscillator.connect(gain).connect(captureNode).connect(audioContext.destination);
+    oscillator.start();
+}
 
-    const now = Date.now();
-    const shouldAnalyze = now - lastAnalysisTime >= ANALYSIS_INTERVAL;
-    
-    if (shouldAnalyze) {
-        const bufferLength = 16000; 
-        const audioData = generateTestTone(currentTestFrequency, 1, 16000);
-        
-        console.log(`Sending test tone at ${currentTestFrequency} Hz to worker`);
-        
-        crepeWorker.postMessage({
-            command: 'ANALYZE',
-            audioData: audioData.buffer,
-            testFrequency: currentTestFrequency
-        }, [audioData.buffer]);
-        
-    } else {
-        requestAnimationFrame(processAudio);
+function stopCapture() {
+    crepeWorker.postMessage({ command: 'STOP' });
+    if (oscillator) {
+        oscillator.stop();
+        oscillator.disconnect();
+        oscillator = null;
+    }
+    if (captureNode) {
+        captureNode.disconnect();
+        captureNode = null;
     }
 }
 
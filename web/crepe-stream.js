@@ -0,0 +1,152 @@
+// Streaming pitch tracking over the wasm module (crepe_stream_* in src-wasm/crepe.cpp).
+// Loaded with importScripts in the worker, imported for its side effects by the AudioWorklet
+// and required under Node, so it only defines globals / module.exports.
+
+// Ring header, uint32 words: free-running write and read sample counters, capacity (a power of
+// two), samples dropped by the producer, byte offset of the float samples in the same buffer
+const RING_WRITE = 0;
+const RING_READ = 1;
+const RING_CAPACITY = 2;
+const RING_OVERRUNS = 3;
+const RING_DATA = 4;
+const RING_HEADER_WORDS = 8;
+
+// Single-producer single-consumer float ring over a (Shared)ArrayBuffer, either inside the wasm
+// memory or standalone. Only Atomics on the header, the samples are plain views.
+class CrepeRing {
+    constructor(buffer, byteOffset = 0) {
+        this.buffer = buffer;
+        this.byteOffset = byteOffset;
+        // SharedArrayBuffer is not even defined on pages that are not cross-origin isolated
+        this.shared = typeof SharedArrayBuffer !== 'undefined' &&
+                      buffer instanceof SharedArrayBuffer;
+        this.header = new Uint32Array(buffer, byteOffset, RING_HEADER_WORDS);
+        this.capacity = this.header[RING_CAPACITY];
+        this.mask = this.capacity - 1;
+        this.data = new Float32Array(buffer, this.header[RING_DATA], this.capacity);
+    }
+
+    // A standalone ring, for builds whose wasm memory is not shared. Without SharedArrayBuffer
+    // it is a plain buffer that only the owning thread can write (Atomics work on both).
+    static create(capacity) {
+        const headerBytes = RING_HEADER_WORDS * 4;
+        const Buffer = typeof SharedArrayBuffer !== 'undefined' ? SharedArrayBuffer : ArrayBuffer;
+        const buffer = new Buffer(headerBytes + capacity * 4);
+        const header = new Uint32Array(buffer, 0, RING_HEADER_WORDS);
+        header[RING_CAPACITY] = capacity;
+        header[RING_DATA] = headerBytes;
+        return new CrepeRing(buffer, 0);
+    }
+
+    available() {
+        return (Atomics.load(this.header, RING_WRITE) - Atomics.load(this.header, RING_READ)) >>> 0;
+    }
+
+    overruns() {
+        return Atomics.load(this.header, RING_OVERRUNS);
+    }
+
+    // Producer side, never blocks: what does not fit is dropped and counted
+    write(samples) {
+        const write = Atomics.load(this.header, RING_WRITE);
+        const used = (write - Atomics.load(this.header, RING_READ)) >>> 0;
+        const count = Math.min(samples.length, this.capacity - used);
+        if (count < samples.length) {
+            Atomics.add(this.header, RING_OVERRUNS, samples.length - count);
+        }
+
+        const position = write & this.mask;
+        const first = Math.min(count, this.capacity - position);
+        this.data.set(first === samples.length ? samples : samples.subarray(0, first), position);
+        if (first < count) {
+            this.data.set(samples.subarray(first, count), 0);
+        }
+        Atomics.store(this.header, RING_WRITE, (write + count) >>> 0);
+        return count;
+    }
+
+    // Consumer side: moves everything available into another ring (as its producer)
+    pipeTo(target) {
+        let read = Atomics.load(this.header, RING_READ);
+        let count = (Atomics.load(this.header, RING_WRITE) - read) >>> 0;
+        while (count > 0) {
+            const position = read & this.mask;
+            const run = Math.min(count, this.capacity - position);
+            target.write(this.data.subarray(position, position + run));
+            read = (read + run) >>> 0;
+            count -= run;
+        }
+        Atomics.store(this.header, RING_READ, read);
+    }
+
+    // What an AudioWorklet needs to write into this ring (postMessage / processorOptions), only
+    // for shared rings
+    descriptor() {
+        return { buffer: this.buffer, byteOffset: this.byteOffset };
+    }
+}
+
+// One live stream on a loaded module. The producer writes into `ring` (hand its descriptor to
+// the AudioWorklet, or when `ring.shared` is false write the blocks it posts from the thread that
+// owns the stream); process() analyses what arrived and returns the count of new frames, found
+// at the start of `pitches`, `confidences` and `times`. Those are views over wasm memory that
+// are reused on every call, so nothing is allocated per frame; copy out what has to be kept.
+class CrepeStream {
+    constructor(module, sampleRate, { ringSeconds = 1, maxFrames = 64, threads = 0 } = {}) {
+        this.module = module;
+        this.maxFrames = maxFrames;
+        this.handle = module._crepe_stream_create(sampleRate, Math.ceil(ringSeconds * sampleRate),
+                                                  maxFrames, threads);
+        this.attachViews();
+
+        // with shared wasm memory (pthread builds) the producer writes straight into the
+        // module's ring, otherwise into a standalone one that process() copies over
+        this.shared = this.wasmRing.shared;
+        this.ring = this.shared ? this.wasmRing : CrepeRing.create(this.wasmRing.capacity);
+    }
+
+    // Views are recreated when the memory grew, an old (non-shared) buffer is detached
+    attachViews() {
+        const module = this.module;
+        const buffer = module.HEAPF32.buffer;
+        this.wasmRing = new CrepeRing(buffer, module._crepe_stream_ring(this.handle));
+        const view = ptr => new Float32Array(buffer, ptr, this.maxFrames);
+        this.pitches = view(module._crepe_stream_pitches(this.handle));
+        this.confidences = view(module._crepe_stream_confidences(this.handle));
+        this.times = view(module._crepe_stream_times(this.handle));
+    }
+
+    process() {
+        if (this.pitches.buffer !== this.module.HEAPF32.buffer) {
+            this.attachViews();
+        }
+        if (!this.shared) {
+            this.ring.pipeTo(this.wasmRing);
+        }
+
+        const count = this.module._crepe_stream_process(this.handle);
+        if (this.pitches.buffer !== this.module.HEAPF32.buffer) {
+            this.attachViews();
+        }
+        return count;
+    }
+
+    droppedFrames() {
+        return this.module._crepe_stream_dropped_frames(this.handle);
+    }
+
+    reset() {
+        this.module._crepe_stream_reset(this.handle);
+    }
+
+    destroy() {
+        this.module._crepe_stream_destroy(this.handle);
+        this.handle = 0;
+    }
+}
+
+globalThis.CrepeRing = CrepeRing;
+globalThis.CrepeStream = CrepeStream;
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = { CrepeRing, CrepeStream };
+}
@@ -0,0 +1,57 @@
+// AudioWorklet producer: copies the first input channel of every render quantum into the
+// stream's ring, nothing else runs on the audio thread. Without cross-origin isolation there is
+// no shared ring; the samples are then gathered into blocks and transferred to the worker over
+// the MessagePort it hands out.
+import './crepe-stream.js';
+
+const PORT_BLOCK = 1024; // samples per posted block, eight render quanta
+
+class CrepeCaptureProcessor extends AudioWorkletProcessor {
+    constructor(options) {
+        super();
+        const ring = options.processorOptions.ring;
+        if (ring) {
+            this.ring = new globalThis.CrepeRing(ring.buffer, ring.byteOffset);
+        } else {
+            this.block = new Float32Array(PORT_BLOCK);
+            this.filled = 0;
+            this.port.onmessage = e => {
+                this.target = e.data.port;
+            };
+        }
+    }
+
+    process(inputs, outputs) {
+        const input = inputs[0];
+        if (input.length > 0) {
+            if (this.ring) {
+                this.ring.write(input[0]);
+            } else if (this.target) {
+                this.post(input[0]);
+            }
+        }
+        // pass through so the test tone stays audible
+        for (let c = 0; c < outputs[0].length && c < input.length; c++) {
+            outputs[0][c].set(input[c]);
+        }
+        return true;
+    }
+
+    post(samples) {
+        let offset = 0;
+        while (offset < samples.length) {
+            const count = Math.min(samples.length - offset, PORT_BLOCK - this.filled);
+            this.block.set(samples.subarray(offset, offset + count), this.filled);
+            this.filled += count;
+            offset += count;
+            if (this.filled === PORT_BLOCK) {
+                // the buffer moves to the worker, start a new one
+                this.target.postMessage(this.block, [this.block.buffer]);
+                this.block = new Float32Array(PORT_BLOCK);
+                this.filled = 0;
+            }
+        }
+    }
+}
+
+registerProcessor('crepe-capture', CrepeCaptureProcessor);
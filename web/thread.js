@@ -1,38 +1,58 @@
 let crepeModule;
 let isInitialized = false;
-const ANALYSIS_INTERVAL = 250; 
+let stream;
+let timer;
+let capturePort; // worker end of the worklet's MessagePort when the ring is not shared
+const PROCESS_INTERVAL = 20; // ms, two frames at the 10 ms hop
+
+importScripts('crepe-stream.js');
 
 onmessage = function(e) {
     const data = e.data;
-    
+
     switch(data.command) {
         case 'INIT':
             initializeWasm(data.wasmUrl);
             break;
-            
-        case 'ANALYZE':
+
+        case 'START':
             if (!isInitialized) {
-                postMessage({ 
-                    type: 'ERROR', 
+                postMessage({
+                    type: 'ERROR',
                     message: 'WASM module not initialized'
                 });
                 return;
             }
-            analyzePitch(data.audioData, data.testFrequency);
+            startStream(data.sampleRate, data.threads || 0);
+            break;
+
+        case 'STOP':
+            stopStream();
             break;
-            
+
         case 'CLEANUP':
-            if (isInitialized && crepeModule._cleanup) {
-                crepeModule._cleanup();
+            stopStream();
+            if (stream) {
+                stream.destroy();
+                stream = null;
             }
             break;
     }
 };
 
 function initializeWasm(wasmUrl) {
-    importScripts(wasmUrl);
-    
+    try {
+        importScripts(wasmUrl);
+    } catch (err) {
+        postMessage({
+            type: 'ERROR',
+            message: `Failed to load ${wasmUrl}, build the wasm first and copy it into web/`
+        });
+        return;
+    }
+
     CrepeModule({
+        mainScriptUrlOrBlob: wasmUrl,
         onRuntimeInitialized: function() {
             console.log("[Worker] WASM runtime initialized");
         }
@@ -40,86 +60,89 @@ function initializeWasm(wasmUrl) {
         crepeModule = module;
         isInitialized = true;
         console.log("[Worker] CREPE module loaded successfully");
-        
-        postMessage({ 
+
+        postMessage({
             type: 'INIT_COMPLETE'
         });
     }).catch(err => {
         console.error("[Worker] Failed to load CREPE module:", err);
-        postMessage({ 
-            type: 'ERROR', 
-            message: 'Failed to load CREPE module: ' + err.message 
+        postMessage({
+            type: 'ERROR',
+            message: 'Failed to load CREPE module: ' + err.message
         });
     });
 }
 
-function analyzePitch(audioData, testFrequency) {
+function startStream(sampleRate, threads) {
+    if (!stream || stream.sampleRate !== sampleRate) {
+        if (stream) {
+            stream.destroy();
+        }
+        stream = new CrepeStream(crepeModule, sampleRate, { threads });
+        stream.sampleRate = sampleRate;
+    } else {
+        stream.reset();
+    }
+
+    stopStream();
+    if (stream.ring.shared) {
+        // the worklet writes into this ring from the audio thread
+        postMessage({
+            type: 'STREAM_READY',
+            ring: stream.ring.descriptor(),
+            sharedMemory: stream.shared
+        });
+    } else {
+        // no SharedArrayBuffer on this page: the worklet posts blocks, written here
+        const channel = new MessageChannel();
+        capturePort = channel.port1;
+        capturePort.onmessage = e => stream.ring.write(e.data);
+        postMessage({
+            type: 'STREAM_READY',
+            ring: null,
+            port: channel.port2,
+            sharedMemory: false
+        }, [channel.port2]);
+    }
+
+    timer = setInterval(processStream, PROCESS_INTERVAL);
+}
+
+function stopStream() {
+    if (timer) {
+        clearInterval(timer);
+        timer = null;
+    }
+    if (capturePort) {
+        capturePort.close();
+        capturePort = null;
+    }
+}
+
+function processStream() {
     try {
         const startTime = performance.now();
-        
-        audioData = new Float32Array(audioData);
-        
-        const bufferBytes = audioData.length * 4;
-        const inputPtr = crepeModule._malloc(bufferBytes);
-        
-        if (!inputPtr) {
-            postMessage({ 
-                type: 'ERROR', 
-                message: 'Failed to allocate memory in WASM'
-            });
+        const count = stream.process();
+        if (count === 0) {
             return;
         }
-        
-        crepeModule.HEAPF32.set(audioData, inputPtr / 4);
-        
-        const resultPtr = crepeModule._analyse_audio(inputPtr, audioData.length);
-        
-        crepeModule._free(inputPtr);
-        
-        if (!resultPtr) {
-            postMessage({ 
-                type: 'ERROR', 
-                message: 'Null result from WASM module'
-            });
-            return;
-        }
-        
-        const numFrames = crepeModule.HEAPF32[resultPtr/4];
-        
-        if (numFrames <= 0) {
-            crepeModule._free(resultPtr);
-            postMessage({ 
-                type: 'ERROR', 
-                message: 'No frames returned from analysis'
-            });
-            return;
-        }
-        
-        const results = [];
-        for (let i = 0; i < numFrames; i++) {
-            const baseIndex = resultPtr/4 + 1 + i*3;
-            results.push({
-                pitch: crepeModule.HEAPF32[baseIndex],
-                confidence: crepeModule.HEAPF32[baseIndex + 1],
-                time: crepeModule.HEAPF32[baseIndex + 2]
-            });
-        }
-        
-        crepeModule._free(resultPtr);
-        
-        const processingTime = performance.now() - startTime;
-        
-        postMessage({ 
+
+        // only the newest frame leaves the worker, the views are reused by the next call
+        const last = count - 1;
+        postMessage({
             type: 'ANALYSIS_COMPLETE',
-            results: results,
-            testFrequency: testFrequency,
-            processingTime: processingTime
+            pitch: stream.pitches[last],
+            confidence: stream.confidences[last],
+            time: stream.times[last],
+            frames: count,
+            droppedFrames: stream.droppedFrames(),
+            processingTime: performance.now() - startTime
         });
-        
     } catch (error) {
-        postMessage({ 
-            type: 'ERROR', 
+        stopStream();
+        postMessage({
+            type: 'ERROR',
             message: 'Error in pitch analysis: ' + error.message
         });
     }
-}
\ No newline at end of file
+}